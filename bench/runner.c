@@ -115,6 +115,9 @@ int main(int argc, char* argv[]) {
                 (unsigned long long)vm->jit->traces_compiled,
                 (unsigned long long)vm->jit->traces_aborted,
                 (unsigned long long)vm->jit->total_exits);
+        fprintf(stderr, "[Traces evicted: %llu, retained bytes: %zu]\n",
+                (unsigned long long)vm->jit->traces_evicted,
+                vm->jit->retained_bytes);
     }
 #endif
 
@@ -0,0 +1,26 @@
+#ifndef WREN_JIT_SLJIT_CONFIG_PRE_H
+#define WREN_JIT_SLJIT_CONFIG_PRE_H
+
+// Included by sljitConfig.h when SLJIT_HAVE_CONFIG_PRE is defined (see
+// CMakeLists.txt). Replaces SLJIT's built-in executable allocator with the
+// per-VM code arena from wren_jit_memory.c. The exec_allocator_data
+// argument of sljit_generate_code / sljit_free_code is the JitMemoryPool.
+
+#include "wren_jit_memory.h"
+
+#define SLJIT_EXECUTABLE_ALLOCATOR 0
+
+#define SLJIT_MALLOC_EXEC(size, exec_allocator_data) \
+    jitPoolAlloc((JitMemoryPool*)(exec_allocator_data), (size_t)(size))
+
+#define SLJIT_FREE_EXEC(ptr, exec_allocator_data) \
+    jitPoolFree((JitMemoryPool*)(exec_allocator_data), (void*)(ptr))
+
+// Code is written through a writable view and executed through a separate
+// executable view of the same pages (W^X without mprotect).
+#define SLJIT_EXEC_OFFSET(ptr) jitPoolExecOffset((void*)(ptr))
+
+#define SLJIT_UPDATE_WX_FLAGS(from, to, enable_exec) \
+    jitPoolUpdateWX((void*)(from), (void*)(to), (enable_exec))
+
+#endif
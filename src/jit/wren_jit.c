@@ -9,6 +9,7 @@
 #include "wren_jit_opt.h"
 #include "wren_jit_regalloc.h"
 #include "wren_jit_codegen.h"
+#include "wren_jit_memory.h"
 
 #include "sljitLir.h"
 
@@ -16,10 +17,236 @@
 #include <string.h>
 #include <stdio.h>
 
+// Hash function for pointer-keyed open-addressing tables.
+static uint32_t hash_ptr(const void* p)
+{
+    return (uint32_t)(((uintptr_t)p >> 2) * 2654435761u);
+}
+
 // Hash function for PC-keyed open-addressing table.
 static uint32_t hash_pc(uint8_t* pc)
 {
-    return (uint32_t)(((uintptr_t)pc >> 2) * 2654435761u);
+    return hash_ptr(pc);
+}
+
+// One entry of the per-function trace index: the anchors of every cached
+// trace whose bytecode belongs to `owner`.
+typedef struct JitOwnerEntry {
+    void* owner;
+    uint8_t** anchors;
+    uint32_t count;
+    uint32_t capacity;
+} JitOwnerEntry;
+
+#define JIT_OWNER_INITIAL_CAPACITY 64
+
+// A module variable the JIT has seen reassigned: by a trace that stores it,
+// or between two entries of a trace that folded it. It is not folded again.
+typedef struct JitModVarEntry {
+    void* module;
+    uint32_t index;
+} JitModVarEntry;
+
+#define JIT_MODVAR_INITIAL_CAPACITY 64
+
+// Bytes a cached trace counts against the code budget.
+static size_t traceFootprint(const JitTrace* t)
+{
+    return (size_t)t->code_size +
+           (size_t)t->num_snapshots * sizeof(JitSnapshot) +
+           (size_t)t->num_gc_roots * sizeof(void*) +
+           (size_t)t->num_modvar_checks * sizeof(JitModVarCheck);
+}
+
+// Release the native code and metadata of a trace.
+static void freeTraceMemory(WrenJitState* jit, JitTrace* t)
+{
+    if (t->code != NULL) {
+        sljit_free_code(t->code, jit->mem_pool);
+    }
+    free(t->snapshots);
+    free(t->gc_roots);
+    free(t->modvar_checks);
+}
+
+// Release the native code and metadata held by a cache entry.
+static void freeTraceResources(WrenJitState* jit, JitTrace* t)
+{
+    jit->retained_bytes -= traceFootprint(t);
+    freeTraceMemory(jit, t);
+}
+
+// Backward-shift deletion helper: true if an entry at index j whose home
+// bucket is `home` must stay put when the slot at `hole` is emptied, i.e.
+// its home lies cyclically in (hole, j].
+static bool probeStays(uint32_t hole, uint32_t j, uint32_t home)
+{
+    if (hole <= j) return hole < home && home <= j;
+    return hole < home || home <= j;
+}
+
+// ---------------------------------------------------------------------------
+// Per-function trace index
+// ---------------------------------------------------------------------------
+
+static JitOwnerEntry* ownerFind(WrenJitState* jit, void* owner)
+{
+    if (jit->owners == NULL || owner == NULL) return NULL;
+
+    uint32_t mask = jit->owner_capacity - 1;
+    uint32_t idx = hash_ptr(owner) & mask;
+    for (uint32_t i = 0; i < jit->owner_capacity; i++) {
+        JitOwnerEntry* e = &jit->owners[idx];
+        if (e->owner == NULL) return NULL;
+        if (e->owner == owner) return e;
+        idx = (idx + 1) & mask;
+    }
+    return NULL;
+}
+
+static bool ownerGrow(WrenJitState* jit)
+{
+    uint32_t new_cap = jit->owner_capacity == 0 ? JIT_OWNER_INITIAL_CAPACITY
+                                                : jit->owner_capacity * 2;
+    JitOwnerEntry* new_owners =
+        (JitOwnerEntry*)calloc(new_cap, sizeof(JitOwnerEntry));
+    if (new_owners == NULL) return false;
+
+    uint32_t new_mask = new_cap - 1;
+    for (uint32_t i = 0; i < jit->owner_capacity; i++) {
+        JitOwnerEntry* e = &jit->owners[i];
+        if (e->owner == NULL) continue;
+
+        uint32_t idx = hash_ptr(e->owner) & new_mask;
+        while (new_owners[idx].owner != NULL) {
+            idx = (idx + 1) & new_mask;
+        }
+        new_owners[idx] = *e;
+    }
+
+    free(jit->owners);
+    jit->owners = new_owners;
+    jit->owner_capacity = new_cap;
+    return true;
+}
+
+static void ownerRemoveEntry(WrenJitState* jit, JitOwnerEntry* e);
+
+// Record that the trace at `pc` belongs to `owner`. Returns false if out of
+// memory: the trace could then not be dropped with its function, so the
+// caller must not cache it.
+static bool ownerAddAnchor(WrenJitState* jit, void* owner, uint8_t* pc)
+{
+    if (owner == NULL) return true;
+
+    JitOwnerEntry* e = ownerFind(jit, owner);
+    if (e == NULL) {
+        if (jit->owner_count * 10 >= jit->owner_capacity * 7) {
+            if (!ownerGrow(jit)) return false;
+        }
+        uint32_t mask = jit->owner_capacity - 1;
+        uint32_t idx = hash_ptr(owner) & mask;
+        while (jit->owners[idx].owner != NULL) {
+            idx = (idx + 1) & mask;
+        }
+        e = &jit->owners[idx];
+        e->owner = owner;
+        jit->owner_count++;
+    }
+
+    if (e->count == e->capacity) {
+        uint32_t new_cap = e->capacity == 0 ? 4 : e->capacity * 2;
+        uint8_t** grown =
+            (uint8_t**)realloc(e->anchors, new_cap * sizeof(uint8_t*));
+        if (grown == NULL) {
+            if (e->count == 0) ownerRemoveEntry(jit, e);
+            return false;
+        }
+        e->anchors = grown;
+        e->capacity = new_cap;
+    }
+    e->anchors[e->count++] = pc;
+    return true;
+}
+
+static void ownerRemoveEntry(WrenJitState* jit, JitOwnerEntry* e)
+{
+    free(e->anchors);
+
+    uint32_t mask = jit->owner_capacity - 1;
+    uint32_t hole = (uint32_t)(e - jit->owners);
+    uint32_t j = hole;
+    for (;;) {
+        j = (j + 1) & mask;
+        if (jit->owners[j].owner == NULL) break;
+        uint32_t home = hash_ptr(jit->owners[j].owner) & mask;
+        if (probeStays(hole, j, home)) continue;
+        jit->owners[hole] = jit->owners[j];
+        hole = j;
+    }
+    memset(&jit->owners[hole], 0, sizeof(JitOwnerEntry));
+    jit->owner_count--;
+}
+
+// Forget that the trace at `pc` belongs to `owner`.
+static void ownerRemoveAnchor(WrenJitState* jit, void* owner, uint8_t* pc)
+{
+    JitOwnerEntry* e = ownerFind(jit, owner);
+    if (e == NULL) return;
+
+    for (uint32_t i = 0; i < e->count; i++) {
+        if (e->anchors[i] != pc) continue;
+        e->anchors[i] = e->anchors[--e->count];
+        break;
+    }
+    if (e->count == 0) ownerRemoveEntry(jit, e);
+}
+
+// ---------------------------------------------------------------------------
+// Live trace list
+// ---------------------------------------------------------------------------
+
+static bool liveReserve(WrenJitState* jit)
+{
+    if (jit->live_count < jit->live_capacity) return true;
+
+    uint32_t new_cap = jit->live_capacity == 0 ? 64 : jit->live_capacity * 2;
+    uint8_t** grown =
+        (uint8_t**)realloc(jit->live_anchors, new_cap * sizeof(uint8_t*));
+    if (grown == NULL) return false;
+    jit->live_anchors = grown;
+    jit->live_capacity = new_cap;
+    return true;
+}
+
+static JitTrace* findTrace(WrenJitState* jit, uint8_t* pc);
+
+// Unlink the anchor at `index`, moving the last anchor into its place.
+static void liveRemove(WrenJitState* jit, uint32_t index)
+{
+    uint8_t* last = jit->live_anchors[--jit->live_count];
+    if (index == jit->live_count) return;
+
+    jit->live_anchors[index] = last;
+    JitTrace* moved = findTrace(jit, last);
+    if (moved != NULL) moved->live_index = index;
+}
+
+// Instructions are byte-aligned and loops in one function sit a few bytes
+// apart, so the address is mixed before it is masked.
+static uint32_t hotcountIndex(uint8_t* pc)
+{
+    uintptr_t p = (uintptr_t)pc;
+    return (uint32_t)((p >> 2) ^ (p >> 8) ^ p) & (JIT_HOTCOUNT_SIZE - 1);
+}
+
+// Number of iterations before the counter at idx fires again.
+static uint16_t hotcountStart(WrenJitState* jit, uint32_t idx)
+{
+    uint32_t start = (uint32_t)jit->hot_threshold << jit->hotbackoff[idx];
+    if (start == 0) start = 1;
+    if (start > UINT16_MAX) start = UINT16_MAX;
+    return (uint16_t)start;
 }
 
 WrenJitState* wrenJitInit(WrenVM* vm)
@@ -39,6 +266,11 @@ WrenJitState* wrenJitInit(WrenVM* vm)
     jit->state = JIT_STATE_IDLE;
     jit->enabled = true;
     jit->hot_threshold = JIT_HOT_THRESHOLD;
+    jit->root_policy = JIT_ROOTS_ADAPTIVE;
+    jit->unroll_factor = JIT_UNROLL_FACTOR;
+    for (uint32_t i = 0; i < JIT_HOTCOUNT_SIZE; i++) {
+        jit->hotcount[i] = hotcountStart(jit, i);
+    }
 
     return jit;
 }
@@ -52,16 +284,25 @@ void wrenJitFree(WrenVM* vm, WrenJitState* jit)
         for (uint32_t i = 0; i < jit->trace_capacity; i++) {
             JitTrace* t = &jit->traces[i];
             if (t->anchor_pc == NULL) continue;
-
-            if (t->code != NULL) {
-                sljit_free_code(t->code, NULL);
-            }
+            // Native code is released in bulk with the arena below.
             free(t->snapshots);
             free(t->gc_roots);
+            free(t->modvar_checks);
         }
         free(jit->traces);
     }
+    jitPoolDestroy(jit->mem_pool);
+
+    if (jit->owners != NULL) {
+        for (uint32_t i = 0; i < jit->owner_capacity; i++) {
+            free(jit->owners[i].anchors);
+        }
+        free(jit->owners);
+    }
 
+    free(jit->modvars);
+    free(jit->live_anchors);
+    free(jit->builder_scratch);
     free(jit->recording_ir);
     free(jit->slot_map);
     free(jit);
@@ -72,10 +313,27 @@ void wrenJitSetEnabled(WrenJitState* jit, bool enabled)
     jit->enabled = enabled;
 }
 
-JitTrace* wrenJitLookup(WrenJitState* jit, uint8_t* pc)
+void wrenJitSetUnrollFactor(WrenJitState* jit, int factor)
 {
-    if (jit == NULL || jit->traces == NULL) return NULL;
+    int f = 1;
+    while (f < 8 && f * 2 <= factor) f *= 2;
+    jit->unroll_factor = f;
+}
 
+static void enforceCodeBudget(WrenJitState* jit, uint8_t* keep);
+
+void wrenJitSetCodeBudget(WrenJitState* jit, size_t bytes)
+{
+    jit->code_budget = bytes;
+    enforceCodeBudget(jit, NULL);
+}
+
+static void purgeDoomed(WrenJitState* jit);
+static void doomTrace(WrenJitState* jit, JitTrace* t);
+
+// Raw cache probe; unlike wrenJitLookup it never purges.
+static JitTrace* findTrace(WrenJitState* jit, uint8_t* pc)
+{
     uint32_t mask = jit->trace_capacity - 1;
     uint32_t idx = hash_pc(pc) & mask;
 
@@ -89,21 +347,64 @@ JitTrace* wrenJitLookup(WrenJitState* jit, uint8_t* pc)
     return NULL;
 }
 
+JitTrace* wrenJitLookup(WrenJitState* jit, uint8_t* pc)
+{
+    if (jit == NULL || jit->traces == NULL) return NULL;
+    if (jit->doomed_count > 0 && jit->executing == 0) purgeDoomed(jit);
+    return findTrace(jit, pc);
+}
+
 int wrenJitExecute(WrenVM* vm, JitTrace* trace)
 {
     if (trace == NULL || trace->code == NULL) return -1;
 
-    trace->exec_count++;
-
     ObjFiber* fiber = vm->fiber;
     CallFrame* frame = &fiber->frames[fiber->numFrames - 1];
 
+    // Inlined methods use stack slots past the anchor function's own, and
+    // their exits push call frames. Growing the fiber here would move the
+    // stack under the interpreter, so when it is too small leave through
+    // the entry snapshot and let the interpreter make the calls.
+    int needed = (int)(frame->stackStart - fiber->stack) + trace->stack_slots;
+    if (needed > fiber->stackCapacity ||
+        fiber->numFrames + trace->exit_frames > fiber->frameCapacity) {
+        if (trace->entry_exit >= trace->num_snapshots) return -1;
+        trace->exit_count++;
+        if (vm->jit) vm->jit->total_exits++;
+        return trace->entry_exit + 1;
+    }
+
+    // Module variables the trace folded must still hold the folded values.
+    // Nothing inside a trace writes them, so checking at entry suffices.
+    for (uint16_t i = 0; i < trace->num_modvar_checks; i++) {
+        const JitModVarCheck* check = &trace->modvar_checks[i];
+        ObjModule* module = (ObjModule*)check->module;
+        if (module->variables.data[check->index] == check->value) continue;
+
+        // Reassigned: stop folding it and retire the trace, which the next
+        // wrenJitLookup frees once the interpreter has taken the exit.
+        if (vm->jit) {
+            wrenJitModuleVarReassigned(vm->jit, module, (int)check->index);
+            doomTrace(vm->jit, trace);
+            vm->jit->total_exits++;
+        }
+        trace->exit_count++;
+        if (trace->entry_exit >= trace->num_snapshots) return -1;
+        return trace->entry_exit + 1;
+    }
+
+    trace->exec_count++;
+    if (vm->jit) trace->last_used = ++vm->jit->use_clock;
+
     // Compute module variables data pointer for the current function.
     ObjFn* traceFn = frame->closure->fn;
     Value* modVarsData = traceFn->module->variables.data;
 
     JitTraceFunc fn = (JitTraceFunc)trace->code;
+    if (vm->jit) vm->jit->builder_count = 0;
+    if (vm->jit) vm->jit->executing++;
     int result = fn(vm, fiber, frame->stackStart, modVarsData);
+    if (vm->jit) vm->jit->executing--;
 
     if (result != 0) {
         trace->exit_count++;
@@ -113,15 +414,191 @@ int wrenJitExecute(WrenVM* vm, JitTrace* trace)
     return result;
 }
 
-bool wrenJitIncrementHot(WrenJitState* jit, uint8_t* bytecode,
-                          uint16_t* hot_counts, int pc_offset)
+uint64_t wrenJitNewInstance(WrenVM* vm, ObjClass* classObj)
 {
-    (void)bytecode;
+#if WREN_DEBUG_GC_STRESS
+    // Every allocation collects.
+    (void)vm; (void)classObj;
+    return 0;
+#else
+    size_t size = sizeof(ObjInstance) +
+                  sizeof(Value) * (size_t)classObj->numFields;
+    if (vm->bytesAllocated + size > vm->nextGC) return 0;
+    return wrenNewInstance(vm, classObj);
+#endif
+}
 
+// Continue Wren's FNV-1a string hash over more bytes.
+static uint32_t hashStringBytes(uint32_t hash, const char* bytes,
+                                uint32_t length)
+{
+    for (uint32_t i = 0; i < length; i++) {
+        hash ^= bytes[i];
+        hash *= 16777619;
+    }
+    return hash;
+}
+
+static JitStringBuilder* findBuilder(WrenJitState* jit, ObjString* string)
+{
+    for (uint32_t i = 0; i < jit->builder_count; i++) {
+        if (jit->builders[i].string == string) return &jit->builders[i];
+    }
+    return NULL;
+}
+
+uint64_t wrenJitStringAppend(WrenVM* vm, uint64_t str, uint64_t piece,
+                             int inPlace)
+{
+    WrenJitState* jit = vm->jit;
+    ObjString* a = AS_STRING(str);
+    ObjString* b = AS_STRING(piece);
+    uint32_t length = a->length + b->length;
+
+    JitStringBuilder* builder = inPlace ? findBuilder(jit, a) : NULL;
+    if (builder != NULL && length <= builder->capacity) {
+        memcpy(a->value + a->length, b->value, b->length);
+        a->value[length] = '\0';
+        a->hash = hashStringBytes(a->hash, b->value, b->length);
+        a->length = length;
+        return str;
+    }
+
+    // Leave room to grow only for strings the trace may append to again.
+    uint32_t capacity = length;
+    if (inPlace && length < UINT32_MAX / 2) {
+        capacity = length < 32 ? 64 : length * 2;
+    }
+
+#if WREN_DEBUG_GC_STRESS
+    // Every allocation collects.
+    return 0;
+#else
+    if (vm->bytesAllocated + sizeof(ObjString) + capacity + 1 > vm->nextGC)
+        return 0;
+#endif
+
+    if (jit->builder_scratch_size < capacity) {
+        char* scratch = (char*)realloc(jit->builder_scratch, capacity);
+        if (scratch == NULL) return 0;
+        jit->builder_scratch = scratch;
+        jit->builder_scratch_size = capacity;
+    }
+    memcpy(jit->builder_scratch, a->value, a->length);
+    memcpy(jit->builder_scratch + a->length, b->value, b->length);
+    memset(jit->builder_scratch + length, 0, capacity - length);
+
+    // wrenNewStringLength sizes the string for its whole capacity and copies
+    // all of it, so the unused tail is zeroed above; the length is then cut
+    // back to the characters actually written.
+    Value result = wrenNewStringLength(vm, jit->builder_scratch, capacity);
+    ObjString* string = AS_STRING(result);
+    string->length = length;
+    string->value[length] = '\0';
+    string->hash = hashStringBytes(2166136261u, string->value, length);
+
+    if (inPlace) {
+        if (builder != NULL) {
+            builder->string = string;
+            builder->capacity = capacity;
+        } else if (jit->builder_count < JIT_MAX_STRING_BUILDERS) {
+            builder = &jit->builders[jit->builder_count++];
+            builder->string = string;
+            builder->capacity = capacity;
+        }
+    }
+    return result;
+}
+
+// The generator state of a Random object, laid out as wren_opt_random.c's
+// Well512, which is private to that file.
+typedef struct {
+    uint32_t state[16];
+    uint32_t index;
+} JitWell512;
+
+// WELL512 step, as in wren_opt_random.c's advanceState().
+static uint32_t advanceWell512(JitWell512* well)
+{
+    uint32_t a, b, c, d;
+    a = well->state[well->index];
+    c = well->state[(well->index + 13) & 15];
+    b = a ^ c ^ (a << 16) ^ (c << 15);
+    c = well->state[(well->index + 9) & 15];
+    c ^= (c >> 11);
+    a = well->state[well->index] = b ^ c;
+    d = a ^ ((a << 5) & 0xda442d24U);
+
+    well->index = (well->index + 15) & 15;
+    a = well->state[well->index];
+    well->state[well->index] = a ^ b ^ d ^ (a << 2) ^ (b << 18) ^ (c << 28);
+    return well->state[well->index];
+}
+
+double wrenJitRandomFloat(void* random)
+{
+    JitWell512* well = (JitWell512*)((ObjForeign*)random)->data;
+
+    // 53 random bits: 32 shifted left by 21, plus 21 more.
+    double result = (double)advanceWell512(well) * (1 << 21);
+    result += (double)(advanceWell512(well) & ((1 << 21) - 1));
+    return result / 9007199254740992.0;
+}
+
+double wrenJitRandomInt(void* random)
+{
+    JitWell512* well = (JitWell512*)((ObjForeign*)random)->data;
+    return (double)advanceWell512(well);
+}
+
+// Elements are tested a block at a time with no branch inside the block, so
+// the compiler can turn each block into a few vector compares.
+#define JIT_NUM_RUN_BLOCK 8
+
+int64_t wrenJitListNumEnd(void* list, int64_t from)
+{
+    const ValueBuffer* elements = &((ObjList*)list)->elements;
+    const Value* data = elements->data;
+    int64_t count = elements->count;
+    int64_t i = from < 0 ? 0 : from;
+
+    for (; i + JIT_NUM_RUN_BLOCK <= count; i += JIT_NUM_RUN_BLOCK) {
+        bool other = false;
+        for (int k = 0; k < JIT_NUM_RUN_BLOCK; k++)
+            other |= !IS_NUM(data[i + k]);
+        if (other) break;
+    }
+    while (i < count && IS_NUM(data[i])) i++;
+    return i;
+}
+
+bool wrenJitHotLoop(WrenJitState* jit, uint8_t* pc)
+{
     if (!jit->enabled) return false;
 
-    hot_counts[pc_offset]++;
-    return hot_counts[pc_offset] == (uint16_t)jit->hot_threshold;
+    uint32_t idx = hotcountIndex(pc);
+    if (--jit->hotcount[idx] != 0) return false;
+
+    jit->hotcount[idx] = hotcountStart(jit, idx);
+    return true;
+}
+
+void wrenJitHotBackoff(WrenJitState* jit, uint8_t* pc)
+{
+    if (jit == NULL || pc == NULL) return;
+
+    uint32_t idx = hotcountIndex(pc);
+    if (jit->hotbackoff[idx] < JIT_HOTCOUNT_MAX_BACKOFF) {
+        jit->hotbackoff[idx]++;
+    }
+    jit->hotcount[idx] = hotcountStart(jit, idx);
+}
+
+bool wrenJitIncrementHot(WrenJitState* jit, uint8_t* bytecode,
+                          uint16_t* hot_counts, int pc_offset)
+{
+    (void)hot_counts;
+    return wrenJitHotLoop(jit, bytecode + pc_offset);
 }
 
 void wrenJitStartRecording(WrenJitState* jit, uint8_t* pc)
@@ -158,6 +635,7 @@ void wrenJitAbortRecording(WrenJitState* jit)
 
     free(jit->recording_ir);
     jit->recording_ir = NULL;
+    wrenJitHotBackoff(jit, jit->anchor_pc);
     jit->anchor_pc = NULL;
     jit->state = JIT_STATE_IDLE;
     jit->traces_aborted++;
@@ -195,13 +673,13 @@ static bool grow_trace_table(WrenJitState* jit)
     return true;
 }
 
-void wrenJitStoreTrace(WrenJitState* jit, JitTrace* trace)
+bool wrenJitStoreTrace(WrenJitState* jit, JitTrace* trace)
 {
-    if (jit == NULL || trace == NULL) return;
+    if (jit == NULL || trace == NULL) return false;
 
     // Grow if load factor exceeds 0.7.
     if (jit->trace_count * 10 >= jit->trace_capacity * 7) {
-        if (!grow_trace_table(jit)) return;
+        if (!grow_trace_table(jit)) return false;
     }
 
     uint32_t mask = jit->trace_capacity - 1;
@@ -209,46 +687,399 @@ void wrenJitStoreTrace(WrenJitState* jit, JitTrace* trace)
 
     while (jit->traces[idx].anchor_pc != NULL) {
         if (jit->traces[idx].anchor_pc == trace->anchor_pc) {
-            // Replace existing trace at same PC.
-            if (jit->traces[idx].code != NULL) {
-                sljit_free_code(jit->traces[idx].code, NULL);
-            }
-            free(jit->traces[idx].snapshots);
-            free(jit->traces[idx].gc_roots);
-            jit->traces[idx] = *trace;
-            return;
+            // Replace existing trace at same PC. The owner is unchanged:
+            // the anchor lies in the same function's bytecode.
+            JitTrace* old = &jit->traces[idx];
+            uint32_t live_index = old->live_index;
+            if (old->doomed) jit->doomed_count--;
+            freeTraceResources(jit, old);
+            *old = *trace;
+            old->live_index = live_index;
+            // A new trace counts as run since the last collection, or the
+            // adaptive policy would leave it weak at its first.
+            old->gc_exec_count = old->exec_count - 1;
+            old->last_used = jit->use_clock;
+            jit->retained_bytes += traceFootprint(trace);
+            return true;
         }
         idx = (idx + 1) & mask;
     }
 
+    // A trace missing from the live list would never have its roots marked,
+    // and one missing from the owner index would outlive its function.
+    if (!liveReserve(jit)) return false;
+    if (!ownerAddAnchor(jit, trace->owner, trace->anchor_pc)) return false;
+
     jit->traces[idx] = *trace;
+    jit->traces[idx].live_index = jit->live_count;
+    jit->traces[idx].gc_exec_count = trace->exec_count - 1;
+    jit->traces[idx].last_used = jit->use_clock;
+    jit->live_anchors[jit->live_count++] = trace->anchor_pc;
+    jit->retained_bytes += traceFootprint(trace);
     jit->trace_count++;
     jit->traces_compiled++;
+    return true;
 }
 
-void wrenJitMarkRoots(WrenVM* vm, WrenJitState* jit)
+// Remove the cache entry at `idx` without touching the owner index.
+// Later members of the probe run are shifted back into the hole, so the
+// table never needs tombstones.
+static void removeTraceAt(WrenJitState* jit, uint32_t idx)
 {
-    (void)vm;
-    if (jit == NULL || jit->traces == NULL) return;
+    if (jit->traces[idx].doomed) jit->doomed_count--;
+    liveRemove(jit, jit->traces[idx].live_index);
+    freeTraceResources(jit, &jit->traces[idx]);
+
+    uint32_t mask = jit->trace_capacity - 1;
+    uint32_t hole = idx;
+    uint32_t j = hole;
+    for (;;) {
+        j = (j + 1) & mask;
+        if (jit->traces[j].anchor_pc == NULL) break;
+        uint32_t home = hash_pc(jit->traces[j].anchor_pc) & mask;
+        if (probeStays(hole, j, home)) continue;
+        jit->traces[hole] = jit->traces[j];
+        hole = j;
+    }
+    memset(&jit->traces[hole], 0, sizeof(JitTrace));
+    jit->trace_count--;
+}
 
+static bool findTraceIndex(WrenJitState* jit, uint8_t* pc, uint32_t* out)
+{
+    if (jit == NULL || jit->traces == NULL || pc == NULL) return false;
+
+    uint32_t mask = jit->trace_capacity - 1;
+    uint32_t idx = hash_pc(pc) & mask;
     for (uint32_t i = 0; i < jit->trace_capacity; i++) {
-        JitTrace* t = &jit->traces[i];
-        if (t->anchor_pc == NULL) continue;
+        if (jit->traces[idx].anchor_pc == NULL) return false;
+        if (jit->traces[idx].anchor_pc == pc) {
+            *out = idx;
+            return true;
+        }
+        idx = (idx + 1) & mask;
+    }
+    return false;
+}
+
+bool wrenJitRemoveTrace(WrenJitState* jit, uint8_t* pc)
+{
+    uint32_t idx;
+    if (!findTraceIndex(jit, pc, &idx)) return false;
+
+    ownerRemoveAnchor(jit, jit->traces[idx].owner, pc);
+    removeTraceAt(jit, idx);
+    return true;
+}
+
+void wrenJitInvalidateFn(WrenJitState* jit, void* fn)
+{
+    if (jit == NULL) return;
+
+    JitOwnerEntry* e = ownerFind(jit, fn);
+    if (e == NULL) return;
+
+    for (uint32_t i = 0; i < e->count; i++) {
+        uint32_t idx;
+        if (!findTraceIndex(jit, e->anchors[i], &idx)) continue;
+        if (jit->executing > 0) {
+            // The GC ran from inside a trace. The function is gone, so the
+            // trace can never be entered again; free it once the running
+            // trace has returned.
+            if (!jit->traces[idx].doomed) jit->doomed_count++;
+            jit->traces[idx].doomed = true;
+        } else {
+            removeTraceAt(jit, idx);
+        }
+    }
+    ownerRemoveEntry(jit, e);
+}
+
+// Mark a trace to be removed by the next wrenJitLookup.
+static void doomTrace(WrenJitState* jit, JitTrace* t)
+{
+    if (t->doomed) return;
+    t->doomed = true;
+    jit->doomed_count++;
+}
+
+// Remove the trace at pc, or only doom it if a trace is running.
+static void dropTrace(WrenJitState* jit, uint8_t* pc)
+{
+    if (jit->executing == 0) {
+        wrenJitRemoveTrace(jit, pc);
+        return;
+    }
+    JitTrace* t = findTrace(jit, pc);
+    if (t != NULL) doomTrace(jit, t);
+}
+
+// Remove every doomed trace. Walks the live list backwards because removal
+// moves the last anchor into the freed position.
+static void purgeDoomed(WrenJitState* jit)
+{
+    for (uint32_t i = jit->live_count; i-- > 0 && jit->doomed_count > 0;) {
+        uint8_t* pc = jit->live_anchors[i];
+        JitTrace* t = findTrace(jit, pc);
+        if (t == NULL || !t->doomed) continue;
+        wrenJitRemoveTrace(jit, pc);
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Reassigned module variables
+// ---------------------------------------------------------------------------
+
+static uint32_t hashModVar(void* module, uint32_t index)
+{
+    return hash_ptr(module) ^ (index * 2654435761u);
+}
+
+static JitModVarEntry* modVarFind(WrenJitState* jit, void* module,
+                                  uint32_t index)
+{
+    if (jit->modvars == NULL) return NULL;
+
+    uint32_t mask = jit->modvar_capacity - 1;
+    uint32_t idx = hashModVar(module, index) & mask;
+    for (uint32_t i = 0; i < jit->modvar_capacity; i++) {
+        JitModVarEntry* e = &jit->modvars[idx];
+        if (e->module == NULL) return NULL;
+        if (e->module == module && e->index == index) return e;
+        idx = (idx + 1) & mask;
+    }
+    return NULL;
+}
+
+static bool modVarGrow(WrenJitState* jit)
+{
+    uint32_t new_cap = jit->modvar_capacity == 0 ? JIT_MODVAR_INITIAL_CAPACITY
+                                                 : jit->modvar_capacity * 2;
+    JitModVarEntry* grown =
+        (JitModVarEntry*)calloc(new_cap, sizeof(JitModVarEntry));
+    if (grown == NULL) return false;
+
+    uint32_t new_mask = new_cap - 1;
+    for (uint32_t i = 0; i < jit->modvar_capacity; i++) {
+        JitModVarEntry* e = &jit->modvars[i];
+        if (e->module == NULL) continue;
+
+        uint32_t idx = hashModVar(e->module, e->index) & new_mask;
+        while (grown[idx].module != NULL) {
+            idx = (idx + 1) & new_mask;
+        }
+        grown[idx] = *e;
+    }
 
-        // Each gc_root should be marked via wrenGrayObj(vm, root).
-        // Since we don't have the Wren GC header here yet, this is a
-        // placeholder that iterates the roots. The actual call will be:
-        //   for (int j = 0; j < t->num_gc_roots; j++) {
-        //       wrenGrayObj(vm, (Obj*)t->gc_roots[j]);
-        //   }
-        (void)t;
+    free(jit->modvars);
+    jit->modvars = grown;
+    jit->modvar_capacity = new_cap;
+    return true;
+}
+
+static JitModVarEntry* modVarEnsure(WrenJitState* jit, void* module,
+                                    uint32_t index)
+{
+    JitModVarEntry* e = modVarFind(jit, module, index);
+    if (e != NULL) return e;
+
+    if (jit->modvar_count * 10 >= jit->modvar_capacity * 7) {
+        if (!modVarGrow(jit)) return NULL;
     }
+    uint32_t mask = jit->modvar_capacity - 1;
+    uint32_t idx = hashModVar(module, index) & mask;
+    while (jit->modvars[idx].module != NULL) {
+        idx = (idx + 1) & mask;
+    }
+    e = &jit->modvars[idx];
+    e->module = module;
+    e->index = index;
+    jit->modvar_count++;
+    return e;
+}
+
+bool wrenJitModuleVarStable(WrenJitState* jit, void* module, int index)
+{
+    if (jit == NULL || module == NULL || index < 0) return false;
+    return modVarFind(jit, module, (uint32_t)index) == NULL;
+}
+
+bool wrenJitModuleVarReassigned(WrenJitState* jit, void* module, int index)
+{
+    if (jit == NULL || module == NULL || index < 0) return false;
+    return modVarEnsure(jit, module, (uint32_t)index) != NULL;
+}
+
+// ---------------------------------------------------------------------------
+// Code budget
+// ---------------------------------------------------------------------------
+
+// Whether a should be evicted before b: least recently used first, and of
+// traces last used at the same tick (none has run since it was compiled),
+// the one entered least often.
+static bool evictsBefore(const JitTrace* a, const JitTrace* b)
+{
+    if (a->last_used != b->last_used) return a->last_used < b->last_used;
+    return a->exec_count < b->exec_count;
+}
+
+// Evict traces until the retained bytes fit the budget. The trace anchored
+// at `keep` (the one just compiled) is evicted only if it alone is over
+// budget.
+static void enforceCodeBudget(WrenJitState* jit, uint8_t* keep)
+{
+    if (jit->code_budget == 0) return;
+
+    while (jit->retained_bytes > jit->code_budget && jit->trace_count > 0) {
+        JitTrace* victim = NULL;
+        for (uint32_t i = 0; i < jit->live_count; i++) {
+            JitTrace* t = findTrace(jit, jit->live_anchors[i]);
+            if (t == NULL || t->anchor_pc == keep) continue;
+            if (victim == NULL || evictsBefore(t, victim)) {
+                victim = t;
+            }
+        }
+        if (victim == NULL) {
+            if (keep == NULL) break;
+            victim = wrenJitLookup(jit, keep);
+            if (victim == NULL) break;
+            keep = NULL;
+        }
+
+        // Removal frees the entry, so take the anchor first. The loop must
+        // get hot again, with backoff, before it is re-recorded.
+        uint8_t* pc = victim->anchor_pc;
+        wrenJitRemoveTrace(jit, pc);
+        wrenJitHotBackoff(jit, pc);
+        jit->traces_evicted++;
+    }
+}
+
+// Whether the next mark should keep this trace's constants alive.
+static bool traceRootsStrong(WrenJitState* jit, const JitTrace* t)
+{
+    switch (jit->root_policy) {
+        case JIT_ROOTS_STRONG: return true;
+        case JIT_ROOTS_WEAK:   return false;
+        case JIT_ROOTS_ADAPTIVE:
+        default:
+            // Hot means it ran since the previous collection. Cold traces
+            // should not pin what may be a large object graph.
+            return t->exec_count != t->gc_exec_count;
+    }
+}
+
+// Drop weak traces that embed an object no marked root reaches. Runs once
+// the gray objects are blackened, while Obj::isDark still tells live from
+// dead.
+static void sweepWeakTraces(WrenJitState* jit)
+{
+    // Backwards, since removal moves the last anchor into the hole.
+    for (uint32_t i = jit->live_count; i-- > 0;) {
+        uint8_t* pc = jit->live_anchors[i];
+        JitTrace* t = findTrace(jit, pc);
+        if (t == NULL || !t->weak_roots || t->doomed) continue;
+
+        bool dead = false;
+        for (uint16_t j = 0; j < t->num_gc_roots && !dead; j++) {
+            dead = !((Obj*)t->gc_roots[j])->isDark;
+        }
+        if (!dead) continue;
+
+        jit->traces_collected++;
+        dropTrace(jit, pc);
+    }
+}
+
+void wrenJitMarkRoots(WrenVM* vm, WrenJitState* jit)
+{
+    if (jit == NULL) return;
+
+    bool any_weak = false;
+    for (uint32_t i = 0; i < jit->live_count; i++) {
+        JitTrace* t = findTrace(jit, jit->live_anchors[i]);
+        if (t == NULL || t->doomed) continue;
+
+        // A trace that is running (the GC was triggered from one of its
+        // helpers) must keep its constants whatever the policy says.
+        bool strong = jit->executing > 0 || traceRootsStrong(jit, t);
+        t->weak_roots = !strong;
+        t->gc_exec_count = t->exec_count;
+        if (!strong) {
+            any_weak = true;
+            continue;
+        }
+
+        for (uint16_t j = 0; j < t->num_gc_roots; j++) {
+            wrenGrayObj(vm, (Obj*)t->gc_roots[j]);
+        }
+    }
+    if (!any_weak) return;
+
+    // Trace everything reachable from the roots grayed so far, then drop
+    // the weak traces whose constants it missed. The collector blackens the
+    // rest of the heap as usual afterwards. Roots it grays after this call
+    // can only make a dropped trace's constant live again, which costs a
+    // recompile but never leaves a freed object in native code.
+    wrenBlackenObjects(vm);
+    sweepWeakTraces(jit);
 }
 
 // ---------------------------------------------------------------------------
 // wrenJitCompileAndStore
 // ---------------------------------------------------------------------------
 
+// Whether the recorded loop body has a guard that can leave the trace. The
+// entry snapshot does not count: it is only used by hoisted guards.
+static bool loopHasGuard(const IRBuffer* ir)
+{
+    for (uint16_t i = ir->loop_header + 1; i < ir->count; i++) {
+        const IRNode* n = &ir->nodes[i];
+        if ((n->flags & IR_FLAG_GUARD) && !(n->flags & IR_FLAG_DEAD))
+            return true;
+    }
+    return false;
+}
+
+// Count the room side exits need to re-enter inlined methods: each frame's
+// slots above the anchor's stackStart, and the deepest chain of frames.
+static void reserveExitFrames(JitTrace* trace)
+{
+    int slots = trace->stack_slots;
+    int frames = 0;
+    if (trace->snapshots == NULL) return;
+    for (uint16_t i = 0; i < trace->num_snapshots; i++) {
+        const JitSnapshot* snap = &trace->snapshots[i];
+        for (int f = 0; f < snap->num_frames; f++) {
+            ObjClosure* closure = (ObjClosure*)snap->frames[f].closure;
+            int top = snap->frames[f].base + closure->fn->maxSlots;
+            if (top > slots) slots = top;
+        }
+        if (snap->num_frames > frames) frames = snap->num_frames;
+    }
+    trace->stack_slots = (uint16_t)slots;
+    trace->exit_frames = (uint8_t)frames;
+}
+
+// Copy the module variables the recorder folded, with their values, so
+// wrenJitExecute can check them. Returns false if out of memory.
+static bool recordModVarChecks(JitTrace* trace, const JitRecorder* rec)
+{
+    if (rec->num_modvar_deps == 0) return true;
+
+    trace->modvar_checks = (JitModVarCheck*)calloc(
+        (size_t)rec->num_modvar_deps, sizeof(JitModVarCheck));
+    if (trace->modvar_checks == NULL) return false;
+    for (int i = 0; i < rec->num_modvar_deps; i++) {
+        const JitModVarRef* ref = &rec->modvar_deps[i];
+        trace->modvar_checks[i].module = ref->module;
+        trace->modvar_checks[i].index = ref->index;
+        trace->modvar_checks[i].value = ref->value;
+    }
+    trace->num_modvar_checks = (uint16_t)rec->num_modvar_deps;
+    return true;
+}
+
 JitTrace* wrenJitCompileAndStore(WrenVM* vm, WrenJitState* jit,
                                    ObjFiber* fiber, void* framePtr)
 {
@@ -257,12 +1088,11 @@ JitTrace* wrenJitCompileAndStore(WrenVM* vm, WrenJitState* jit,
     if (!jit || (jit->state != JIT_STATE_RECORDING &&
                  jit->state != JIT_STATE_COMPILING)) return NULL;
 
-    // Compute module variables base for offset-based codegen.
-    void* modVarsBase = NULL;
+    // Remember which function owns the anchor so the trace dies with it.
+    ObjFn* ownerFn = NULL;
     if (fiber && fiber->numFrames > 0) {
         CallFrame* frame = &fiber->frames[fiber->numFrames - 1];
-        if (frame->closure && frame->closure->fn && frame->closure->fn->module)
-            modVarsBase = (void*)frame->closure->fn->module->variables.data;
+        if (frame->closure) ownerFn = frame->closure->fn;
     }
 
     // Transition out of recording state.
@@ -272,20 +1102,34 @@ JitTrace* wrenJitCompileAndStore(WrenVM* vm, WrenJitState* jit,
     JitRecorder* rec = jitRecorderGet(jit);
     if (!rec) {
         fprintf(stderr, "[JIT] compile: no recorder\n");
+        wrenJitHotBackoff(jit, jit->anchor_pc);
         jit->traces_aborted++;
         return NULL;
     }
     IRBuffer* ir = &rec->ir;
 
-    // Require at least one guard/arithmetic node between LOOP_HEADER and
-    // LOOP_BACK. A trace without guards would loop forever in native code.
-    if (ir->snapshot_count == 0) {
-        fprintf(stderr, "[JIT] compile: no snapshots, aborting\n");
+    // Variables the trace writes are not constant. Traces that folded one
+    // find it changed when they are next entered.
+    for (int i = 0; i < rec->num_modvar_stores; i++) {
+        JitModVarRef* ref = &rec->modvar_stores[i];
+        if (!wrenJitModuleVarReassigned(jit, ref->module, ref->index)) {
+            wrenJitHotBackoff(jit, jit->anchor_pc);
+            jit->traces_aborted++;
+            return NULL;
+        }
+    }
+
+    // Require at least one guard between LOOP_HEADER and LOOP_BACK. A trace
+    // without guards would loop forever in native code.
+    if (!loopHasGuard(ir)) {
+        fprintf(stderr, "[JIT] compile: no guards, aborting\n");
+        wrenJitHotBackoff(jit, jit->anchor_pc);
         jit->traces_aborted++;
         return NULL;
     }
 
     // Run optimizer.
+    ir->unroll_factor = (uint8_t)jit->unroll_factor;
     fprintf(stderr, "[JIT] DEBUG: before irOptimize, count=%u\n", ir->count);
     irOptimize(ir);
     fprintf(stderr, "[JIT] DEBUG: after irOptimize, count=%u\n", ir->count);
@@ -303,21 +1147,51 @@ JitTrace* wrenJitCompileAndStore(WrenVM* vm, WrenJitState* jit,
     // Dump IR if requested.
     if (getenv("WREN_JIT_DUMP_IR")) irBufferDump(ir);
 
+    // The code arena is created on first compile so embedders can set
+    // huge_pages after wrenJitInit.
+    if (jit->mem_pool == NULL) {
+        jit->mem_pool = jitPoolCreate(jit->huge_pages);
+        if (jit->mem_pool == NULL) {
+            regAllocFree(&ra);
+            wrenJitHotBackoff(jit, jit->anchor_pc);
+            jit->traces_aborted++;
+            return NULL;
+        }
+    }
+
     // Code generation.  (ir is part of the recorder struct, not heap-allocated.)
     fprintf(stderr, "[JIT] DEBUG: wrenJitCodegen start\n");
-    JitTrace* trace = wrenJitCodegen(vm, ir, &ra, jit->anchor_pc, modVarsBase);
+    JitTrace* trace = wrenJitCodegen(vm, ir, &ra, jit->anchor_pc,
+                                     jit->mem_pool);
     fprintf(stderr, "[JIT] DEBUG: wrenJitCodegen done, trace=%p\n", (void*)trace);
     regAllocFree(&ra);
 
     if (!trace) {
         fprintf(stderr, "[JIT] compile: codegen failed\n");
+        wrenJitHotBackoff(jit, jit->anchor_pc);
         jit->traces_aborted++;
         return NULL;
     }
 
     trace->anchor_pc = jit->anchor_pc;
-    wrenJitStoreTrace(jit, trace);
-    return trace;
+    trace->owner = ownerFn;
+    trace->entry_exit = ir->entry_snapshot;
+    reserveExitFrames(trace);
+    if (!recordModVarChecks(trace, rec) || !wrenJitStoreTrace(jit, trace)) {
+        freeTraceMemory(jit, trace);
+        free(trace);
+        wrenJitHotBackoff(jit, jit->anchor_pc);
+        jit->traces_aborted++;
+        return NULL;
+    }
+    jit->hotbackoff[hotcountIndex(jit->anchor_pc)] = 0;
+    free(trace);
+
+    // Make room under the code budget. This may evict the new trace itself
+    // if it alone exceeds the budget. Hand back the cached entry (if any)
+    // rather than the temporary codegen produced.
+    enforceCodeBudget(jit, jit->anchor_pc);
+    return wrenJitLookup(jit, jit->anchor_pc);
 }
 
 // ---------------------------------------------------------------------------
@@ -328,7 +1202,6 @@ void wrenJitRestoreExit(WrenVM* vm, WrenJitState* jit,
                          ObjFiber* fiber, void* framePtr,
                          JitTrace* trace, int exitIdx)
 {
-    (void)vm;
     (void)jit;
     (void)framePtr;
 
@@ -336,9 +1209,21 @@ void wrenJitRestoreExit(WrenVM* vm, WrenJitState* jit,
     if (exitIdx < 0 || exitIdx >= (int)trace->num_snapshots) return;
 
     JitSnapshot* snap = &trace->snapshots[exitIdx];
+
+    // Re-enter the inlined methods the exit is inside. wrenJitExecute only
+    // ran the trace if their slots and frames fit the fiber as it is.
     CallFrame* frame = &fiber->frames[fiber->numFrames - 1];
+    Value* stackStart = frame->stackStart;
+    for (int i = 0; i < snap->num_frames; i++) {
+        // The caller resumes after the call once the method returns.
+        frame->ip = snap->frames[i].return_pc;
+        frame = &fiber->frames[fiber->numFrames++];
+        frame->closure = (ObjClosure*)snap->frames[i].closure;
+        frame->stackStart = stackStart + snap->frames[i].base;
+    }
+
     frame->ip = snap->resume_pc;
     // Restore the stack top to the depth captured at the snapshot.
     // The side-exit stub already wrote all live SSA values back to the stack.
-    fiber->stackTop = frame->stackStart + snap->stack_depth;
+    fiber->stackTop = stackStart + snap->stack_depth;
 }
@@ -17,6 +17,16 @@ typedef struct sObjClass ObjClass;
 // JIT hot count threshold
 #define JIT_HOT_THRESHOLD 50
 
+// Hot loops are counted in a small shared table of countdown counters
+// indexed by a hash of the CODE_LOOP instruction's address, as in LuaJIT's
+// hotcount table. Collisions only make a loop trigger early.
+// Must be a power of two.
+#define JIT_HOTCOUNT_SIZE 64
+
+// Each failed recording at a loop doubles the delay before it is tried
+// again, up to hot_threshold << JIT_HOTCOUNT_MAX_BACKOFF iterations.
+#define JIT_HOTCOUNT_MAX_BACKOFF 8
+
 // Maximum traces in the cache
 #define JIT_MAX_TRACES 1024
 
@@ -26,6 +36,37 @@ typedef struct sObjClass ObjClass;
 // (LOAD, UNBOX, PHI). 32 handles up to 10 loop-carried module variables.
 #define JIT_PRE_HEADER_SLOTS 32
 
+// Default number of iterations a short traced loop body is unrolled to
+// (see irOptUnrollLoop): 1 (off), 2, 4 or 8.
+#define JIT_UNROLL_FACTOR 4
+
+// Strings a running trace may still grow in place (IR_STRING_APPEND).
+#define JIT_MAX_STRING_BUILDERS 8
+
+// A string allocated by wrenJitStringAppend with room to grow. Only valid
+// during the trace execution that allocated it.
+typedef struct {
+    void* string;            // ObjString*
+    uint32_t capacity;       // bytes available for characters
+} JitStringBuilder;
+
+// How the GC treats the objects a trace embeds as constants. A trace whose
+// weak constant is not reached by the collector is dropped before the sweep
+// frees it.
+typedef enum {
+    JIT_ROOTS_STRONG,        // every trace keeps its constants alive
+    JIT_ROOTS_WEAK,          // no trace does; a trace dies with its constants
+    JIT_ROOTS_ADAPTIVE,      // traces run since the last GC are strong,
+                             // cold ones are weak (the default)
+} JitRootPolicy;
+
+// A module variable a trace folded into a constant, and the value folded.
+typedef struct JitModVarCheck {
+    void* module;            // ObjModule*
+    uint32_t index;
+    uint64_t value;
+} JitModVarCheck;
+
 // Trace execution function type
 // Returns 0 on success, or exit index (1-based) on side exit
 // Args: vm, fiber, stackStart, moduleVarsData (Value* to module variables array)
@@ -46,9 +87,36 @@ typedef struct {
     void** gc_roots;
     uint16_t num_gc_roots;
 
+    // Folded module variables; the trace is only entered while each still
+    // holds its value.
+    JitModVarCheck* modvar_checks;
+    uint16_t num_modvar_checks;
+
+    // Stack slots (from the anchor frame's stackStart) the trace reads or
+    // writes, including those of inlined methods, and the most call frames
+    // a side exit pushes. The trace only runs when both already fit.
+    uint16_t stack_slots;
+    uint8_t exit_frames;
+
+    // Snapshot that resumes at the top of the loop with nothing run.
+    uint16_t entry_exit;
+
+    // Owning function (ObjFn*) whose bytecode contains anchor_pc. Used to
+    // drop the trace when the GC frees the function.
+    void* owner;
+
     // Statistics
     uint64_t exec_count;
     uint64_t exit_count;
+    uint64_t last_used;      // WrenJitState::use_clock at the last execution
+
+    // GC bookkeeping: position in WrenJitState::live_anchors, exec_count as
+    // of the last mark, and whether that mark left the roots weak.
+    uint32_t live_index;
+    uint64_t gc_exec_count;
+    bool weak_roots;
+    bool doomed;             // dropped while a trace was running; purged by
+                             // the next wrenJitLookup
 } JitTrace;
 
 // Recording state
@@ -60,11 +128,36 @@ typedef enum {
 
 // The main JIT state, attached to WrenVM
 typedef struct WrenJitState {
-    // Trace cache: open-addressing hash table keyed by anchor_pc
+    // Trace cache: open-addressing hash table keyed by anchor_pc.
+    // Deletion uses backward-shift, so there are no tombstones.
     JitTrace* traces;
     uint32_t trace_capacity;
     uint32_t trace_count;
 
+    // Per-function trace index: open-addressing table keyed by ObjFn*, so
+    // the traces of a collected function are found without a cache scan.
+    struct JitOwnerEntry* owners;
+    uint32_t owner_capacity;
+    uint32_t owner_count;
+
+    // Module variables seen reassigned, which are never folded: open-
+    // addressing table keyed by (module, variable index).
+    struct JitModVarEntry* modvars;
+    uint32_t modvar_capacity;
+    uint32_t modvar_count;
+
+    // Dense list of cached anchors, so GC work is proportional to the
+    // number of traces rather than the table capacity.
+    uint8_t** live_anchors;
+    uint32_t live_count;
+    uint32_t live_capacity;
+
+    // Nesting depth of wrenJitExecute. While a trace runs, traces dropped by
+    // the GC are only marked doomed: removing them would move cache entries
+    // under the running trace.
+    int executing;
+    uint32_t doomed_count;
+
     // Recording state
     JitRecordState state;
     void* recording_ir;              // legacy field (unused, kept for ABI compat)
@@ -76,23 +169,43 @@ typedef struct WrenJitState {
     uint16_t* slot_map;
     int slot_map_size;
 
-    // Hot count array for all bytecode functions
-    // (allocated per-function, stored in ObjFn)
+    // Hot loop counters (see JIT_HOTCOUNT_SIZE) and the retry backoff
+    // exponent of each counter.
+    uint16_t hotcount[JIT_HOTCOUNT_SIZE];
+    uint8_t hotbackoff[JIT_HOTCOUNT_SIZE];
 
     // Configuration
     bool enabled;
     int hot_threshold;
+    bool huge_pages;                 // back the code arena with 2 MB pages
+    size_t code_budget;              // max bytes retained by traces (0 = no cap)
+    JitRootPolicy root_policy;
+    int unroll_factor;               // short loop bodies run this many
+                                     // iterations per trip (1 = off)
 
     // Recorder storage (opaque, allocated on first use)
     void* recorder;
 
     // Memory management
-    struct JitMemoryPool* mem_pool;   // executable memory pool
+    struct JitMemoryPool* mem_pool;   // per-VM code arena (created lazily)
+
+    // Ticks once per trace execution; stamps JitTrace::last_used.
+    uint64_t use_clock;
+
+    // Strings grown in place by the running trace. Cleared whenever a trace
+    // is entered, so a string the interpreter has seen is never written.
+    JitStringBuilder builders[JIT_MAX_STRING_BUILDERS];
+    uint32_t builder_count;
+    char* builder_scratch;           // staging for new builder strings
+    size_t builder_scratch_size;
 
     // Statistics
     uint64_t traces_compiled;
     uint64_t traces_aborted;
     uint64_t total_exits;
+    uint64_t traces_evicted;
+    uint64_t traces_collected;       // dropped because a weak constant died
+    size_t retained_bytes;           // native code + metadata of cached traces
 } WrenJitState;
 
 // ---- Public API ----
@@ -106,14 +219,63 @@ void wrenJitFree(WrenVM* vm, WrenJitState* jit);
 // Enable or disable the JIT.
 void wrenJitSetEnabled(WrenJitState* jit, bool enabled);
 
+// Cap the memory retained by compiled traces (native code plus snapshots
+// and roots) at [bytes]; 0 removes the cap. When a new trace would exceed
+// the budget, the least recently used traces are evicted, and of those
+// last used together the least often entered. Lowering the budget evicts
+// immediately.
+void wrenJitSetCodeBudget(WrenJitState* jit, size_t bytes);
+
+// Unroll short loop bodies in traces compiled from now on so that each
+// trip round the loop runs [factor] iterations. factor is rounded down to
+// 1, 2, 4 or 8; 1 turns unrolling off.
+void wrenJitSetUnrollFactor(WrenJitState* jit, int factor);
+
 // Look up a compiled trace by anchor PC. Returns NULL if not found.
 JitTrace* wrenJitLookup(WrenJitState* jit, uint8_t* pc);
 
 // Execute a compiled trace. Returns 0 on success, exit index on side exit.
+// Never grows the fiber: if its stack or frames lack the room the trace's
+// inlined methods need, the trace is not run and the entry exit is taken.
 int wrenJitExecute(WrenVM* vm, JitTrace* trace);
 
-// Increment hot count for a loop at the given PC in the given function.
+// Allocate an instance of classObj for a compiled trace (IR_NEW_INSTANCE).
+// Returns the instance Value, or 0 if allocating would start a collection:
+// the trace then exits and the interpreter allocates, with every live value
+// back on the stack where the GC can see it.
+uint64_t wrenJitNewInstance(WrenVM* vm, ObjClass* classObj);
+
+// Concatenate two strings for a compiled trace (IR_STRING_APPEND). With
+// inPlace set, str is known to be unreachable once this returns, so when it
+// is a builder string of the current execution the piece is copied into its
+// spare capacity and str itself is returned. Returns 0, like
+// wrenJitNewInstance, if allocating would start a collection.
+uint64_t wrenJitStringAppend(WrenVM* vm, uint64_t str, uint64_t piece,
+                             int inPlace);
+
+// Random.float() and Random.int() for a compiled trace (IR_RANDOM): the same
+// numbers wren_opt_random.c returns, from the generator inside [random] (an
+// ObjForeign). Neither allocates.
+double wrenJitRandomFloat(void* random);
+double wrenJitRandomInt(void* random);
+
+// For a compiled trace (IR_LIST_NUM_END): the first index at or after
+// [from] whose element in [list] (an ObjList) is not a number, or the
+// list's count if there is none. The trace reads every element before that
+// index without checking its tag.
+int64_t wrenJitListNumEnd(void* list, int64_t from);
+
+// Count one iteration of the loop whose CODE_LOOP instruction is at pc.
 // Returns true if the loop just became hot (should start recording).
+bool wrenJitHotLoop(WrenJitState* jit, uint8_t* pc);
+
+// Delay the next recording attempt at pc after a recording at that loop
+// was aborted or failed to compile.
+void wrenJitHotBackoff(WrenJitState* jit, uint8_t* pc);
+
+// Older entry point kept for the instrumented interpreter: counts the loop
+// at bytecode + pc_offset. hot_counts is ignored and may be NULL, so ObjFn
+// no longer needs a counter per bytecode byte.
 bool wrenJitIncrementHot(WrenJitState* jit, uint8_t* bytecode,
                           uint16_t* hot_counts, int pc_offset);
 
@@ -132,10 +294,36 @@ static inline bool wrenJitIsRecording(const WrenJitState* jit) {
 // Returns true if recording completed (trace is ready to compile).
 bool wrenJitRecordInstruction(WrenJitState* jit, WrenVM* vm, uint8_t* ip);
 
-// Store a compiled trace into the cache.
-void wrenJitStoreTrace(WrenJitState* jit, JitTrace* trace);
-
-// Mark JIT roots for GC.
+// Store a compiled trace into the cache. The cache takes ownership of the
+// trace's code, snapshots and roots; the JitTrace struct itself is copied.
+// Returns false if out of memory, in which case the caller still owns them.
+bool wrenJitStoreTrace(WrenJitState* jit, JitTrace* trace);
+
+// Remove the trace anchored at pc and free its code and metadata.
+// Returns false if no trace is anchored there. Pointers previously returned
+// by wrenJitLookup are invalidated.
+bool wrenJitRemoveTrace(WrenJitState* jit, uint8_t* pc);
+
+// Drop every trace whose anchor lies in fn's bytecode (fn is an ObjFn*).
+// The instrumented wrenFreeObj() must call this for every OBJ_FN before
+// freeing it: otherwise the function's traces stay cached under anchors
+// that later bytecode may reuse.
+void wrenJitInvalidateFn(WrenJitState* jit, void* fn);
+
+// Whether the recorder may fold the current value of variable [index] of
+// [module] (an ObjModule*) into a constant: it has not been seen reassigned.
+// A folded trace checks the value each time it is entered, so a variable
+// the interpreter writes behind the JIT's back only costs one trace.
+bool wrenJitModuleVarStable(WrenJitState* jit, void* module, int index);
+
+// Stop folding the variable: a trace stores to it, or one that folded it
+// found it changed. Returns false if out of memory.
+bool wrenJitModuleVarReassigned(WrenJitState* jit, void* module, int index);
+
+// Gray the constants of every trace that holds them strongly under the
+// current root policy, then drop the weak traces whose constants nothing
+// marked so far reaches. Called from wrenCollectGarbage() with the other
+// roots.
 void wrenJitMarkRoots(WrenVM* vm, WrenJitState* jit);
 
 // Compile the current in-progress recording and store it in the trace cache.
@@ -145,7 +333,9 @@ JitTrace* wrenJitCompileAndStore(WrenVM* vm, WrenJitState* jit,
                                   ObjFiber* fiber, void* frame);
 
 // Restore interpreter state after a side exit.
-// exitIdx is 0-based (JitTraceFunc return value - 1).
+// exitIdx is 0-based (JitTraceFunc return value - 1). An exit inside an
+// inlined method pushes that method's call frames into the room
+// wrenJitExecute checked for, so fiber->stack and fiber->frames never move.
 void wrenJitRestoreExit(WrenVM* vm, WrenJitState* jit,
                          ObjFiber* fiber, void* frame,
                          JitTrace* trace, int exitIdx);
@@ -115,9 +115,42 @@ static void getFP(const RegAllocState* ra, uint16_t ssaId,
     }
 }
 
+// An FP operand. An INT value (a counter or narrowed number meeting a
+// double) is converted into the scratch register [tmp] instead.
+static void getFPOperand(struct sljit_compiler* C, const IRBuffer* ir,
+                         const RegAllocState* ra, uint16_t ssaId, int tmp,
+                         int* reg, int* memBase, sljit_sw* memOff)
+{
+    if (ssaId < ir->count && ir->nodes[ssaId].type == IR_TYPE_INT) {
+        int r, m; sljit_sw o;
+        getGP(ra, ssaId, &r, &m, &o);
+        sljit_emit_fop1(C, SLJIT_CONV_F64_FROM_SW, tmp, 0, r, o);
+        *reg = tmp;
+        *memBase = 0;
+        *memOff = 0;
+        return;
+    }
+    getFP(ra, ssaId, reg, memBase, memOff);
+}
+
+// A guard's jump to the exit stub of its snapshot.
+typedef struct {
+    struct sljit_jump* jump;
+    uint16_t snapshot;
+} ExitJump;
+
+static void addExitJump(ExitJump* jumps, int* count, uint16_t snapId,
+                        int maxSnapshots, struct sljit_jump* jump)
+{
+    if (snapId >= (uint16_t)maxSnapshots) return;
+    jumps[*count].jump = jump;
+    jumps[*count].snapshot = snapId;
+    (*count)++;
+}
+
 // ---------------------------------------------------------------------------
 // Saved register assignments for function arguments:
-//   S0 = vm, S1 = fiber, S2 = stackStart, S3 = stackTop
+//   S0 = vm, S1 = fiber, S2 = stackStart, S3 = module variables base
 // ---------------------------------------------------------------------------
 #define REG_VM         SLJIT_S0
 #define REG_FIBER      SLJIT_S1
@@ -137,12 +170,37 @@ static void getFP(const RegAllocState* ra, uint16_t ssaId,
 // We reserve 16 bytes for box/unbox temporaries.
 #define TMP_AREA_SIZE 16
 
+// Helper calls clobber the scratch registers the allocator hands out
+// (R2-R5, FR0-FR5); traces that make one save them here around the call.
+#define CALL_SAVE_GP   (NUM_SCRATCHES - 2)
+#define CALL_SAVE_SIZE ((CALL_SAVE_GP + NUM_FP_SCRATCH) * 8)
+
+static void saveCallRegs(struct sljit_compiler* C, int off)
+{
+    for (int k = 0; k < CALL_SAVE_GP; k++)
+        sljit_emit_op1(C, SLJIT_MOV, SLJIT_MEM1(SLJIT_SP), off + k * 8,
+                       SLJIT_R(k + 2), 0);
+    for (int k = 0; k < NUM_FP_SCRATCH; k++)
+        sljit_emit_fop1(C, SLJIT_MOV_F64, SLJIT_MEM1(SLJIT_SP),
+                        off + (CALL_SAVE_GP + k) * 8, SLJIT_FR(k), 0);
+}
+
+static void restoreCallRegs(struct sljit_compiler* C, int off)
+{
+    for (int k = 0; k < CALL_SAVE_GP; k++)
+        sljit_emit_op1(C, SLJIT_MOV, SLJIT_R(k + 2), 0,
+                       SLJIT_MEM1(SLJIT_SP), off + k * 8);
+    for (int k = 0; k < NUM_FP_SCRATCH; k++)
+        sljit_emit_fop1(C, SLJIT_MOV_F64, SLJIT_FR(k), 0,
+                        SLJIT_MEM1(SLJIT_SP), off + (CALL_SAVE_GP + k) * 8);
+}
+
 // ---------------------------------------------------------------------------
 // Code generation
 // ---------------------------------------------------------------------------
 
 JitTrace* wrenJitCodegen(void* vm, IRBuffer* ir, RegAllocState* ra,
-                         uint8_t* anchorPC, void* modVarsBase)
+                         uint8_t* anchorPC, struct JitMemoryPool* pool)
 {
     if (!ir || ir->count == 0) return NULL;
 
@@ -154,6 +212,27 @@ JitTrace* wrenJitCodegen(void* vm, IRBuffer* ir, RegAllocState* ra,
     int localSize = spillBytes + TMP_AREA_SIZE;
     // Offset for the temporary area (used for box/unbox).
     int tmpOff = spillBytes;
+    // Offset of the register save area for helper calls, if any.
+    int callSaveOff = localSize;
+    for (uint16_t i = 0; i < ir->count; i++) {
+        if ((ir->nodes[i].op == IR_NEW_INSTANCE ||
+             ir->nodes[i].op == IR_STRING_APPEND ||
+             ir->nodes[i].op == IR_RANDOM ||
+             ir->nodes[i].op == IR_LIST_NUM_END) &&
+            !(ir->nodes[i].flags & IR_FLAG_DEAD)) {
+            localSize += CALL_SAVE_SIZE;
+            break;
+        }
+    }
+    // A PHI whose back-edge value is another PHI must read it before
+    // LOOP_BACK overwrites it; those values are parked here first.
+    int phiParkOff = localSize;
+    for (uint16_t p = 0; p < ir->loop_header && p < ir->count; p++) {
+        const IRNode* phi = &ir->nodes[p];
+        if (!(phi->flags & IR_FLAG_DEAD) && phi->op == IR_PHI &&
+            phi->op2 < ir->count && ir->nodes[phi->op2].op == IR_PHI)
+            localSize += 8;
+    }
 
     // Prologue: 4 pointer args -> S0..S3.
     // SLJIT_ARGS4(W, P, P, P, P): return machine word, 4 pointer args.
@@ -173,17 +252,15 @@ JitTrace* wrenJitCodegen(void* vm, IRBuffer* ir, RegAllocState* ra,
     // ---------------------------------------------------------------------------
     int maxSnapshots = (int)ir->snapshot_count;
 
-    // Allocate arrays for side-exit jumps and labels.
-    // exitJumps[snapIdx] = linked list of jumps to that exit stub.
-    struct sljit_jump** exitJumps = (struct sljit_jump**)calloc(
-        (size_t)(maxSnapshots + 1), sizeof(struct sljit_jump*));
-    // We'll chain multiple jumps per snapshot via a parallel array.
-    // Simple approach: store up to 16 jumps per snapshot.
-    #define MAX_EXITS_PER_SNAP 16
-    struct sljit_jump* exitJumpArr[IR_MAX_SNAPSHOTS][MAX_EXITS_PER_SNAP];
-    int exitJumpCount[IR_MAX_SNAPSHOTS];
-    memset(exitJumpCount, 0, sizeof(exitJumpCount));
-    memset(exitJumpArr, 0, sizeof(exitJumpArr));
+    // Guard jumps, bound to their snapshot's exit stub once the stubs are
+    // emitted. A guard emits at most two jumps.
+    ExitJump* exitJumps = (ExitJump*)calloc((size_t)ir->count * 2 + 1,
+                                            sizeof(ExitJump));
+    int exitJumpCount = 0;
+    if (!exitJumps) {
+        sljit_free_compiler(C);
+        return NULL;
+    }
 
     // Label for loop header (set when we encounter IR_LOOP_HEADER).
     struct sljit_label* loopHeaderLabel = NULL;
@@ -362,7 +439,7 @@ JitTrace* wrenJitCodegen(void* vm, IRBuffer* ir, RegAllocState* ra,
 
             int srcReg, srcMem;
             sljit_sw srcOff;
-            getFP(ra, valId, &srcReg, &srcMem, &srcOff);
+            getFPOperand(C, ir, ra, valId, SLJIT_FR0, &srcReg, &srcMem, &srcOff);
 
             int dstReg, dstMem;
             sljit_sw dstOff;
@@ -422,6 +499,30 @@ JitTrace* wrenJitCodegen(void* vm, IRBuffer* ir, RegAllocState* ra,
             // FMOV freg ← gpreg (bit-reinterpret GP as FP).
             sljit_emit_fcopy(C, SLJIT_COPY_TO_F64, SLJIT_FR0, gpSrc);
 
+            if (n->flags & IR_FLAG_CHECKED) {
+                // Exit unless the Value is an integer within +-2^53: the
+                // truncated result must convert back to the same bits
+                // (this also rejects NaN-tagged non-numbers and -0).
+                uint16_t snapId = n->imm.snapshot_id;
+                sljit_emit_fop1(C, SLJIT_CONV_SW_FROM_F64,
+                                SLJIT_R0, 0, SLJIT_FR0, 0);
+                sljit_emit_fop1(C, SLJIT_CONV_F64_FROM_SW,
+                                SLJIT_FR1, 0, SLJIT_R0, 0);
+                sljit_emit_fcopy(C, SLJIT_COPY_FROM_F64, SLJIT_FR1, SLJIT_R1);
+                struct sljit_jump* inexact = sljit_emit_cmp(C, SLJIT_NOT_EQUAL,
+                    SLJIT_R1, 0, srcReg, srcOff);
+                sljit_emit_op2(C, SLJIT_ADD, SLJIT_R1, 0, SLJIT_R0, 0,
+                               SLJIT_IMM, (sljit_sw)1 << 53);
+                struct sljit_jump* big = sljit_emit_cmp(C, SLJIT_GREATER,
+                    SLJIT_R1, 0, SLJIT_IMM, (sljit_sw)1 << 54);
+                addExitJump(exitJumps, &exitJumpCount, snapId, maxSnapshots,
+                            inexact);
+                addExitJump(exitJumps, &exitJumpCount, snapId, maxSnapshots,
+                            big);
+                sljit_emit_op1(C, SLJIT_MOV, dstReg, dstOff, SLJIT_R0, 0);
+                break;
+            }
+
             // FCVTZS → truncate double to signed integer.
             if (dstMem) {
                 sljit_emit_fop1(C, SLJIT_CONV_SW_FROM_F64,
@@ -596,6 +697,26 @@ JitTrace* wrenJitCodegen(void* vm, IRBuffer* ir, RegAllocState* ra,
                 if (s1m) { sljit_emit_op1(C, SLJIT_MOV, SLJIT_R0, 0, s1r, s1o); a = SLJIT_R0; }
                 if (s2m) { sljit_emit_op1(C, SLJIT_MOV, SLJIT_R1, 0, s2r, s2o); b = SLJIT_R1; }
 
+                if (n->flags & IR_FLAG_CHECKED) {
+                    // Exit unless the result is exactly a double: no int64
+                    // overflow, and within +-2^53 (unsigned compare of the
+                    // biased value).
+                    uint16_t snapId = n->imm.snapshot_id;
+                    sljit_emit_op2(C, iop | SLJIT_SET_OVERFLOW, SLJIT_R0, 0,
+                                   a, 0, b, 0);
+                    struct sljit_jump* ovf = sljit_emit_jump(C, SLJIT_OVERFLOW);
+                    sljit_emit_op2(C, SLJIT_ADD, SLJIT_R1, 0, SLJIT_R0, 0,
+                                   SLJIT_IMM, (sljit_sw)1 << 53);
+                    struct sljit_jump* big = sljit_emit_cmp(C, SLJIT_GREATER,
+                        SLJIT_R1, 0, SLJIT_IMM, (sljit_sw)1 << 54);
+                    addExitJump(exitJumps, &exitJumpCount, snapId, maxSnapshots,
+                                ovf);
+                    addExitJump(exitJumps, &exitJumpCount, snapId, maxSnapshots,
+                                big);
+                    sljit_emit_op1(C, SLJIT_MOV, dr, dof, SLJIT_R0, 0);
+                    break;
+                }
+
                 if (dm) {
                     sljit_emit_op2(C, iop, SLJIT_R0, 0, a, 0, b, 0);
                     sljit_emit_op1(C, SLJIT_MOV, dr, dof, SLJIT_R0, 0);
@@ -619,8 +740,10 @@ JitTrace* wrenJitCodegen(void* vm, IRBuffer* ir, RegAllocState* ra,
             int src2Reg, src2Mem; sljit_sw src2Off;
             int dstReg, dstMem; sljit_sw dstOff;
 
-            getFP(ra, n->op1, &src1Reg, &src1Mem, &src1Off);
-            getFP(ra, n->op2, &src2Reg, &src2Mem, &src2Off);
+            getFPOperand(C, ir, ra, n->op1, SLJIT_FR0,
+                         &src1Reg, &src1Mem, &src1Off);
+            getFPOperand(C, ir, ra, n->op2, SLJIT_FR1,
+                         &src2Reg, &src2Mem, &src2Off);
             getFP(ra, n->id, &dstReg, &dstMem, &dstOff);
 
             // SLJIT fop2 can handle memory operands directly in some cases,
@@ -653,7 +776,7 @@ JitTrace* wrenJitCodegen(void* vm, IRBuffer* ir, RegAllocState* ra,
         case IR_NEG: {
             int srcReg, srcMem; sljit_sw srcOff;
             int dstReg, dstMem; sljit_sw dstOff;
-            getFP(ra, n->op1, &srcReg, &srcMem, &srcOff);
+            getFPOperand(C, ir, ra, n->op1, SLJIT_FR0, &srcReg, &srcMem, &srcOff);
             getFP(ra, n->id, &dstReg, &dstMem, &dstOff);
 
             int sr = srcReg; sljit_sw sw2 = 0;
@@ -717,8 +840,10 @@ JitTrace* wrenJitCodegen(void* vm, IRBuffer* ir, RegAllocState* ra,
 
             int src1Reg, src1Mem; sljit_sw src1Off;
             int src2Reg, src2Mem; sljit_sw src2Off;
-            getFP(ra, n->op1, &src1Reg, &src1Mem, &src1Off);
-            getFP(ra, n->op2, &src2Reg, &src2Mem, &src2Off);
+            getFPOperand(C, ir, ra, n->op1, SLJIT_FR0,
+                         &src1Reg, &src1Mem, &src1Off);
+            getFPOperand(C, ir, ra, n->op2, SLJIT_FR1,
+                         &src2Reg, &src2Mem, &src2Off);
 
             int s1r = src1Reg;
             int s2r = src2Reg;
@@ -789,10 +914,7 @@ JitTrace* wrenJitCodegen(void* vm, IRBuffer* ir, RegAllocState* ra,
             struct sljit_jump* jmp = sljit_emit_cmp(C, SLJIT_EQUAL,
                 SLJIT_R0, 0, SLJIT_IMM, (sljit_sw)WREN_QNAN);
 
-            if (snapId < (uint16_t)maxSnapshots &&
-                exitJumpCount[snapId] < MAX_EXITS_PER_SNAP) {
-                exitJumpArr[snapId][exitJumpCount[snapId]++] = jmp;
-            }
+            addExitJump(exitJumps, &exitJumpCount, snapId, maxSnapshots, jmp);
             break;
         }
 
@@ -813,6 +935,13 @@ JitTrace* wrenJitCodegen(void* vm, IRBuffer* ir, RegAllocState* ra,
                 sljit_emit_op1(C, SLJIT_MOV, SLJIT_R1, 0, srcReg, 0);
             }
 
+            // Not an object (a Num, null or bool): exit before reading
+            // through the "pointer".
+            sljit_emit_op2(C, SLJIT_AND, SLJIT_R0, 0, SLJIT_R1, 0,
+                           SLJIT_IMM, (sljit_sw)(WREN_SIGN_BIT | WREN_QNAN));
+            struct sljit_jump* notObj = sljit_emit_cmp(C, SLJIT_NOT_EQUAL,
+                SLJIT_R0, 0, SLJIT_IMM, (sljit_sw)(WREN_SIGN_BIT | WREN_QNAN));
+
             // Unmask to get obj pointer: ptr = val & ~(SIGN_BIT | QNAN)
             sljit_emit_op2(C, SLJIT_AND, SLJIT_R1, 0, SLJIT_R1, 0,
                            SLJIT_IMM, (sljit_sw)~(WREN_SIGN_BIT | WREN_QNAN));
@@ -824,10 +953,9 @@ JitTrace* wrenJitCodegen(void* vm, IRBuffer* ir, RegAllocState* ra,
             struct sljit_jump* jmp = sljit_emit_cmp(C, SLJIT_NOT_EQUAL,
                 SLJIT_R0, 0, SLJIT_IMM, (sljit_sw)(uintptr_t)expectedClass);
 
-            if (snapId < (uint16_t)maxSnapshots &&
-                exitJumpCount[snapId] < MAX_EXITS_PER_SNAP) {
-                exitJumpArr[snapId][exitJumpCount[snapId]++] = jmp;
-            }
+            addExitJump(exitJumps, &exitJumpCount, snapId, maxSnapshots,
+                        notObj);
+            addExitJump(exitJumps, &exitJumpCount, snapId, maxSnapshots, jmp);
             break;
         }
 
@@ -856,9 +984,8 @@ JitTrace* wrenJitCodegen(void* vm, IRBuffer* ir, RegAllocState* ra,
                 // Side-exit if value == 0.
                 struct sljit_jump* jmpFalse = sljit_emit_cmp(C, SLJIT_EQUAL,
                     SLJIT_R0, 0, SLJIT_IMM, 0);
-                if (snapId < (uint16_t)maxSnapshots &&
-                    exitJumpCount[snapId] < MAX_EXITS_PER_SNAP)
-                    exitJumpArr[snapId][exitJumpCount[snapId]++] = jmpFalse;
+                addExitJump(exitJumps, &exitJumpCount, snapId, maxSnapshots,
+                            jmpFalse);
             } else {
                 // Wren Value: false and null are falsy.
                 struct sljit_jump* jmpFalse = sljit_emit_cmp(C, SLJIT_EQUAL,
@@ -866,12 +993,10 @@ JitTrace* wrenJitCodegen(void* vm, IRBuffer* ir, RegAllocState* ra,
                 struct sljit_jump* jmpNull = sljit_emit_cmp(C, SLJIT_EQUAL,
                     SLJIT_R0, 0, SLJIT_IMM, (sljit_sw)WREN_NULL_VAL);
 
-                if (snapId < (uint16_t)maxSnapshots) {
-                    if (exitJumpCount[snapId] < MAX_EXITS_PER_SNAP)
-                        exitJumpArr[snapId][exitJumpCount[snapId]++] = jmpFalse;
-                    if (exitJumpCount[snapId] < MAX_EXITS_PER_SNAP)
-                        exitJumpArr[snapId][exitJumpCount[snapId]++] = jmpNull;
-                }
+                addExitJump(exitJumps, &exitJumpCount, snapId, maxSnapshots,
+                            jmpFalse);
+                addExitJump(exitJumps, &exitJumpCount, snapId, maxSnapshots,
+                            jmpNull);
             }
             break;
         }
@@ -898,9 +1023,8 @@ JitTrace* wrenJitCodegen(void* vm, IRBuffer* ir, RegAllocState* ra,
                 // Raw boolean: side-exit if nonzero (truthy).
                 struct sljit_jump* jmpExit = sljit_emit_cmp(C, SLJIT_NOT_EQUAL,
                     SLJIT_R0, 0, SLJIT_IMM, 0);
-                if (snapId < (uint16_t)maxSnapshots &&
-                    exitJumpCount[snapId] < MAX_EXITS_PER_SNAP)
-                    exitJumpArr[snapId][exitJumpCount[snapId]++] = jmpExit;
+                addExitJump(exitJumps, &exitJumpCount, snapId, maxSnapshots,
+                            jmpExit);
             } else {
                 // Wren Value: side-exit if not false and not null.
                 struct sljit_jump* isFalse = sljit_emit_cmp(C, SLJIT_EQUAL,
@@ -909,9 +1033,8 @@ JitTrace* wrenJitCodegen(void* vm, IRBuffer* ir, RegAllocState* ra,
                     SLJIT_R0, 0, SLJIT_IMM, (sljit_sw)WREN_NULL_VAL);
 
                 struct sljit_jump* jmpExit = sljit_emit_jump(C, SLJIT_JUMP);
-                if (snapId < (uint16_t)maxSnapshots &&
-                    exitJumpCount[snapId] < MAX_EXITS_PER_SNAP)
-                    exitJumpArr[snapId][exitJumpCount[snapId]++] = jmpExit;
+                addExitJump(exitJumps, &exitJumpCount, snapId, maxSnapshots,
+                            jmpExit);
 
                 struct sljit_label* okLabel = sljit_emit_label(C);
                 sljit_set_label(isFalse, okLabel);
@@ -937,10 +1060,7 @@ JitTrace* wrenJitCodegen(void* vm, IRBuffer* ir, RegAllocState* ra,
             struct sljit_jump* jmp = sljit_emit_cmp(C, SLJIT_EQUAL,
                 SLJIT_R0, 0, SLJIT_IMM, (sljit_sw)WREN_NULL_VAL);
 
-            if (snapId < (uint16_t)maxSnapshots &&
-                exitJumpCount[snapId] < MAX_EXITS_PER_SNAP) {
-                exitJumpArr[snapId][exitJumpCount[snapId]++] = jmp;
-            }
+            addExitJump(exitJumps, &exitJumpCount, snapId, maxSnapshots, jmp);
             break;
         }
 
@@ -952,16 +1072,55 @@ JitTrace* wrenJitCodegen(void* vm, IRBuffer* ir, RegAllocState* ra,
 
         case IR_LOOP_BACK: {
             // Emit back-edge copies: phi_reg = op2_reg for all pre-header PHIs.
+            // The copies happen at once, so a PHI carried into another is
+            // parked before either is written.
             uint16_t hdr = ir->loop_header;
+            sljit_sw park = phiParkOff;
+            for (uint16_t p = 0; p < hdr && p < ir->count; p++) {
+                const IRNode* phi = &ir->nodes[p];
+                if ((phi->flags & IR_FLAG_DEAD) || phi->op != IR_PHI) continue;
+                if (phi->op2 >= ir->count ||
+                    ir->nodes[phi->op2].op != IR_PHI) continue;
+                if (phi->type == IR_TYPE_NUM) {
+                    int srcReg, srcMem; sljit_sw srcOff;
+                    getFPOperand(C, ir, ra, phi->op2, SLJIT_FR0,
+                                 &srcReg, &srcMem, &srcOff);
+                    int sr = srcReg; sljit_sw sw = srcOff;
+                    if (srcMem) {
+                        sljit_emit_fop1(C, SLJIT_MOV_F64, SLJIT_FR0, 0, srcReg, srcOff);
+                        sr = SLJIT_FR0; sw = 0;
+                    }
+                    sljit_emit_fop1(C, SLJIT_MOV_F64, SLJIT_MEM1(SLJIT_SP), park,
+                                    sr, sw);
+                } else {
+                    int srcReg, srcMem; sljit_sw srcOff;
+                    getGP(ra, phi->op2, &srcReg, &srcMem, &srcOff);
+                    int sr = srcReg; sljit_sw sw = srcOff;
+                    if (srcMem) {
+                        sljit_emit_op1(C, SLJIT_MOV, SLJIT_R0, 0, srcReg, srcOff);
+                        sr = SLJIT_R0; sw = 0;
+                    }
+                    sljit_emit_op1(C, SLJIT_MOV, SLJIT_MEM1(SLJIT_SP), park,
+                                   sr, sw);
+                }
+                park += 8;
+            }
+            park = phiParkOff;
             for (uint16_t p = 0; p < hdr && p < ir->count; p++) {
                 const IRNode* phi = &ir->nodes[p];
                 if ((phi->flags & IR_FLAG_DEAD) || phi->op != IR_PHI) continue;
                 if (phi->op2 == IR_NONE || phi->op2 >= ir->count) continue;
+                bool parked = ir->nodes[phi->op2].op == IR_PHI;
                 if (phi->type == IR_TYPE_NUM) {
                     int srcReg, srcMem; sljit_sw srcOff;
                     int dstReg, dstMem; sljit_sw dstOff;
-                    getFP(ra, phi->op2, &srcReg, &srcMem, &srcOff);
+                    getFPOperand(C, ir, ra, phi->op2, SLJIT_FR0,
+                                 &srcReg, &srcMem, &srcOff);
                     getFP(ra, phi->id,  &dstReg, &dstMem, &dstOff);
+                    if (parked) {
+                        srcReg = SLJIT_MEM1(SLJIT_SP); srcMem = 1; srcOff = park;
+                        park += 8;
+                    }
                     int sr = srcReg; sljit_sw sw = srcOff;
                     if (srcMem) {
                         sljit_emit_fop1(C, SLJIT_MOV_F64, SLJIT_FR0, 0, srcReg, srcOff);
@@ -978,6 +1137,10 @@ JitTrace* wrenJitCodegen(void* vm, IRBuffer* ir, RegAllocState* ra,
                     int dstReg, dstMem; sljit_sw dstOff;
                     getGP(ra, phi->op2, &srcReg, &srcMem, &srcOff);
                     getGP(ra, phi->id,  &dstReg, &dstMem, &dstOff);
+                    if (parked) {
+                        srcReg = SLJIT_MEM1(SLJIT_SP); srcMem = 1; srcOff = park;
+                        park += 8;
+                    }
                     int sr = srcReg; sljit_sw sw = srcOff;
                     if (srcMem) {
                         sljit_emit_op1(C, SLJIT_MOV, SLJIT_R0, 0, srcReg, srcOff);
@@ -1001,7 +1164,8 @@ JitTrace* wrenJitCodegen(void* vm, IRBuffer* ir, RegAllocState* ra,
             if (n->type == IR_TYPE_NUM) {
                 int srcReg, srcMem; sljit_sw srcOff;
                 int dstReg, dstMem; sljit_sw dstOff;
-                getFP(ra, n->op1, &srcReg, &srcMem, &srcOff);
+                getFPOperand(C, ir, ra, n->op1, SLJIT_FR0,
+                             &srcReg, &srcMem, &srcOff);
                 getFP(ra, n->id,  &dstReg, &dstMem, &dstOff);
                 int sr = srcReg; sljit_sw sw = srcOff;
                 if (srcMem) {
@@ -1145,6 +1309,90 @@ JitTrace* wrenJitCodegen(void* vm, IRBuffer* ir, RegAllocState* ra,
             break;
         }
 
+        case IR_LOAD_RAW: {
+            // Load a raw field of a built-in object. op1 = object pointer
+            // (GP), imm.raw = byte offset and width. NUM loads a double into
+            // an FP register; narrower widths zero-extend into a GP register.
+            uint16_t objId = n->op1;
+            if (objId == IR_NONE) break;
+
+            int objReg, objMem; sljit_sw objOff;
+            getGP(ra, objId, &objReg, &objMem, &objOff);
+
+            if (objMem) {
+                sljit_emit_op1(C, SLJIT_MOV, SLJIT_R1, 0, objReg, objOff);
+            } else {
+                sljit_emit_op1(C, SLJIT_MOV, SLJIT_R1, 0, objReg, 0);
+            }
+            sljit_sw rawOff = (sljit_sw)n->imm.raw.offset;
+
+            if (n->type == IR_TYPE_NUM) {
+                int dstReg, dstMem; sljit_sw dstOff;
+                getFP(ra, n->id, &dstReg, &dstMem, &dstOff);
+                if (dstMem) {
+                    sljit_emit_fop1(C, SLJIT_MOV_F64, SLJIT_FR0, 0,
+                                    SLJIT_MEM1(SLJIT_R1), rawOff);
+                    sljit_emit_fop1(C, SLJIT_MOV_F64, dstReg, dstOff,
+                                    SLJIT_FR0, 0);
+                } else {
+                    sljit_emit_fop1(C, SLJIT_MOV_F64, dstReg, 0,
+                                    SLJIT_MEM1(SLJIT_R1), rawOff);
+                }
+                break;
+            }
+
+            sljit_s32 movOp = n->imm.raw.size == 1 ? SLJIT_MOV_U8
+                            : n->imm.raw.size == 4 ? SLJIT_MOV_U32
+                            : SLJIT_MOV;
+            int dstReg, dstMem; sljit_sw dstOff;
+            getGP(ra, n->id, &dstReg, &dstMem, &dstOff);
+            if (dstMem) {
+                sljit_emit_op1(C, movOp, SLJIT_R0, 0,
+                               SLJIT_MEM1(SLJIT_R1), rawOff);
+                sljit_emit_op1(C, SLJIT_MOV, dstReg, dstOff, SLJIT_R0, 0);
+            } else {
+                sljit_emit_op1(C, movOp, dstReg, 0,
+                               SLJIT_MEM1(SLJIT_R1), rawOff);
+            }
+            break;
+        }
+
+        case IR_LOAD_ELEM: {
+            // Load a Value from a buffer of Values. op1 = data pointer (GP),
+            // op2 = integer index (GP), already checked against the count.
+            uint16_t baseId = n->op1;
+            uint16_t idxId  = n->op2;
+            if (baseId == IR_NONE || idxId == IR_NONE) break;
+
+            int baseReg, baseMem; sljit_sw baseOff;
+            int idxReg, idxMem;   sljit_sw idxOff;
+            getGP(ra, baseId, &baseReg, &baseMem, &baseOff);
+            getGP(ra, idxId,  &idxReg,  &idxMem,  &idxOff);
+
+            if (baseMem) {
+                sljit_emit_op1(C, SLJIT_MOV, SLJIT_R1, 0, baseReg, baseOff);
+            } else {
+                sljit_emit_op1(C, SLJIT_MOV, SLJIT_R1, 0, baseReg, 0);
+            }
+            if (idxMem) {
+                sljit_emit_op1(C, SLJIT_MOV, SLJIT_R0, 0, idxReg, idxOff);
+            } else {
+                sljit_emit_op1(C, SLJIT_MOV, SLJIT_R0, 0, idxReg, 0);
+            }
+
+            int dstReg, dstMem; sljit_sw dstOff;
+            getGP(ra, n->id, &dstReg, &dstMem, &dstOff);
+            if (dstMem) {
+                sljit_emit_op1(C, SLJIT_MOV, SLJIT_R0, 0,
+                               SLJIT_MEM2(SLJIT_R1, SLJIT_R0), 3);
+                sljit_emit_op1(C, SLJIT_MOV, dstReg, dstOff, SLJIT_R0, 0);
+            } else {
+                sljit_emit_op1(C, SLJIT_MOV, dstReg, 0,
+                               SLJIT_MEM2(SLJIT_R1, SLJIT_R0), 3);
+            }
+            break;
+        }
+
         case IR_STORE_FIELD: {
             // Store a value to an object field. op1 = obj ptr, op2 = value.
             uint16_t objId = n->op1;
@@ -1177,80 +1425,204 @@ JitTrace* wrenJitCodegen(void* vm, IRBuffer* ir, RegAllocState* ra,
             break;
         }
 
+        case IR_STORE_RAW: {
+            // Store a Value through a raw pointer. op1 = pointer, op2 = value.
+            uint16_t ptrId = n->op1;
+            uint16_t valId = n->op2;
+            if (ptrId == IR_NONE || valId == IR_NONE) break;
+
+            int ptrReg, ptrMem; sljit_sw ptrOff;
+            getGP(ra, ptrId, &ptrReg, &ptrMem, &ptrOff);
+            sljit_emit_op1(C, SLJIT_MOV, SLJIT_R1, 0, ptrReg,
+                           ptrMem ? ptrOff : 0);
+
+            int srcReg, srcMem; sljit_sw srcOff;
+            getGP(ra, valId, &srcReg, &srcMem, &srcOff);
+            sljit_sw off = (sljit_sw)n->imm.raw.offset;
+            if (srcMem) {
+                sljit_emit_op1(C, SLJIT_MOV, SLJIT_R0, 0, srcReg, srcOff);
+                sljit_emit_op1(C, SLJIT_MOV, SLJIT_MEM1(SLJIT_R1), off,
+                               SLJIT_R0, 0);
+            } else {
+                sljit_emit_op1(C, SLJIT_MOV, SLJIT_MEM1(SLJIT_R1), off,
+                               srcReg, 0);
+            }
+            break;
+        }
+
         case IR_LOAD_MODULE_VAR: {
-            // Load a Value from the module variables array.
-            // Fast path (when modVarsBase is known): use REG_MOD_VARS + offset
-            // (single instruction on ARM64).  Fallback: absolute pointer.
+            // Load a Value from the module variables array, addressed by
+            // index off REG_MOD_VARS. The base is passed in on every entry,
+            // so the trace survives the module's variable buffer growing.
             int dstReg, dstMem; sljit_sw dstOff;
             getGP(ra, n->id, &dstReg, &dstMem, &dstOff);
 
-            if (modVarsBase != NULL) {
-                // Compute byte offset from module vars base.
-                sljit_sw mvOff = (sljit_sw)(
-                    ((char*)n->imm.ptr - (char*)modVarsBase));
-                if (dstMem) {
-                    sljit_emit_op1(C, SLJIT_MOV, SLJIT_R0, 0,
-                                   SLJIT_MEM1(REG_MOD_VARS), mvOff);
-                    sljit_emit_op1(C, SLJIT_MOV, dstReg, dstOff,
-                                   SLJIT_R0, 0);
-                } else {
-                    sljit_emit_op1(C, SLJIT_MOV, dstReg, 0,
-                                   SLJIT_MEM1(REG_MOD_VARS), mvOff);
-                }
-            } else {
-                // Fallback: load absolute address into R0, then dereference.
+            sljit_sw mvOff = (sljit_sw)n->imm.intval * (sljit_sw)sizeof(uint64_t);
+            if (dstMem) {
                 sljit_emit_op1(C, SLJIT_MOV, SLJIT_R0, 0,
-                               SLJIT_IMM, (sljit_sw)(uintptr_t)n->imm.ptr);
-                if (dstMem) {
-                    sljit_emit_op1(C, SLJIT_MOV, SLJIT_R1, 0,
-                                   SLJIT_MEM1(SLJIT_R0), 0);
-                    sljit_emit_op1(C, SLJIT_MOV, dstReg, dstOff, SLJIT_R1, 0);
-                } else {
-                    sljit_emit_op1(C, SLJIT_MOV, dstReg, 0,
-                                   SLJIT_MEM1(SLJIT_R0), 0);
-                }
+                               SLJIT_MEM1(REG_MOD_VARS), mvOff);
+                sljit_emit_op1(C, SLJIT_MOV, dstReg, dstOff, SLJIT_R0, 0);
+            } else {
+                sljit_emit_op1(C, SLJIT_MOV, dstReg, 0,
+                               SLJIT_MEM1(REG_MOD_VARS), mvOff);
             }
             break;
         }
 
         case IR_STORE_MODULE_VAR: {
             // Store a Value to the module variables array.
-            // op1 = SSA value to store.
+            // op1 = SSA value to store, imm.intval = variable index.
             uint16_t valId = n->op1;
             if (valId == IR_NONE) break;
 
             int srcReg, srcMem; sljit_sw srcOff;
             getGP(ra, valId, &srcReg, &srcMem, &srcOff);
 
-            if (modVarsBase != NULL) {
-                sljit_sw mvOff = (sljit_sw)(
-                    ((char*)n->imm.ptr - (char*)modVarsBase));
-                if (srcMem) {
-                    sljit_emit_op1(C, SLJIT_MOV, SLJIT_R0, 0, srcReg, srcOff);
-                    sljit_emit_op1(C, SLJIT_MOV,
-                                   SLJIT_MEM1(REG_MOD_VARS), mvOff,
-                                   SLJIT_R0, 0);
-                } else {
-                    sljit_emit_op1(C, SLJIT_MOV,
-                                   SLJIT_MEM1(REG_MOD_VARS), mvOff,
-                                   srcReg, 0);
-                }
+            sljit_sw mvOff = (sljit_sw)n->imm.intval * (sljit_sw)sizeof(uint64_t);
+            if (srcMem) {
+                sljit_emit_op1(C, SLJIT_MOV, SLJIT_R0, 0, srcReg, srcOff);
+                sljit_emit_op1(C, SLJIT_MOV,
+                               SLJIT_MEM1(REG_MOD_VARS), mvOff, SLJIT_R0, 0);
             } else {
-                // Fallback: absolute pointer.
-                sljit_emit_op1(C, SLJIT_MOV, SLJIT_R0, 0,
-                               SLJIT_IMM, (sljit_sw)(uintptr_t)n->imm.ptr);
-                if (srcMem) {
-                    sljit_emit_op1(C, SLJIT_MOV, SLJIT_R1, 0, srcReg, srcOff);
-                    sljit_emit_op1(C, SLJIT_MOV,
-                                   SLJIT_MEM1(SLJIT_R0), 0, SLJIT_R1, 0);
-                } else {
-                    sljit_emit_op1(C, SLJIT_MOV,
-                                   SLJIT_MEM1(SLJIT_R0), 0, srcReg, 0);
-                }
+                sljit_emit_op1(C, SLJIT_MOV,
+                               SLJIT_MEM1(REG_MOD_VARS), mvOff, srcReg, 0);
+            }
+            break;
+        }
+
+        case IR_NEW_INSTANCE: {
+            // R0 = wrenJitNewInstance(vm, class); 0 means a GC is due, so
+            // leave the trace and let the interpreter allocate.
+            uint16_t clsId = n->op1;
+            uint16_t snapId = n->imm.snapshot_id;
+            if (clsId == IR_NONE) break;
+
+            int clsReg, clsMem; sljit_sw clsOff;
+            getGP(ra, clsId, &clsReg, &clsMem, &clsOff);
+            sljit_emit_op1(C, SLJIT_MOV, SLJIT_R1, 0, clsReg,
+                           clsMem ? clsOff : 0);
+
+            saveCallRegs(C, callSaveOff);
+            sljit_emit_op1(C, SLJIT_MOV, SLJIT_R0, 0, REG_VM, 0);
+            sljit_emit_icall(C, SLJIT_CALL, SLJIT_ARGS2(W, P, P),
+                             SLJIT_IMM, SLJIT_FUNC_ADDR(wrenJitNewInstance));
+            sljit_emit_op1(C, SLJIT_MOV, SLJIT_MEM1(SLJIT_SP), tmpOff,
+                           SLJIT_R0, 0);
+            restoreCallRegs(C, callSaveOff);
+
+            sljit_emit_op1(C, SLJIT_MOV, SLJIT_R0, 0,
+                           SLJIT_MEM1(SLJIT_SP), tmpOff);
+            struct sljit_jump* jmp = sljit_emit_cmp(C, SLJIT_EQUAL,
+                SLJIT_R0, 0, SLJIT_IMM, 0);
+            addExitJump(exitJumps, &exitJumpCount, snapId, maxSnapshots, jmp);
+
+            int dstReg, dstMem; sljit_sw dstOff;
+            getGP(ra, n->id, &dstReg, &dstMem, &dstOff);
+            sljit_emit_op1(C, SLJIT_MOV, dstReg, dstOff, SLJIT_R0, 0);
+            break;
+        }
+
+        case IR_STRING_APPEND: {
+            // R0 = wrenJitStringAppend(vm, str, piece, inPlace); 0 means a
+            // GC is due, as for NEW_INSTANCE.
+            uint16_t snapId = n->imm.snapshot_id;
+            if (n->op1 == IR_NONE || n->op2 == IR_NONE) break;
+
+            int strReg, strMem; sljit_sw strOff;
+            int pieceReg, pieceMem; sljit_sw pieceOff;
+            getGP(ra, n->op1, &strReg, &strMem, &strOff);
+            getGP(ra, n->op2, &pieceReg, &pieceMem, &pieceOff);
+
+            // R2 and R3 are allocatable, so they are loaded only once saved,
+            // and R1 first in case the string lives in R2.
+            saveCallRegs(C, callSaveOff);
+            sljit_emit_op1(C, SLJIT_MOV, SLJIT_R1, 0, strReg,
+                           strMem ? strOff : 0);
+            sljit_emit_op1(C, SLJIT_MOV, SLJIT_R2, 0, pieceReg,
+                           pieceMem ? pieceOff : 0);
+            sljit_emit_op1(C, SLJIT_MOV, SLJIT_R3, 0, SLJIT_IMM,
+                           (n->flags & IR_FLAG_IN_PLACE) ? 1 : 0);
+            sljit_emit_op1(C, SLJIT_MOV, SLJIT_R0, 0, REG_VM, 0);
+            sljit_emit_icall(C, SLJIT_CALL, SLJIT_ARGS4(W, P, W, W, W),
+                             SLJIT_IMM, SLJIT_FUNC_ADDR(wrenJitStringAppend));
+            sljit_emit_op1(C, SLJIT_MOV, SLJIT_MEM1(SLJIT_SP), tmpOff,
+                           SLJIT_R0, 0);
+            restoreCallRegs(C, callSaveOff);
+
+            sljit_emit_op1(C, SLJIT_MOV, SLJIT_R0, 0,
+                           SLJIT_MEM1(SLJIT_SP), tmpOff);
+            struct sljit_jump* jmp = sljit_emit_cmp(C, SLJIT_EQUAL,
+                SLJIT_R0, 0, SLJIT_IMM, 0);
+            addExitJump(exitJumps, &exitJumpCount, snapId, maxSnapshots, jmp);
+
+            int dstReg, dstMem; sljit_sw dstOff;
+            getGP(ra, n->id, &dstReg, &dstMem, &dstOff);
+            sljit_emit_op1(C, SLJIT_MOV, dstReg, dstOff, SLJIT_R0, 0);
+            break;
+        }
+
+        case IR_RANDOM: {
+            // FR0 = wrenJitRandomFloat(random) or wrenJitRandomInt(random).
+            // The helpers never allocate, so there is nothing to exit for.
+            if (n->op1 == IR_NONE) break;
+
+            int objReg, objMem; sljit_sw objOff;
+            getGP(ra, n->op1, &objReg, &objMem, &objOff);
+
+            saveCallRegs(C, callSaveOff);
+            sljit_emit_op1(C, SLJIT_MOV, SLJIT_R0, 0, objReg,
+                           objMem ? objOff : 0);
+            sljit_emit_icall(C, SLJIT_CALL, SLJIT_ARGS1(F64, P), SLJIT_IMM,
+                             n->imm.intval
+                                 ? SLJIT_FUNC_ADDR(wrenJitRandomInt)
+                                 : SLJIT_FUNC_ADDR(wrenJitRandomFloat));
+            sljit_emit_fop1(C, SLJIT_MOV_F64, SLJIT_MEM1(SLJIT_SP), tmpOff,
+                            SLJIT_FR0, 0);
+            restoreCallRegs(C, callSaveOff);
+
+            int dstReg, dstMem; sljit_sw dstOff;
+            getFP(ra, n->id, &dstReg, &dstMem, &dstOff);
+            if (dstMem) {
+                sljit_emit_fop1(C, SLJIT_MOV_F64, SLJIT_FR0, 0,
+                                SLJIT_MEM1(SLJIT_SP), tmpOff);
+                sljit_emit_fop1(C, SLJIT_MOV_F64, dstReg, dstOff,
+                                SLJIT_FR0, 0);
+            } else {
+                sljit_emit_fop1(C, SLJIT_MOV_F64, dstReg, 0,
+                                SLJIT_MEM1(SLJIT_SP), tmpOff);
             }
             break;
         }
 
+        case IR_LIST_NUM_END: {
+            // R0 = wrenJitListNumEnd(list, from). Reads only; the helper
+            // scans the elements in vector-sized blocks.
+            if (n->op1 == IR_NONE || n->op2 == IR_NONE) break;
+
+            int listReg, listMem; sljit_sw listOff;
+            int fromReg, fromMem; sljit_sw fromOff;
+            getGP(ra, n->op1, &listReg, &listMem, &listOff);
+            getGP(ra, n->op2, &fromReg, &fromMem, &fromOff);
+
+            saveCallRegs(C, callSaveOff);
+            sljit_emit_op1(C, SLJIT_MOV, SLJIT_R0, 0, listReg,
+                           listMem ? listOff : 0);
+            sljit_emit_op1(C, SLJIT_MOV, SLJIT_R1, 0, fromReg,
+                           fromMem ? fromOff : 0);
+            sljit_emit_icall(C, SLJIT_CALL, SLJIT_ARGS2(W, P, W), SLJIT_IMM,
+                             SLJIT_FUNC_ADDR(wrenJitListNumEnd));
+            sljit_emit_op1(C, SLJIT_MOV, SLJIT_MEM1(SLJIT_SP), tmpOff,
+                           SLJIT_R0, 0);
+            restoreCallRegs(C, callSaveOff);
+
+            sljit_emit_op1(C, SLJIT_MOV, SLJIT_R0, 0,
+                           SLJIT_MEM1(SLJIT_SP), tmpOff);
+            int dstReg, dstMem; sljit_sw dstOff;
+            getGP(ra, n->id, &dstReg, &dstMem, &dstOff);
+            sljit_emit_op1(C, SLJIT_MOV, dstReg, dstOff, SLJIT_R0, 0);
+            break;
+        }
+
         case IR_CALL_C:
         case IR_CALL_WREN:
             // Not yet implemented. These will require C function calls
@@ -1288,6 +1660,12 @@ JitTrace* wrenJitCodegen(void* vm, IRBuffer* ir, RegAllocState* ra,
                 uint16_t ref  = ir->snapshot_entries[entry_idx].ssa_ref;
                 if (ref >= (uint16_t)ra->ssa_count) continue;
 
+                // A slot mapped to its own load is unchanged in memory. This
+                // also keeps exits from hoisted guards from writing back
+                // in-loop loads that have not run yet.
+                if (ir->nodes[ref].op == IR_LOAD_STACK &&
+                    ir->nodes[ref].imm.mem.slot == slot) continue;
+
                 int is_fp, spillOff;
                 int r = ssaToSljitReg(ra, ref, &is_fp, &spillOff);
                 sljit_sw dstOff = (sljit_sw)(slot) * 8;
@@ -1330,19 +1708,18 @@ JitTrace* wrenJitCodegen(void* vm, IRBuffer* ir, RegAllocState* ra,
     }
 
     // Patch all guard jumps to their respective exit stubs.
-    for (int si = 0; si < maxSnapshots; si++) {
-        for (int j = 0; j < exitJumpCount[si]; j++) {
-            sljit_set_label(exitJumpArr[si][j], exitLabels[si]);
-        }
+    for (int j = 0; j < exitJumpCount; j++) {
+        sljit_set_label(exitJumps[j].jump, exitLabels[exitJumps[j].snapshot]);
     }
 
     // ---------------------------------------------------------------------------
     // Generate native code.
     // ---------------------------------------------------------------------------
-    void* generatedCode = sljit_generate_code(C, 0, NULL);
+    void* generatedCode = sljit_generate_code(C, 0, pool);
     if (!generatedCode) {
         free(exitJumps);
         sljit_free_compiler(C);
+        jitPoolSeal(pool);
         return NULL;
     }
 
@@ -1361,7 +1738,7 @@ JitTrace* wrenJitCodegen(void* vm, IRBuffer* ir, RegAllocState* ra,
     // ---------------------------------------------------------------------------
     JitTrace* trace = (JitTrace*)calloc(1, sizeof(JitTrace));
     if (!trace) {
-        sljit_free_code(codeBuf, NULL);
+        sljit_free_code(codeBuf, pool);
         return NULL;
     }
 
@@ -1380,6 +1757,19 @@ JitTrace* wrenJitCodegen(void* vm, IRBuffer* ir, RegAllocState* ra,
                 JitSnapshot* js = &trace->snapshots[si];
                 jitSnapshotInit(js, irSnap->resume_pc, irSnap->stack_depth);
 
+                // Inlined frames, outermost first.
+                uint16_t chain[JIT_MAX_SNAPSHOT_FRAMES];
+                int depth = 0;
+                for (uint16_t f = irSnap->frame;
+                     f != IR_NONE && depth < JIT_MAX_SNAPSHOT_FRAMES;
+                     f = ir->frames[f].parent) {
+                    chain[depth++] = f;
+                }
+                while (depth > 0) {
+                    const IRFrame* f = &ir->frames[chain[--depth]];
+                    jitSnapshotAddFrame(js, f->closure, f->return_pc, f->base);
+                }
+
                 // Copy entries from IR shared pool.
                 for (uint16_t e = 0; e < irSnap->num_entries; e++) {
                     uint16_t entryIdx = irSnap->entry_start + e;
@@ -1392,10 +1782,14 @@ JitTrace* wrenJitCodegen(void* vm, IRBuffer* ir, RegAllocState* ra,
         }
     }
 
-    // Collect GC roots: object pointers embedded in the trace (from IR_CONST_OBJ).
-    int numRoots = 0;
+    // Collect GC roots: object pointers embedded in the trace (IR_CONST_OBJ),
+    // classes it guards on (a freed class's address could be reused) and
+    // the closures of inlined methods, which exits resume into.
+    int numRoots = (int)ir->frame_count;
     for (uint16_t i = 0; i < ir->count; i++) {
-        if (ir->nodes[i].op == IR_CONST_OBJ && ir->nodes[i].imm.ptr != NULL)
+        const IRNode* rn = &ir->nodes[i];
+        if ((rn->op == IR_CONST_OBJ || rn->op == IR_GUARD_CLASS) &&
+            !(rn->flags & IR_FLAG_DEAD) && rn->imm.ptr != NULL)
             numRoots++;
     }
     if (numRoots > 0) {
@@ -1403,14 +1797,34 @@ JitTrace* wrenJitCodegen(void* vm, IRBuffer* ir, RegAllocState* ra,
         if (trace->gc_roots) {
             int idx = 0;
             for (uint16_t i = 0; i < ir->count; i++) {
-                if (ir->nodes[i].op == IR_CONST_OBJ && ir->nodes[i].imm.ptr != NULL) {
-                    trace->gc_roots[idx++] = ir->nodes[i].imm.ptr;
+                const IRNode* rn = &ir->nodes[i];
+                if ((rn->op == IR_CONST_OBJ || rn->op == IR_GUARD_CLASS) &&
+                    !(rn->flags & IR_FLAG_DEAD) && rn->imm.ptr != NULL) {
+                    trace->gc_roots[idx++] = rn->imm.ptr;
                 }
             }
+            for (uint16_t f = 0; f < ir->frame_count; f++) {
+                trace->gc_roots[idx++] = ir->frames[f].closure;
+            }
         }
         trace->num_gc_roots = (uint16_t)numRoots;
     }
 
+    // Stack slots the trace and its exits touch; inlined frames may reach
+    // past the slots the anchor's function reserved.
+    int stackSlots = 0;
+    for (uint16_t i = 0; i < ir->count; i++) {
+        const IRNode* sn = &ir->nodes[i];
+        if ((sn->op == IR_LOAD_STACK || sn->op == IR_STORE_STACK) &&
+            sn->imm.mem.slot + 1 > stackSlots)
+            stackSlots = sn->imm.mem.slot + 1;
+    }
+    for (uint16_t e = 0; e < ir->snapshot_entry_count; e++) {
+        if (ir->snapshot_entries[e].slot + 1 > stackSlots)
+            stackSlots = ir->snapshot_entries[e].slot + 1;
+    }
+    trace->stack_slots = (uint16_t)stackSlots;
+
     trace->exec_count = 0;
     trace->exit_count = 0;
 
@@ -7,11 +7,11 @@
 #include "wren_jit.h"
 
 // Compile IR + register allocation to native code using SLJIT.
-// modVarsBase: base pointer of the module variables array (modVarsData), used
-//              to compute REG_MOD_VARS-relative offsets for LOAD/STORE_MODULE_VAR.
-//              Pass NULL to fall back to absolute-pointer mode.
+// Module variables are addressed by index off the moduleVarsData argument
+// of JitTraceFunc, so no module address is baked into the code.
+// pool: code arena the native code is allocated from.
 // Returns a JitTrace with compiled code, or NULL on error.
 JitTrace* wrenJitCodegen(void* vm, IRBuffer* ir, RegAllocState* ra,
-                         uint8_t* anchorPC, void* modVarsBase);
+                         uint8_t* anchorPC, struct JitMemoryPool* pool);
 
 #endif
@@ -10,6 +10,8 @@
 void irBufferInit(IRBuffer* buf)
 {
     memset(buf, 0, sizeof(IRBuffer));
+    buf->cur_frame = IR_NONE;
+    buf->entry_snapshot = IR_NONE;
 }
 
 // ---------------------------------------------------------------------------
@@ -59,6 +61,13 @@ uint16_t irEmitConstObj(IRBuffer* buf, void* ptr)
     return id;
 }
 
+uint16_t irEmitConstInt(IRBuffer* buf, int64_t val)
+{
+    uint16_t id = irEmit(buf, IR_CONST_INT, IR_NONE, IR_NONE, IR_TYPE_INT);
+    buf->nodes[id].imm.i64 = val;
+    return id;
+}
+
 // ---------------------------------------------------------------------------
 // Stack access
 // ---------------------------------------------------------------------------
@@ -94,6 +103,25 @@ uint16_t irEmitStoreField(IRBuffer* buf, uint16_t obj, uint16_t field,
     return id;
 }
 
+uint16_t irEmitLoadRaw(IRBuffer* buf, uint16_t obj, int32_t offset,
+                       uint8_t size, IRType type, bool immutable)
+{
+    uint16_t id = irEmit(buf, IR_LOAD_RAW, obj, IR_NONE, type);
+    buf->nodes[id].imm.raw.offset = offset;
+    buf->nodes[id].imm.raw.size = size;
+    buf->nodes[id].imm.raw.immutable = immutable;
+    return id;
+}
+
+uint16_t irEmitStoreRaw(IRBuffer* buf, uint16_t ptr, int32_t offset,
+                        uint16_t val)
+{
+    uint16_t id = irEmit(buf, IR_STORE_RAW, ptr, val, IR_TYPE_VOID);
+    buf->nodes[id].imm.raw.offset = offset;
+    buf->nodes[id].imm.raw.size = sizeof(uint64_t);
+    return id;
+}
+
 // ---------------------------------------------------------------------------
 // Guards
 // ---------------------------------------------------------------------------
@@ -130,6 +158,35 @@ uint16_t irEmitGuardFalse(IRBuffer* buf, uint16_t val, uint16_t snapshot)
     return id;
 }
 
+uint16_t irEmitNewInstance(IRBuffer* buf, uint16_t classObj,
+                           uint16_t snapshot)
+{
+    uint16_t id = irEmit(buf, IR_NEW_INSTANCE, classObj, IR_NONE,
+                         IR_TYPE_VALUE);
+    buf->nodes[id].imm.snapshot_id = snapshot;
+    return id;
+}
+
+uint16_t irEmitStringAppend(IRBuffer* buf, uint16_t str, uint16_t piece,
+                            uint16_t snapshot)
+{
+    uint16_t id = irEmit(buf, IR_STRING_APPEND, str, piece, IR_TYPE_VALUE);
+    buf->nodes[id].imm.snapshot_id = snapshot;
+    return id;
+}
+
+uint16_t irEmitRandom(IRBuffer* buf, uint16_t random, bool asInt)
+{
+    uint16_t id = irEmit(buf, IR_RANDOM, random, IR_NONE, IR_TYPE_NUM);
+    buf->nodes[id].imm.intval = asInt ? 1 : 0;
+    return id;
+}
+
+uint16_t irEmitListNumEnd(IRBuffer* buf, uint16_t list, uint16_t from)
+{
+    return irEmit(buf, IR_LIST_NUM_END, list, from, IR_TYPE_INT);
+}
+
 // ---------------------------------------------------------------------------
 // NaN-boxing
 // ---------------------------------------------------------------------------
@@ -155,6 +212,7 @@ uint16_t irEmitSnapshot(IRBuffer* buf, uint8_t* resume_pc, int stack_depth)
     snap->num_entries = 0;
     snap->entry_start = buf->snapshot_entry_count;
     snap->stack_depth = stack_depth;
+    snap->frame = buf->cur_frame;
 
     uint16_t id = irEmit(buf, IR_SNAPSHOT, IR_NONE, IR_NONE, IR_TYPE_VOID);
     buf->nodes[id].imm.snapshot_id = snap_id;
@@ -171,6 +229,26 @@ void irSnapshotAddEntry(IRBuffer* buf, uint16_t snapshot_id, uint16_t slot,
     snap->num_entries++;
 }
 
+uint16_t irPushFrame(IRBuffer* buf, void* closure, uint8_t* return_pc,
+                     uint16_t base)
+{
+    if (buf->frame_count >= IR_MAX_FRAMES) return IR_NONE;
+    uint16_t idx = buf->frame_count++;
+    IRFrame* f = &buf->frames[idx];
+    f->closure = closure;
+    f->return_pc = return_pc;
+    f->base = base;
+    f->parent = buf->cur_frame;
+    buf->cur_frame = idx;
+    return idx;
+}
+
+void irPopFrame(IRBuffer* buf)
+{
+    if (buf->cur_frame == IR_NONE) return;
+    buf->cur_frame = buf->frames[buf->cur_frame].parent;
+}
+
 // ---------------------------------------------------------------------------
 // Control flow
 // ---------------------------------------------------------------------------
@@ -245,6 +323,9 @@ const char* irOpName(IROp op)
     case IR_STORE_STACK:    return "STORE_STACK";
     case IR_LOAD_FIELD:     return "LOAD_FIELD";
     case IR_STORE_FIELD:    return "STORE_FIELD";
+    case IR_LOAD_RAW:       return "LOAD_RAW";
+    case IR_LOAD_ELEM:      return "LOAD_ELEM";
+    case IR_STORE_RAW:      return "STORE_RAW";
     case IR_LOAD_MODULE_VAR:  return "LOAD_MODULE_VAR";
     case IR_STORE_MODULE_VAR: return "STORE_MODULE_VAR";
     case IR_BOX_NUM:        return "BOX_NUM";
@@ -266,6 +347,10 @@ const char* irOpName(IROp op)
     case IR_SNAPSHOT:       return "SNAPSHOT";
     case IR_CALL_C:         return "CALL_C";
     case IR_CALL_WREN:      return "CALL_WREN";
+    case IR_NEW_INSTANCE:   return "NEW_INSTANCE";
+    case IR_STRING_APPEND:  return "STRING_APPEND";
+    case IR_RANDOM:         return "RANDOM";
+    case IR_LIST_NUM_END:   return "LIST_NUM_END";
     default:                return "UNKNOWN";
     }
 }
@@ -291,6 +376,9 @@ void irBufferDump(const IRBuffer* buf)
         case IR_CONST_OBJ:
             printf(" %p", n->imm.ptr);
             break;
+        case IR_CONST_INT:
+            printf(" %lld", (long long)n->imm.i64);
+            break;
         case IR_LOAD_STACK:
         case IR_STORE_STACK:
             printf(" slot=%d", n->imm.mem.slot);
@@ -301,6 +389,18 @@ void irBufferDump(const IRBuffer* buf)
             printf(" %%%04d.%d", n->op1, n->imm.mem.field);
             if (n->op2 != IR_NONE) printf(" %%%04d", n->op2);
             break;
+        case IR_LOAD_RAW:
+            printf(" %%%04d+%d/%d%s", n->op1, n->imm.raw.offset,
+                   n->imm.raw.size, n->imm.raw.immutable ? " const" : "");
+            break;
+        case IR_STORE_RAW:
+            printf(" %%%04d+%d %%%04d", n->op1, n->imm.raw.offset, n->op2);
+            break;
+        case IR_LOAD_MODULE_VAR:
+        case IR_STORE_MODULE_VAR:
+            printf(" var=%d", n->imm.intval);
+            if (n->op1 != IR_NONE) printf(" %%%04d", n->op1);
+            break;
         case IR_SIDE_EXIT:
             printf(" snap=%d", n->imm.snapshot_id);
             break;
@@ -308,17 +408,28 @@ void irBufferDump(const IRBuffer* buf)
         case IR_GUARD_TRUE:
         case IR_GUARD_FALSE:
         case IR_GUARD_NOT_NULL:
+        case IR_NEW_INSTANCE:
             printf(" %%%04d snap=%d", n->op1, n->imm.snapshot_id);
             break;
         case IR_GUARD_CLASS:
             printf(" %%%04d class=%p snap=%d", n->op1, n->imm.ptr, n->op2);
             break;
+        case IR_STRING_APPEND:
+            printf(" %%%04d %%%04d snap=%d%s", n->op1, n->op2,
+                   n->imm.snapshot_id,
+                   (n->flags & IR_FLAG_IN_PLACE) ? " in-place" : "");
+            break;
+        case IR_RANDOM:
+            printf(" %%%04d %s", n->op1, n->imm.intval ? "int" : "float");
+            break;
         case IR_SNAPSHOT:
             printf(" #%d", n->imm.snapshot_id);
             break;
         default:
             if (n->op1 != IR_NONE) printf(" %%%04d", n->op1);
             if (n->op2 != IR_NONE) printf(" %%%04d", n->op2);
+            if (n->flags & IR_FLAG_CHECKED)
+                printf(" snap=%d", n->imm.snapshot_id);
             break;
         }
 
@@ -329,6 +440,8 @@ void irBufferDump(const IRBuffer* buf)
             if (n->flags & IR_FLAG_INVARIANT) printf("inv ");
             if (n->flags & IR_FLAG_HOISTED) printf("hoist ");
             if (n->flags & IR_FLAG_GUARD) printf("guard ");
+            if (n->flags & IR_FLAG_CHECKED) printf("checked ");
+            if (n->flags & IR_FLAG_INTEGRAL) printf("integral ");
             printf("]");
         }
         printf("\n");
@@ -343,6 +456,16 @@ void irBufferDump(const IRBuffer* buf)
                 &buf->snapshot_entries[s->entry_start + j];
             printf(" %d:%%%04d", e->slot, e->ssa_ref);
         }
-        printf(" ]\n");
+        printf(" ]");
+        if (s->frame != IR_NONE) printf(" frame=%d", s->frame);
+        printf("\n");
+    }
+
+    for (uint16_t i = 0; i < buf->frame_count; i++) {
+        const IRFrame* f = &buf->frames[i];
+        printf("  frame#%d closure=%p base=%d ret=%p", i, f->closure,
+               f->base, (void*)f->return_pc);
+        if (f->parent != IR_NONE) printf(" parent=%d", f->parent);
+        printf("\n");
     }
 }
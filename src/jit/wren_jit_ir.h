@@ -51,8 +51,14 @@ typedef enum {
     // Field access
     IR_LOAD_FIELD,       // load object field
     IR_STORE_FIELD,      // store object field
-
-    // Module variable access
+    IR_LOAD_RAW,         // load imm.raw.size bytes at op1 + imm.raw.offset;
+                         // op1 is an unboxed object pointer and the node
+                         // type selects a double, bool or word load
+    IR_LOAD_ELEM,        // load the Value at op1[op2]; op1 is a Value*
+                         // (PTR) and op2 an INT index
+    IR_STORE_RAW,        // store the Value op2 at op1 + imm.raw.offset
+
+    // Module variable access (imm.intval = variable index; STORE: op1 = value)
     IR_LOAD_MODULE_VAR,
     IR_STORE_MODULE_VAR,
 
@@ -84,6 +90,15 @@ typedef enum {
     // Calls
     IR_CALL_C,           // call a C function (primitive)
     IR_CALL_WREN,        // call a Wren method (may side-exit)
+    IR_NEW_INSTANCE,     // allocate an instance of class op1 (PTR); exits
+                         // to imm.snapshot_id when a GC is due
+    IR_STRING_APPEND,    // the string op1 + the string op2; exits to
+                         // imm.snapshot_id when a GC is due
+    IR_RANDOM,           // advance the Random object op1 (PTR): float(),
+                         // or int() when imm.intval is set; a NUM
+    IR_LIST_NUM_END,     // the first index at or after op2 (INT) whose
+                         // element in the List op1 (PTR) is not a
+                         // number, or its count; an INT
 
     IR_OPCODE_COUNT
 } IROp;
@@ -120,6 +135,11 @@ typedef struct {
             uint16_t slot;       // stack slot index
             uint16_t field;      // field index (for field ops)
         } mem;
+        struct {
+            int32_t offset;      // byte offset from the object pointer
+            uint8_t size;        // access width in bytes (1, 4 or 8)
+            bool immutable;      // the field never changes once allocated
+        } raw;                   // for IR_LOAD_RAW and IR_STORE_RAW
     } imm;
 
     // Optimization metadata.
@@ -128,6 +148,14 @@ typedef struct {
     #define IR_FLAG_INVARIANT 0x02   // loop-invariant (can hoist)
     #define IR_FLAG_HOISTED   0x04   // already hoisted
     #define IR_FLAG_GUARD     0x08   // is a guard instruction
+    #define IR_FLAG_IN_PLACE  0x10   // STRING_APPEND: op1 is never seen
+                                     // again, so it may be grown in place
+    #define IR_FLAG_CHECKED   0x20   // INT ADD/SUB/MUL/UNBOX_INT: exits to
+                                     // imm.snapshot_id unless the result is
+                                     // exactly a double
+    #define IR_FLAG_INTEGRAL  0x40   // UNBOX_NUM: the number was an integer
+                                     // when recorded; UNBOX_INT: stands for
+                                     // that integer rather than truncating
 } IRNode;
 
 // ---------------------------------------------------------------------------
@@ -136,6 +164,7 @@ typedef struct {
 #define IR_MAX_NODES 4096
 #define IR_MAX_SNAPSHOTS 256
 #define IR_MAX_SNAPSHOT_ENTRIES 64
+#define IR_MAX_FRAMES 64
 
 // ---------------------------------------------------------------------------
 // Snapshots (for deoptimisation)
@@ -153,8 +182,19 @@ typedef struct {
     uint16_t num_entries;
     uint16_t entry_start;         // index into shared entry array
     int stack_depth;              // fiber stack depth at this point
+    uint16_t frame;               // innermost inlined frame, or IR_NONE when
+                                  // the exit is in the trace's own function
 } IRSnapshot;
 
+// A Wren method inlined into the trace. An exit inside it must rebuild the
+// interpreter's call frame before resuming.
+typedef struct {
+    void* closure;                // ObjClosure* of the inlined method
+    uint8_t* return_pc;           // caller's PC after the call instruction
+    uint16_t base;                // stack slot of the receiver (callee slot 0)
+    uint16_t parent;              // caller's frame, or IR_NONE
+} IRFrame;
+
 // ---------------------------------------------------------------------------
 // The IR buffer for one trace
 // ---------------------------------------------------------------------------
@@ -169,6 +209,13 @@ typedef struct {
     uint16_t snapshot_entry_count;
 
     uint16_t loop_header;             // node index of IR_LOOP_HEADER
+    uint16_t entry_snapshot;          // resumes at the loop entry, or IR_NONE
+    uint8_t unroll_factor;            // iterations irOptUnrollLoop may run
+                                      // per trip (below 2: no unrolling)
+
+    IRFrame frames[IR_MAX_FRAMES];    // every frame inlined by the trace
+    uint16_t frame_count;
+    uint16_t cur_frame;               // frame being recorded, or IR_NONE
 } IRBuffer;
 
 // ---------------------------------------------------------------------------
@@ -185,12 +232,17 @@ uint16_t irEmitConst(IRBuffer* buf, double num);
 uint16_t irEmitConstBool(IRBuffer* buf, bool val);
 uint16_t irEmitConstNull(IRBuffer* buf);
 uint16_t irEmitConstObj(IRBuffer* buf, void* ptr);
+uint16_t irEmitConstInt(IRBuffer* buf, int64_t val);
 
 uint16_t irEmitLoad(IRBuffer* buf, uint16_t slot);
 uint16_t irEmitStore(IRBuffer* buf, uint16_t slot, uint16_t val);
 uint16_t irEmitLoadField(IRBuffer* buf, uint16_t obj, uint16_t field);
 uint16_t irEmitStoreField(IRBuffer* buf, uint16_t obj, uint16_t field,
                           uint16_t val);
+uint16_t irEmitLoadRaw(IRBuffer* buf, uint16_t obj, int32_t offset,
+                       uint8_t size, IRType type, bool immutable);
+uint16_t irEmitStoreRaw(IRBuffer* buf, uint16_t ptr, int32_t offset,
+                        uint16_t val);
 
 uint16_t irEmitGuardNum(IRBuffer* buf, uint16_t val, uint16_t snapshot);
 uint16_t irEmitGuardClass(IRBuffer* buf, uint16_t val, void* classPtr,
@@ -198,6 +250,13 @@ uint16_t irEmitGuardClass(IRBuffer* buf, uint16_t val, void* classPtr,
 uint16_t irEmitGuardTrue(IRBuffer* buf, uint16_t val, uint16_t snapshot);
 uint16_t irEmitGuardFalse(IRBuffer* buf, uint16_t val, uint16_t snapshot);
 
+uint16_t irEmitNewInstance(IRBuffer* buf, uint16_t classObj,
+                           uint16_t snapshot);
+uint16_t irEmitStringAppend(IRBuffer* buf, uint16_t str, uint16_t piece,
+                            uint16_t snapshot);
+uint16_t irEmitRandom(IRBuffer* buf, uint16_t random, bool asInt);
+uint16_t irEmitListNumEnd(IRBuffer* buf, uint16_t list, uint16_t from);
+
 uint16_t irEmitBox(IRBuffer* buf, uint16_t val);
 uint16_t irEmitUnbox(IRBuffer* buf, uint16_t val);
 
@@ -205,6 +264,12 @@ uint16_t irEmitSnapshot(IRBuffer* buf, uint8_t* resume_pc, int stack_depth);
 void irSnapshotAddEntry(IRBuffer* buf, uint16_t snapshot_id, uint16_t slot,
                         uint16_t ssa_ref);
 
+// Enter an inlined method; snapshots taken until the matching irPopFrame
+// resume inside it. Returns the frame index, or IR_NONE if the table is full.
+uint16_t irPushFrame(IRBuffer* buf, void* closure, uint8_t* return_pc,
+                     uint16_t base);
+void irPopFrame(IRBuffer* buf);
+
 uint16_t irEmitLoopHeader(IRBuffer* buf);
 uint16_t irEmitLoopBack(IRBuffer* buf);
 uint16_t irEmitSideExit(IRBuffer* buf, uint16_t snapshot_id);
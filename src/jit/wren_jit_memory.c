@@ -7,6 +7,15 @@
 #else
   #include <sys/mman.h>
   #include <unistd.h>
+  #ifdef __linux__
+    #include <sys/syscall.h>
+    #ifndef MFD_CLOEXEC
+      #define MFD_CLOEXEC 0x0001U
+    #endif
+    #ifndef MFD_HUGETLB
+      #define MFD_HUGETLB 0x0004U
+    #endif
+  #endif
   #ifdef __APPLE__
     #include <pthread.h>
     #include <libkern/OSCacheControl.h>
@@ -44,15 +53,104 @@ void* jitMemAlloc(size_t size)
     void* ptr = mmap(NULL, size, prot, flags, -1, 0);
     if (ptr == MAP_FAILED) return NULL;
 
-  #if !defined(__APPLE__)
-    // Linux: make the mapping executable.
-    if (mprotect(ptr, size, PROT_READ | PROT_WRITE | PROT_EXEC) != 0) {
-        munmap(ptr, size);
+    // Elsewhere the mapping starts out read/write; jitMemEndWrite makes it
+    // read/exec, so it is never writable and executable at once.
+    return ptr;
+#endif
+}
+
+void* jitMemAllocHuge(size_t size)
+{
+    if (size == 0 || size % JIT_HUGE_PAGE_SIZE != 0) return NULL;
+
+#if defined(__linux__)
+    int prot = PROT_READ | PROT_WRITE;
+
+  #ifdef MAP_HUGETLB
+    // Explicit huge pages, if the administrator reserved any.
+    void* ptr = mmap(NULL, size, prot,
+                     MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    if (ptr != MAP_FAILED) return ptr;
+  #endif
+
+    // Otherwise ask for transparent huge pages on a 2 MB aligned mapping.
+    // Over-allocate by one huge page and trim both ends to the alignment.
+    size_t span = size + JIT_HUGE_PAGE_SIZE;
+    uint8_t* raw = (uint8_t*)mmap(NULL, span, PROT_READ | PROT_WRITE,
+                                  MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (raw == MAP_FAILED) return NULL;
+
+    uintptr_t aligned = ((uintptr_t)raw + JIT_HUGE_PAGE_SIZE - 1) &
+                        ~(uintptr_t)(JIT_HUGE_PAGE_SIZE - 1);
+    size_t head = (size_t)(aligned - (uintptr_t)raw);
+    size_t tail = span - head - size;
+    if (head > 0) munmap(raw, head);
+    if (tail > 0) munmap((uint8_t*)aligned + size, tail);
+
+  #ifdef MADV_HUGEPAGE
+    madvise((void*)aligned, size, MADV_HUGEPAGE);
+  #endif
+
+    return (void*)aligned;
+#else
+    return NULL;
+#endif
+}
+
+#if defined(__linux__) && defined(SYS_memfd_create)
+// Create a memfd of [size] bytes and map it twice. Returns the read/exec
+// view, or NULL if any step fails (e.g. no hugetlb pages reserved).
+static void* mapDual(unsigned int memfd_flags, size_t size, void** write_view)
+{
+    int fd = (int)syscall(SYS_memfd_create, "wren-jit", memfd_flags);
+    if (fd < 0) return NULL;
+    if (ftruncate(fd, (off_t)size) != 0) {
+        close(fd);
         return NULL;
     }
-  #endif
 
-    return ptr;
+    void* rw = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (rw == MAP_FAILED) {
+        close(fd);
+        return NULL;
+    }
+    void* rx = mmap(NULL, size, PROT_READ | PROT_EXEC, MAP_SHARED, fd, 0);
+    close(fd);
+    if (rx == MAP_FAILED) {
+        munmap(rw, size);
+        return NULL;
+    }
+
+    *write_view = rw;
+    return rx;
+}
+#endif
+
+void* jitMemAllocDual(size_t size, bool huge, void** write_view)
+{
+    if (size == 0 || write_view == NULL) return NULL;
+
+#if defined(__linux__) && defined(SYS_memfd_create)
+    if (huge) {
+        void* rx = mapDual(MFD_CLOEXEC | MFD_HUGETLB, size, write_view);
+        if (rx != NULL) return rx;
+    }
+    return mapDual(MFD_CLOEXEC, size, write_view);
+#else
+    (void)huge;
+    return NULL;
+#endif
+}
+
+void jitMemFreeDual(void* exec_view, void* write_view, size_t size)
+{
+#ifndef _WIN32
+    if (exec_view != NULL) munmap(exec_view, size);
+    if (write_view != NULL) munmap(write_view, size);
+#else
+    (void)exec_view;
+    (void)write_view;
+    (void)size;
 #endif
 }
 
@@ -76,6 +174,9 @@ void jitMemBeginWrite(void* ptr, size_t size)
 #if defined(__APPLE__) && (defined(__aarch64__) || defined(__arm64__))
     // Disable write protection so we can write to JIT memory.
     pthread_jit_write_protect_np(0);
+#elif !defined(_WIN32) && !defined(__APPLE__)
+    // Single-mapped fallback (no memfd): flip the pages to read/write.
+    mprotect(ptr, size, PROT_READ | PROT_WRITE);
 #endif
 }
 
@@ -89,5 +190,319 @@ void jitMemEndWrite(void* ptr, size_t size)
     pthread_jit_write_protect_np(1);
     // Clear instruction cache for the written region.
     sys_icache_invalidate(ptr, size);
+#elif !defined(_WIN32) && !defined(__APPLE__)
+    // Single-mapped fallback: flip the pages to read/exec. SLJIT has already
+    // flushed the instruction cache for the code it emitted.
+    mprotect(ptr, size, PROT_READ | PROT_EXEC);
 #endif
 }
+
+// ---------------------------------------------------------------------------
+// Code arena
+// ---------------------------------------------------------------------------
+
+// Every allocation is preceded by a header so jitPoolFree can find its
+// chunk. Keeps code 16-byte aligned.
+typedef struct {
+    JitCodeChunk* chunk;
+    size_t size;            // header + payload, rounded to JIT_CODE_ALIGN
+} JitCodeHeader;
+
+#define JIT_CODE_ALIGN 16
+#define JIT_CODE_HEADER_SIZE \
+    ((sizeof(JitCodeHeader) + JIT_CODE_ALIGN - 1) & ~(size_t)(JIT_CODE_ALIGN - 1))
+
+static size_t alignUp(size_t n, size_t align)
+{
+    return (n + align - 1) & ~(align - 1);
+}
+
+JitMemoryPool* jitPoolCreate(bool huge_pages)
+{
+    JitMemoryPool* pool = (JitMemoryPool*)calloc(1, sizeof(JitMemoryPool));
+    if (pool == NULL) return NULL;
+
+    pool->huge_pages = huge_pages;
+    pool->chunk_size = huge_pages ? JIT_HUGE_PAGE_SIZE : JIT_CODE_CHUNK_SIZE;
+    return pool;
+}
+
+static void releaseChunk(JitMemoryPool* pool, JitCodeChunk* chunk)
+{
+    pool->bytes_mapped -= chunk->size;
+    if (chunk->dual) {
+        jitMemFreeDual(chunk->base, chunk->write_base, chunk->size);
+    } else {
+        jitMemFree(chunk->base, chunk->size);
+    }
+    free(chunk);
+}
+
+// Forget every hole in [chunk], which is being rewound or unmapped.
+static void dropHoles(JitMemoryPool* pool, JitCodeChunk* chunk)
+{
+    JitFreeBlock** link = &pool->holes;
+    while (*link != NULL) {
+        JitFreeBlock* hole = *link;
+        if (hole->chunk != chunk) {
+            link = &hole->next;
+            continue;
+        }
+        *link = hole->next;
+        free(hole);
+    }
+}
+
+// Whether a hole at (chunk, offset) sorts before [hole].
+static bool holeBefore(const JitCodeChunk* chunk, size_t offset,
+                       const JitFreeBlock* hole)
+{
+    if (chunk != hole->chunk) return (uintptr_t)chunk < (uintptr_t)hole->chunk;
+    return offset < hole->offset;
+}
+
+// Return [size] bytes at [offset] of [chunk] to the pool, merging them with
+// adjacent holes. Space at the end of the bump region rewinds it instead.
+static void addHole(JitMemoryPool* pool, JitCodeChunk* chunk, size_t offset,
+                    size_t size)
+{
+    JitFreeBlock* prev = NULL;
+    JitFreeBlock* next = pool->holes;
+    while (next != NULL && !holeBefore(chunk, offset, next)) {
+        prev = next;
+        next = next->next;
+    }
+
+    bool joinsPrev = prev != NULL && prev->chunk == chunk &&
+                     prev->offset + prev->size == offset;
+    bool joinsNext = next != NULL && next->chunk == chunk &&
+                     offset + size == next->offset;
+
+    if (joinsPrev) {
+        prev->size += size;
+        if (joinsNext) {
+            prev->size += next->size;
+            prev->next = next->next;
+            free(next);
+        }
+    } else if (joinsNext) {
+        next->offset = offset;
+        next->size += size;
+        prev = next;
+    } else {
+        JitFreeBlock* hole = (JitFreeBlock*)malloc(sizeof(JitFreeBlock));
+        // Out of memory: the space is lost until the chunk empties.
+        if (hole == NULL) return;
+        hole->chunk = chunk;
+        hole->offset = offset;
+        hole->size = size;
+        hole->next = next;
+        if (prev != NULL) prev->next = hole;
+        else pool->holes = hole;
+        prev = hole;
+    }
+
+    // prev is now the hole holding the freed space.
+    if (prev->offset + prev->size != chunk->used) return;
+    chunk->used = prev->offset;
+    JitFreeBlock** link = &pool->holes;
+    while (*link != prev) link = &(*link)->next;
+    *link = prev->next;
+    free(prev);
+}
+
+// Carve [total] bytes out of the first hole large enough. Returns the
+// chunk and sets *offset and *total (grown to the whole hole when the
+// remainder would be too small to use), or returns NULL.
+static JitCodeChunk* takeHole(JitMemoryPool* pool, size_t* offset,
+                              size_t* total)
+{
+    JitFreeBlock** link = &pool->holes;
+    while (*link != NULL && (*link)->size < *total) link = &(*link)->next;
+    if (*link == NULL) return NULL;
+
+    JitFreeBlock* hole = *link;
+    JitCodeChunk* chunk = hole->chunk;
+    *offset = hole->offset;
+    if (hole->size - *total < JIT_CODE_HEADER_SIZE + JIT_CODE_ALIGN) {
+        *total = hole->size;
+        *link = hole->next;
+        free(hole);
+    } else {
+        hole->offset += *total;
+        hole->size -= *total;
+    }
+    return chunk;
+}
+
+void jitPoolDestroy(JitMemoryPool* pool)
+{
+    if (pool == NULL) return;
+
+    while (pool->holes != NULL) {
+        JitFreeBlock* next = pool->holes->next;
+        free(pool->holes);
+        pool->holes = next;
+    }
+
+    JitCodeChunk* chunk = pool->chunks;
+    while (chunk != NULL) {
+        JitCodeChunk* next = chunk->next;
+        releaseChunk(pool, chunk);
+        chunk = next;
+    }
+    free(pool);
+}
+
+// Map a new chunk of at least [min_size] bytes and make it the head.
+static JitCodeChunk* addChunk(JitMemoryPool* pool, size_t min_size)
+{
+    JitCodeChunk* chunk = (JitCodeChunk*)calloc(1, sizeof(JitCodeChunk));
+    if (chunk == NULL) return NULL;
+
+    size_t size = pool->chunk_size;
+    if (min_size > size) size = alignUp(min_size, pool->chunk_size);
+
+    // Prefer a dual mapping: code is written through one view and executed
+    // through the other, so no page is ever writable and executable and
+    // compiling needs no permission changes.
+    void* write_view = NULL;
+    chunk->base = (uint8_t*)jitMemAllocDual(size, pool->huge_pages,
+                                            &write_view);
+    if (chunk->base != NULL) {
+        chunk->write_base = (uint8_t*)write_view;
+        chunk->dual = true;
+    } else {
+        if (pool->huge_pages) {
+            chunk->base = (uint8_t*)jitMemAllocHuge(size);
+            chunk->huge = chunk->base != NULL;
+        }
+        if (chunk->base == NULL) chunk->base = (uint8_t*)jitMemAlloc(size);
+        if (chunk->base == NULL) {
+            free(chunk);
+            return NULL;
+        }
+        chunk->write_base = chunk->base;
+    }
+
+    chunk->size = size;
+    chunk->next = pool->chunks;
+    pool->chunks = chunk;
+    pool->bytes_mapped += size;
+    return chunk;
+}
+
+void* jitPoolAlloc(JitMemoryPool* pool, size_t size)
+{
+    if (pool == NULL || size == 0) return NULL;
+
+    size_t total = JIT_CODE_HEADER_SIZE + alignUp(size, JIT_CODE_ALIGN);
+
+    size_t offset;
+    JitCodeChunk* chunk = takeHole(pool, &offset, &total);
+    if (chunk == NULL) {
+        chunk = pool->chunks;
+        if (chunk == NULL || chunk->size - chunk->used < total) {
+            chunk = addChunk(pool, total);
+            if (chunk == NULL) return NULL;
+        }
+        offset = chunk->used;
+        chunk->used += total;
+    }
+
+    uint8_t* block = chunk->write_base + offset;
+    chunk->live += total;
+    pool->bytes_live += total;
+
+    // A single mapping must be made writable for the whole compile; the
+    // dual-mapped write view already is.
+    if (!chunk->dual && !chunk->writable) {
+        jitMemBeginWrite(chunk->base, chunk->size);
+        chunk->writable = true;
+    }
+
+    JitCodeHeader* header = (JitCodeHeader*)block;
+    header->chunk = chunk;
+    header->size = total;
+    return block + JIT_CODE_HEADER_SIZE;
+}
+
+// Header of the allocation whose payload starts at ptr (either view).
+static JitCodeHeader* headerOf(void* ptr)
+{
+    return (JitCodeHeader*)((uint8_t*)ptr - JIT_CODE_HEADER_SIZE);
+}
+
+ptrdiff_t jitPoolExecOffset(void* ptr)
+{
+    if (ptr == NULL) return 0;
+    JitCodeChunk* chunk = headerOf(ptr)->chunk;
+    return chunk->base - chunk->write_base;
+}
+
+void jitPoolFree(JitMemoryPool* pool, void* ptr)
+{
+    if (pool == NULL || ptr == NULL) return;
+
+    // ptr is the executable address; the header is readable through it.
+    JitCodeHeader* header = headerOf(ptr);
+    JitCodeChunk* chunk = header->chunk;
+
+    // Freeing code whose compile failed: the chunk still holds other
+    // traces, which must be able to run.
+    if (chunk->writable) {
+        jitMemEndWrite(chunk->base, chunk->size);
+        chunk->writable = false;
+    }
+
+    chunk->live -= header->size;
+    pool->bytes_live -= header->size;
+    if (chunk->live != 0) {
+        size_t offset = (size_t)((uint8_t*)header - chunk->base);
+        addHole(pool, chunk, offset, header->size);
+        return;
+    }
+
+    // The current chunk is rewound and reused; older empty chunks are
+    // returned to the OS.
+    dropHoles(pool, chunk);
+    if (chunk == pool->chunks) {
+        chunk->used = 0;
+        return;
+    }
+
+    JitCodeChunk** link = &pool->chunks;
+    while (*link != chunk) link = &(*link)->next;
+    *link = chunk->next;
+    releaseChunk(pool, chunk);
+}
+
+void jitPoolUpdateWX(void* from, void* to, int enable_exec)
+{
+    (void)to;
+
+    // SLJIT has flushed the instruction cache for [from, to) once for the
+    // whole trace. Dual-mapped chunks need nothing else; a single mapping
+    // is switched as a whole, so it costs one mprotect per compile.
+    JitCodeChunk* chunk = headerOf(from)->chunk;
+    if (chunk->dual) return;
+
+    if (enable_exec) {
+        jitMemEndWrite(chunk->base, chunk->size);
+    } else {
+        jitMemBeginWrite(chunk->base, chunk->size);
+    }
+    chunk->writable = !enable_exec;
+}
+
+void jitPoolSeal(JitMemoryPool* pool)
+{
+    if (pool == NULL) return;
+
+    for (JitCodeChunk* chunk = pool->chunks; chunk != NULL;
+         chunk = chunk->next) {
+        if (!chunk->writable) continue;
+        jitMemEndWrite(chunk->base, chunk->size);
+        chunk->writable = false;
+    }
+}
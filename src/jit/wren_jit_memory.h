@@ -2,12 +2,33 @@
 #define WREN_JIT_MEMORY_H
 
 #include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
 
-// Allocate executable+writable memory of [size] bytes.
+// Allocate [size] bytes of code memory with a single mapping. On Linux it
+// starts read/write and is switched to read/exec by jitMemEndWrite; on
+// Apple Silicon it is a MAP_JIT mapping toggled per thread.
 // Returns NULL on failure.
 void* jitMemAlloc(size_t size);
 
-// Free executable memory previously allocated with jitMemAlloc.
+// Like jitMemAlloc, but backs the mapping with 2 MB pages (explicit huge
+// pages, or transparent huge pages on a 2 MB aligned mapping).
+// [size] must be a multiple of JIT_HUGE_PAGE_SIZE. Returns NULL if huge
+// pages are unavailable on this platform.
+void* jitMemAllocHuge(size_t size);
+
+// Map [size] bytes twice from one memfd: *write_view is read/write and the
+// returned view is read/exec, at a fixed offset from each other. Code is
+// written through one and run through the other, so W^X holds without any
+// permission changes. Returns NULL where memfd is unavailable (non-Linux,
+// or blocked by policy); callers fall back to jitMemAlloc.
+void* jitMemAllocDual(size_t size, bool huge, void** write_view);
+
+// Unmap both views of a jitMemAllocDual allocation.
+void jitMemFreeDual(void* exec_view, void* write_view, size_t size);
+
+// Free executable memory previously allocated with jitMemAlloc or
+// jitMemAllocHuge.
 void jitMemFree(void* ptr, size_t size);
 
 // On Apple Silicon (arm64): switch memory to write mode before writing.
@@ -16,4 +37,81 @@ void jitMemBeginWrite(void* ptr, size_t size);
 // On Apple Silicon: switch memory back to exec mode after writing.
 void jitMemEndWrite(void* ptr, size_t size);
 
+// ---- Code arena ----
+//
+// Each VM owns one arena. Traces are bump-allocated out of large chunks
+// obtained from jitMemAlloc, so code for different traces is packed
+// together (better i-cache and iTLB locality) and the whole arena is
+// released at once in wrenJitFree. Arenas are never shared between VMs, so
+// allocation takes no lock.
+//
+// SLJIT allocates through the arena (see sljitConfigPre.h): the pool is the
+// exec_allocator_data argument of sljit_generate_code / sljit_free_code.
+
+#define JIT_CODE_CHUNK_SIZE (256 * 1024)
+#define JIT_HUGE_PAGE_SIZE  (2 * 1024 * 1024)
+
+typedef struct JitCodeChunk {
+    struct JitCodeChunk* next;
+    uint8_t* base;          // start of the executable view
+    uint8_t* write_base;    // start of the writable view (== base unless dual)
+    size_t size;            // mapping size in bytes
+    size_t used;            // bump offset
+    size_t live;            // bytes held by allocations not yet freed
+    bool huge;              // backed by jitMemAllocHuge
+    bool dual;              // separate write/exec views (jitMemAllocDual)
+    bool writable;          // single mapping left read/write for a compile
+} JitCodeChunk;
+
+// A freed allocation that jitPoolAlloc may hand out again.
+typedef struct JitFreeBlock {
+    struct JitFreeBlock* next;
+    JitCodeChunk* chunk;
+    size_t offset;          // from the start of the chunk
+    size_t size;
+} JitFreeBlock;
+
+typedef struct JitMemoryPool {
+    JitCodeChunk* chunks;   // newest first; allocation bumps the head chunk
+    JitFreeBlock* holes;    // freed space inside chunks still in use,
+                            // ordered by chunk and offset
+    size_t chunk_size;
+    bool huge_pages;
+
+    // Statistics
+    size_t bytes_mapped;    // total size of all chunks
+    size_t bytes_live;      // bytes held by live allocations
+} JitMemoryPool;
+
+// Create an empty arena. With huge_pages, chunks are 2 MB and backed by
+// huge pages where the platform allows it.
+JitMemoryPool* jitPoolCreate(bool huge_pages);
+
+// Unmap every chunk and free the pool, regardless of live allocations.
+void jitPoolDestroy(JitMemoryPool* pool);
+
+// Allocate [size] bytes of code memory, 16-byte aligned. Freed space is
+// reused first, so traces that come and go do not keep mapping new chunks.
+// Returns the writable address; the code runs at that address +
+// jitPoolExecOffset(). Returns NULL on failure.
+void* jitPoolAlloc(JitMemoryPool* pool, size_t size);
+
+// Distance from the writable to the executable address of an allocation
+// returned by jitPoolAlloc (0 unless the chunk is dual-mapped).
+ptrdiff_t jitPoolExecOffset(void* ptr);
+
+// Release an allocation, given its executable address. Its space is kept
+// for later allocations; a chunk whose allocations have all been freed is
+// rewound (if it is the current chunk) or unmapped.
+void jitPoolFree(JitMemoryPool* pool, void* ptr);
+
+// Called by SLJIT once per compile, after the code is written
+// (SLJIT_UPDATE_WX_FLAGS). [from] is the executable address of the code.
+void jitPoolUpdateWX(void* from, void* to, int enable_exec);
+
+// Make every single-mapped chunk executable again. A compile that fails
+// after jitPoolAlloc never reaches jitPoolUpdateWX, and its chunk would stay
+// read/write under the other traces in it.
+void jitPoolSeal(JitMemoryPool* pool);
+
 #endif
@@ -58,6 +58,7 @@ static bool hasSideEffect(const IRNode* n)
     switch (n->op) {
         case IR_STORE_STACK:
         case IR_STORE_FIELD:
+        case IR_STORE_RAW:
         case IR_STORE_MODULE_VAR:
         case IR_GUARD_NUM:
         case IR_GUARD_CLASS:
@@ -68,6 +69,9 @@ static bool hasSideEffect(const IRNode* n)
         case IR_SNAPSHOT:
         case IR_CALL_C:
         case IR_CALL_WREN:
+        case IR_NEW_INSTANCE:
+        case IR_STRING_APPEND:
+        case IR_RANDOM:
         case IR_LOOP_HEADER:
         case IR_LOOP_BACK:
             return true;
@@ -93,7 +97,8 @@ static void replaceUses(IRBuffer* buf, uint16_t old, uint16_t rep)
         IRNode* n = &buf->nodes[i];
         if (n->op == IR_NOP) continue;
         if (n->op1 == old) n->op1 = rep;
-        if (n->op2 == old) n->op2 = rep;
+        // GUARD_CLASS keeps its snapshot id in op2.
+        if (n->op2 == old && n->op != IR_GUARD_CLASS) n->op2 = rep;
     }
     // Also update snapshot entries.
     for (uint16_t i = 0; i < buf->snapshot_entry_count; i++) {
@@ -102,6 +107,15 @@ static void replaceUses(IRBuffer* buf, uint16_t old, uint16_t rep)
     }
 }
 
+// A guard moved before the loop runs before the body state its snapshot
+// describes exists, so it must exit to the top of the loop instead.
+static void retargetHoistedGuard(IRBuffer* buf, IRNode* g)
+{
+    if (buf->entry_snapshot == IR_NONE) return;
+    if (g->op == IR_GUARD_CLASS) g->op2 = buf->entry_snapshot;
+    else g->imm.snapshot_id = buf->entry_snapshot;
+}
+
 // Find the index of IR_LOOP_HEADER, or IR_NONE if absent.
 static uint16_t findLoopHeader(const IRBuffer* buf)
 {
@@ -123,6 +137,50 @@ static uint16_t findLoopBack(const IRBuffer* buf)
     return IR_NONE;
 }
 
+// Loads of object memory that a store may change: instance fields, mutable
+// LOAD_RAWs and list elements, and scans of the elements.
+static inline bool isMutableLoad(const IRNode* n)
+{
+    return (n->op == IR_LOAD_RAW && !n->imm.raw.immutable) ||
+           n->op == IR_LOAD_FIELD || n->op == IR_LOAD_ELEM ||
+           n->op == IR_LIST_NUM_END;
+}
+
+// True if the loop body may write object memory (so mutable loads are not
+// invariant).
+static bool loopWritesHeap(const IRBuffer* buf, uint16_t header, uint16_t back)
+{
+    for (uint16_t k = header + 1; k < back; k++) {
+        const IRNode* s = &buf->nodes[k];
+        if (s->flags & IR_FLAG_DEAD) continue;
+        if (s->op == IR_STORE_FIELD || s->op == IR_STORE_RAW ||
+            s->op == IR_CALL_C || s->op == IR_CALL_WREN ||
+            s->op == IR_STRING_APPEND || s->op == IR_RANDOM)
+            return true;
+    }
+    return false;
+}
+
+// First free pre-header slot at or after `from` that also follows every
+// pre-header operand of n, so hoisted code still runs after what it reads.
+// Returns IR_NONE if there is none.
+static uint16_t findHoistSlot(const IRBuffer* buf, uint16_t header,
+                              const IRNode* n, uint16_t from)
+{
+    uint16_t start = from;
+    if (n->op1 != IR_NONE && n->op1 < header && n->op1 >= start)
+        start = (uint16_t)(n->op1 + 1);
+    // GUARD_CLASS keeps its snapshot id in op2.
+    if (n->op != IR_GUARD_CLASS &&
+        n->op2 != IR_NONE && n->op2 < header && n->op2 >= start)
+        start = (uint16_t)(n->op2 + 1);
+
+    for (uint16_t j = start; j < header; j++) {
+        if (buf->nodes[j].op == IR_NOP) return j;
+    }
+    return IR_NONE;
+}
+
 // ===========================================================================
 // Pass 1: Box/Unbox Elimination (~200 LOC)
 //
@@ -163,6 +221,24 @@ void irOptBoxUnboxElim(IRBuffer* buf)
                 killNode(n);
                 continue;
             }
+            // An integer read back as a double: its users take the INT,
+            // which the code generator converts where a double is needed.
+            if (src->op == IR_BOX_INT) {
+                replaceUses(buf, i, src->op1);
+                killNode(n);
+                continue;
+            }
+        }
+
+        // An integer boxed as a double comes back unchanged. The reverse
+        // does not hold: UNBOX_INT truncates.
+        if (n->op == IR_UNBOX_INT && n->op1 != IR_NONE) {
+            IRNode* src = &buf->nodes[n->op1];
+            if (src->op == IR_BOX_INT) {
+                replaceUses(buf, i, src->op1);
+                killNode(n);
+                continue;
+            }
         }
 
         if (n->op == IR_BOX_OBJ && n->op1 != IR_NONE) {
@@ -346,8 +422,9 @@ void irOptConstPropFold(IRBuffer* buf)
         if (n->op != IR_PHI) continue;
         if (n->op1 == IR_NONE || n->op2 == IR_NONE) continue;
 
-        // Same SSA id on both inputs.
-        if (n->op1 == n->op2) {
+        // Same SSA id on both inputs, or a back edge that hands the PHI
+        // straight back.
+        if (n->op1 == n->op2 || n->op2 == i) {
             replaceUses(buf, i, n->op1);
             killNode(n);
             continue;
@@ -533,11 +610,13 @@ void irOptConstPropFold(IRBuffer* buf)
             }
         }
 
-        // GUARD_NUM on output of arithmetic/UNBOX_NUM/CONST_NUM => dead.
+        // GUARD_NUM on output of arithmetic/UNBOX_NUM/CONST_NUM, or on a
+        // boxed number => dead.
         if (n->op == IR_GUARD_NUM && n->op1 != IR_NONE) {
             IRNode* a = &buf->nodes[n->op1];
             if (isArith(a->op) || a->op == IR_NEG || a->op == IR_CONST_NUM ||
-                a->op == IR_CONST_INT || a->op == IR_UNBOX_NUM) {
+                a->op == IR_CONST_INT || a->op == IR_UNBOX_NUM ||
+                a->op == IR_BOX_NUM || a->op == IR_BOX_INT) {
                 killNode(n);
                 continue;
             }
@@ -581,8 +660,19 @@ void irOptGVN(IRBuffer* buf)
     static uint16_t table[GVN_TABLE_SIZE];
     memset(table, 0xFF, sizeof(table)); // fill with IR_NONE
 
+    // Index of the last node that may have written object memory. Mutable
+    // loads are only merged with an earlier load after it. The loop header
+    // counts as a write: a store later in the body runs before the next
+    // iteration's loads.
+    uint16_t heapBarrier = 0;
+
     for (uint16_t i = 0; i < buf->count; i++) {
         IRNode* n = &buf->nodes[i];
+        if (n->op == IR_STORE_FIELD || n->op == IR_STORE_RAW ||
+            n->op == IR_CALL_C || n->op == IR_CALL_WREN ||
+            n->op == IR_STRING_APPEND || n->op == IR_RANDOM ||
+            n->op == IR_LOOP_HEADER)
+            heapBarrier = i;
         if (n->op == IR_NOP || hasSideEffect(n)) continue;
         // Do not deduplicate PHI or loop-control nodes.
         if (n->op == IR_PHI || n->op == IR_LOOP_HEADER ||
@@ -606,6 +696,12 @@ void irOptGVN(IRBuffer* buf)
             }
 
             if (gvnEqual(existing, n)) {
+                // A store may have changed the field since; this load
+                // becomes the one later loads merge with.
+                if (isMutableLoad(n) && table[idx] < heapBarrier) {
+                    table[idx] = i;
+                    break;
+                }
                 replaceUses(buf, i, table[idx]);
                 killNode(n);
                 break;
@@ -620,7 +716,9 @@ void irOptGVN(IRBuffer* buf)
 // Walk nodes between LOOP_HEADER and LOOP_BACK. If a node's operands are
 // all defined before LOOP_HEADER (or are constants or already marked
 // invariant), the node is invariant. Move invariant nodes to an empty NOP
-// slot before the loop header.
+// slot before the loop header. Guards on hoisted values move with them, in
+// program order, so a hoisted load never runs ahead of the guard that makes
+// it safe (e.g. a LOAD_RAW of a Range field behind its GUARD_CLASS).
 // ===========================================================================
 void irOptLICM(IRBuffer* buf)
 {
@@ -630,6 +728,8 @@ void irOptLICM(IRBuffer* buf)
     uint16_t back = findLoopBack(buf);
     if (back == IR_NONE) return;
 
+    bool heapWritten = loopWritesHeap(buf, header, back);
+
     // First pass: mark nodes that are loop-invariant.
     // We iterate until no more changes (fixed-point), because an invariant
     // node's result makes downstream nodes potentially invariant too.
@@ -656,6 +756,7 @@ void irOptLICM(IRBuffer* buf)
                 }
                 if (written) continue; // leave not-invariant
             }
+            if (isMutableLoad(n) && heapWritten) continue;
 
             bool invariant = true;
 
@@ -688,23 +789,29 @@ void irOptLICM(IRBuffer* buf)
         }
     }
 
-    // Second pass: move invariant nodes before the loop header.
+    // Second pass: move invariant nodes (and guards on values that are now
+    // hoisted) before the loop header, keeping their relative order.
+    uint16_t cursor = 0;
     for (uint16_t i = header + 1; i < back; i++) {
         IRNode* n = &buf->nodes[i];
-        if (!(n->flags & IR_FLAG_INVARIANT)) continue;
         if (n->flags & IR_FLAG_HOISTED) continue;
 
-        // Find an empty NOP slot before the header.
-        for (uint16_t j = 0; j < header; j++) {
-            if (buf->nodes[j].op == IR_NOP) {
-                buf->nodes[j]    = *n;
-                buf->nodes[j].id = j;
-                buf->nodes[j].flags |= IR_FLAG_HOISTED;
-                replaceUses(buf, i, j);
-                killNode(n);
-                break;
-            }
-        }
+        bool hoistGuard = isGuard(n->op) && n->op1 != IR_NONE &&
+                          n->op1 < header &&
+                          buf->nodes[n->op1].op != IR_PHI;
+        if (!(n->flags & IR_FLAG_INVARIANT) && !hoistGuard) continue;
+
+        uint16_t j = findHoistSlot(buf, header, n, cursor);
+        if (j == IR_NONE) continue;
+
+        buf->nodes[j]    = *n;
+        buf->nodes[j].id = j;
+        buf->nodes[j].flags |= IR_FLAG_HOISTED;
+        if (isGuard(n->op))
+            retargetHoistedGuard(buf, &buf->nodes[j]);
+        if (!hoistGuard) replaceUses(buf, i, j);
+        killNode(n);
+        cursor = (uint16_t)(j + 1);
     }
 }
 
@@ -734,16 +841,14 @@ void irOptGuardHoist(IRBuffer* buf)
         if (n->op1 >= header) continue;
         if (buf->nodes[n->op1].op == IR_PHI) continue;
 
-        // Find an empty NOP slot before the header.
-        for (uint16_t j = 0; j < header; j++) {
-            if (buf->nodes[j].op == IR_NOP) {
-                buf->nodes[j]    = *n;
-                buf->nodes[j].id = j;
-                buf->nodes[j].flags |= IR_FLAG_HOISTED;
-                killNode(n);
-                break;
-            }
-        }
+        uint16_t j = findHoistSlot(buf, header, n, 0);
+        if (j == IR_NONE) continue;
+
+        buf->nodes[j]    = *n;
+        buf->nodes[j].id = j;
+        buf->nodes[j].flags |= IR_FLAG_HOISTED;
+        retargetHoistedGuard(buf, &buf->nodes[j]);
+        killNode(n);
     }
 }
 
@@ -1053,8 +1158,9 @@ void irOptEscapeAnalysis(IRBuffer* buf)
                 break;
             }
 
-            // Stop at calls (may alias).
-            if (s->op == IR_CALL_C || s->op == IR_CALL_WREN) break;
+            // Stop at calls and raw stores (may alias).
+            if (s->op == IR_CALL_C || s->op == IR_CALL_WREN ||
+                s->op == IR_STORE_RAW) break;
 
             // Stop at other stores to same object (conservative).
             if (s->op == IR_STORE_FIELD && s->op1 == obj) break;
@@ -1063,11 +1169,12 @@ void irOptEscapeAnalysis(IRBuffer* buf)
 }
 
 // ===========================================================================
-// Pass 10: Dead Code Elimination (~200 LOC)
+// Pass 11: Dead Code Elimination (~200 LOC)
 //
-// Mark-sweep from roots. Roots are: STORE_STACK, STORE_FIELD,
+// Mark-sweep from roots. Roots are: STORE_STACK, STORE_FIELD, STORE_RAW,
 // STORE_MODULE_VAR, SIDE_EXIT, LOOP_BACK, LOOP_HEADER, CALL_C, CALL_WREN,
-// SNAPSHOT, PHI, and any guard. Also, any SSA value referenced from a
+// RANDOM (an unused draw still advances the generator), SNAPSHOT, PHI, and
+// any guard. Also, any SSA value referenced from a
 // snapshot entry is a root. Walk backward from roots marking operands as
 // live. Everything not marked gets IR_FLAG_DEAD.
 // ===========================================================================
@@ -1097,12 +1204,14 @@ void irOptDCE(IRBuffer* buf)
                 break;
             }
             case IR_STORE_FIELD:
+            case IR_STORE_RAW:
             case IR_STORE_MODULE_VAR:
             case IR_SIDE_EXIT:
             case IR_LOOP_BACK:
             case IR_LOOP_HEADER:
             case IR_CALL_C:
             case IR_CALL_WREN:
+            case IR_RANDOM:
             case IR_SNAPSHOT:
             case IR_PHI:
                 isRoot = true;
@@ -1161,7 +1270,7 @@ void irOptDCE(IRBuffer* buf)
 //   5. Kill the original in-loop LOAD_MODULE_VAR and UNBOX_NUM.
 //
 // This converts memory-based loop variables into register-resident SSA values
-// and creates the PHI structure needed by irOptIVTypeInference (Pass 12).
+// and creates the PHI structure needed by irOptIVTypeInference (Pass 14).
 //
 // Preconditions:
 //   - buf->loop_header points to IR_LOOP_HEADER.
@@ -1181,10 +1290,10 @@ void irOptPromoteLoopVars(IRBuffer* buf)
     // Cursor into the pre-header NOP slot pool.
     uint16_t nextNop = 0;
 
-    // Track which variable pointers have already been promoted so that
-    // duplicate LOAD_MODULE_VAR nodes for the same variable (emitted by the
-    // recorder before GVN runs) don't create extra PHI triples.
-    void*    promoted_ptrs[32 / 3 + 1];  /* sized for JIT_PRE_HEADER_SLOTS=32 */
+    // Track which variables have already been promoted so that duplicate
+    // LOAD_MODULE_VAR nodes for the same variable (emitted by the recorder
+    // before GVN runs) don't create extra PHI triples.
+    int32_t  promoted_vars[32 / 3 + 1];  /* sized for JIT_PRE_HEADER_SLOTS=32 */
     int      promoted_count = 0;
 
     for (uint16_t i = header + 1; i < back; i++) {
@@ -1192,12 +1301,12 @@ void irOptPromoteLoopVars(IRBuffer* buf)
         if (loadN->flags & IR_FLAG_DEAD) continue;
         if (loadN->op != IR_LOAD_MODULE_VAR) continue;
 
-        void* var_ptr = loadN->imm.ptr;
+        int32_t var_idx = loadN->imm.intval;
 
         // Skip if this variable was already promoted by an earlier LOAD node.
         bool already_promoted = false;
         for (int pp = 0; pp < promoted_count; pp++) {
-            if (promoted_ptrs[pp] == var_ptr) { already_promoted = true; break; }
+            if (promoted_vars[pp] == var_idx) { already_promoted = true; break; }
         }
         if (already_promoted) continue;
 
@@ -1217,7 +1326,7 @@ void irOptPromoteLoopVars(IRBuffer* buf)
         for (uint16_t s = header + 1; s < back; s++) {
             const IRNode* sn = &buf->nodes[s];
             if (sn->flags & IR_FLAG_DEAD) continue;
-            if (sn->op == IR_STORE_MODULE_VAR && sn->imm.ptr == var_ptr) {
+            if (sn->op == IR_STORE_MODULE_VAR && sn->imm.intval == var_idx) {
                 store_id = s;
                 break;
             }
@@ -1245,8 +1354,8 @@ void irOptPromoteLoopVars(IRBuffer* buf)
         nextNop += 3;
 
         // Record this variable as promoted so duplicate LOADs are skipped.
-        if (promoted_count < (int)(sizeof(promoted_ptrs) / sizeof(promoted_ptrs[0])))
-            promoted_ptrs[promoted_count++] = var_ptr;
+        if (promoted_count < (int)(sizeof(promoted_vars) / sizeof(promoted_vars[0])))
+            promoted_vars[promoted_count++] = var_idx;
 
         // j0: copy of LOAD_MODULE_VAR, placed in pre-header.
         buf->nodes[j0] = *loadN;
@@ -1277,7 +1386,7 @@ void irOptPromoteLoopVars(IRBuffer* buf)
             memset(&j2n->imm, 0, sizeof(j2n->imm));
         }
 
-        // Replace ALL in-loop LOAD_MODULE_VAR(var_ptr) nodes with j0, and
+        // Replace ALL in-loop LOAD_MODULE_VAR(var_idx) nodes with j0, and
         // ALL UNBOX_NUM nodes that consume any such LOAD with j2.  A single
         // trace can load the same module variable multiple times per iteration
         // (e.g. once for the loop condition, once per operand in the body), so
@@ -1287,7 +1396,7 @@ void irOptPromoteLoopVars(IRBuffer* buf)
             IRNode* kn = &buf->nodes[k];
             if (kn->flags & IR_FLAG_DEAD) continue;
 
-            if (kn->op == IR_LOAD_MODULE_VAR && kn->imm.ptr == var_ptr) {
+            if (kn->op == IR_LOAD_MODULE_VAR && kn->imm.intval == var_idx) {
                 replaceUses(buf, k, j0);
                 killNode(kn);
                 continue;
@@ -1306,6 +1415,794 @@ void irOptPromoteLoopVars(IRBuffer* buf)
     }
 }
 
+// ===========================================================================
+// Pass 19: String builders
+//
+// `s = s + piece` in a loop copies the whole accumulator on every iteration.
+// When the string being appended to can never be seen again, its
+// STRING_APPEND is marked IR_FLAG_IN_PLACE and wrenJitStringAppend writes
+// the piece into spare capacity instead (see wren_jit.c), so the loop is
+// linear in the length of the result.
+//
+// That holds for a chain
+//
+//   LOAD_STACK(slot) -> STRING_APPEND -> ... -> STRING_APPEND -> STORE_STACK(slot)
+//
+// (or one from the PHI irOptPeelLoop made for the slot to that PHI's
+// back-edge value) inside the loop when every link but the last is used
+// only as the next append's op1 (and by snapshots taken up to that append,
+// whose exits run before the string changes), and the last link is used
+// only by stores back to the slot and by snapshots. Guards do not count:
+// they only read the class. The next iteration then reaches the grown
+// string only through the slot's single load (or the PHI).
+// ===========================================================================
+void irOptStringBuilders(IRBuffer* buf)
+{
+    uint16_t header = findLoopHeader(buf);
+    uint16_t back = findLoopBack(buf);
+    if (header == IR_NONE || back == IR_NONE) return;
+
+    static uint16_t uses[IR_MAX_NODES];     // non-snapshot uses
+    static uint16_t user[IR_MAX_NODES];     // the last such use
+    static uint16_t lastSnap[IR_MAX_NODES]; // latest snapshot referencing it
+    memset(uses, 0, sizeof(uses));
+    memset(lastSnap, 0xFF, sizeof(lastSnap));
+
+    for (uint16_t i = 0; i < buf->count; i++) {
+        const IRNode* n = &buf->nodes[i];
+        // A guard only looks at the class, which an append leaves alone.
+        if (n->op == IR_NOP || isGuard(n->op)) continue;
+        uint16_t ops[2] = { n->op1, n->op2 };
+        for (int k = 0; k < 2; k++) {
+            if (ops[k] >= buf->count) continue;
+            uses[ops[k]]++;
+            user[ops[k]] = i;
+        }
+    }
+    for (uint16_t s = 0; s < buf->snapshot_count; s++) {
+        const IRSnapshot* snap = &buf->snapshots[s];
+        for (uint16_t e = 0; e < snap->num_entries; e++) {
+            uint16_t ref = buf->snapshot_entries[snap->entry_start + e].ssa_ref;
+            if (ref >= buf->count) continue;
+            if (lastSnap[ref] == IR_NONE || s > lastSnap[ref]) lastSnap[ref] = s;
+        }
+    }
+
+    for (uint16_t i = 0; i < back; i++) {
+        const IRNode* start = &buf->nodes[i];
+        // In a peeled loop the accumulator arrives in a PHI instead of
+        // being loaded from its slot.
+        bool isPhi = start->op == IR_PHI && i < header;
+        if (!isPhi && (start->op != IR_LOAD_STACK || i < header)) continue;
+
+        // Follow the chain of appends.
+        uint16_t link = i;
+        uint16_t first = IR_NONE;
+        while (uses[link] == 1) {
+            const IRNode* a = &buf->nodes[user[link]];
+            if (a->op != IR_STRING_APPEND || a->op1 != link) break;
+            if (lastSnap[link] != IR_NONE &&
+                lastSnap[link] > a->imm.snapshot_id) break;
+            if (first == IR_NONE) first = user[link];
+            link = user[link];
+        }
+        if (first == IR_NONE || buf->nodes[link].op != IR_STRING_APPEND)
+            continue;
+
+        bool ok = true;
+        if (isPhi) {
+            // The last link must be what the PHI carries round, and no
+            // other PHI may see it. The loop no longer loads the slot.
+            if (start->op2 != link) continue;
+            for (uint16_t p = 0; p < header && ok; p++) {
+                const IRNode* o = &buf->nodes[p];
+                if (p != i && o->op == IR_PHI &&
+                    (o->op1 == link || o->op2 == link))
+                    ok = false;
+            }
+        } else {
+            // The slot must have no other load in the loop, or one of them
+            // could still see the string after it grows.
+            uint16_t slot = start->imm.mem.slot;
+            bool stored = false;
+            for (uint16_t k = header + 1; k < back && ok; k++) {
+                const IRNode* o = &buf->nodes[k];
+                if (k != i && o->op == IR_LOAD_STACK && o->imm.mem.slot == slot)
+                    ok = false;
+                // Every store to the slot in the loop must be of the last
+                // link.
+                if (o->op == IR_STORE_STACK && o->imm.mem.slot == slot) {
+                    if (o->op1 != link) ok = false;
+                    stored = true;
+                }
+            }
+            if (!stored) ok = false;
+        }
+
+        // Otherwise the last link may only be stored back, to one slot.
+        uint16_t home = isPhi ? IR_NONE : start->imm.mem.slot;
+        for (uint16_t k = header + 1; k < back && ok; k++) {
+            const IRNode* o = &buf->nodes[k];
+            if (o->op == IR_STORE_STACK && o->op1 == link) {
+                if (home == IR_NONE) home = o->imm.mem.slot;
+                if (o->imm.mem.slot != home) ok = false;
+            } else if (o->op != IR_NOP && !isGuard(o->op) &&
+                       (o->op1 == link || o->op2 == link)) {
+                ok = false;
+            }
+        }
+        if (!ok) continue;
+
+        // Mark every append in the chain.
+        for (uint16_t k = first; ; k = user[k]) {
+            buf->nodes[k].flags |= IR_FLAG_IN_PLACE;
+            if (k == link) break;
+        }
+    }
+}
+
+// ===========================================================================
+// Pass 10: Loop peeling
+//
+// The recorded body runs once as a pre-roll and is then copied after itself
+// as the loop proper, every operand renamed through the copy:
+//
+//   pre-header | pre-roll | PHIs | LOOP_HEADER | copied body | LOOP_BACK
+//
+// Every value the body hands to the next iteration becomes a PHI whose
+// pre-loop input is the pre-roll's result and whose back-edge input is the
+// copy's: each stack slot or module variable the body loads and then
+// stores, and each PHI irOptPromoteLoopVars made. The loop reads the PHI
+// instead of reloading the slot, so its stores only matter to snapshots.
+//
+// A node whose operands the copy leaves unchanged would compute what the
+// pre-roll already did, so the loop reuses the pre-roll's value, unless the
+// node has a side effect or reads object memory the loop writes. A guard
+// on an unchanged value already passed in the pre-roll and is dropped.
+// Later passes fold the rest: UNBOX_NUM(BOX_NUM(phi)) collapses to the PHI
+// and guard elimination removes guards the pre-roll proved.
+//
+// Nothing is peeled when the copy would overflow the node, snapshot or
+// snapshot-entry tables.
+// ===========================================================================
+
+#define PEEL_MAX_LOCATIONS 512
+
+// A stack slot or module variable the loop body touches.
+typedef struct {
+    bool module;        // a module variable rather than a stack slot
+    int32_t index;      // the variable index or the slot
+    bool loaded;        // loaded before any store in the body
+    uint16_t init;      // the last value the body stores, or IR_NONE
+    uint16_t phi;       // the PHI carrying it, if it is loop-carried
+    uint16_t cur;       // the Value the copied body loads instead
+    uint16_t value;     // its Value so far while the body is copied
+} PeelLocation;
+
+// The location a LOAD/STORE_STACK or LOAD/STORE_MODULE_VAR accesses.
+static bool peelLocationOf(const IRNode* n, bool* module, int32_t* index)
+{
+    switch (n->op) {
+        case IR_LOAD_STACK:
+        case IR_STORE_STACK:
+            *module = false;
+            *index = n->imm.mem.slot;
+            return true;
+        case IR_LOAD_MODULE_VAR:
+        case IR_STORE_MODULE_VAR:
+            *module = true;
+            *index = n->imm.intval;
+            return true;
+        default:
+            return false;
+    }
+}
+
+static int findPeelLocation(const PeelLocation* locs, int count, bool module,
+                            int32_t index)
+{
+    for (int k = 0; k < count; k++) {
+        if (locs[k].module == module && locs[k].index == index) return k;
+    }
+    return -1;
+}
+
+// The snapshot node n exits through, or IR_NONE.
+static uint16_t exitSnapshotOf(const IRNode* n)
+{
+    switch (n->op) {
+        case IR_GUARD_CLASS:
+            return n->op2;
+        case IR_GUARD_NUM:
+        case IR_GUARD_TRUE:
+        case IR_GUARD_FALSE:
+        case IR_GUARD_NOT_NULL:
+        case IR_SIDE_EXIT:
+        case IR_NEW_INSTANCE:
+        case IR_STRING_APPEND:
+            return n->imm.snapshot_id;
+        default:
+            // Checked INT arithmetic (irOptRangeAnalysis).
+            if (n->flags & IR_FLAG_CHECKED) return n->imm.snapshot_id;
+            return IR_NONE;
+    }
+}
+
+static void setExitSnapshot(IRNode* n, uint16_t snap)
+{
+    if (n->op == IR_GUARD_CLASS) n->op2 = snap;
+    else n->imm.snapshot_id = snap;
+}
+
+void irOptPeelLoop(IRBuffer* buf)
+{
+    uint16_t header = findLoopHeader(buf);
+    uint16_t back = findLoopBack(buf);
+    if (header == IR_NONE || back == IR_NONE || back < header) return;
+    for (uint16_t i = (uint16_t)(back + 1); i < buf->count; i++) {
+        if (buf->nodes[i].op != IR_NOP) return;
+    }
+
+    static PeelLocation locs[PEEL_MAX_LOCATIONS];
+    int locCount = 0;
+
+    // A reload after a store in the same iteration reads what was just
+    // stored; forward it, so that every load left in the body reads what
+    // the previous iteration left behind.
+    for (uint16_t i = header + 1; i < back; i++) {
+        IRNode* n = &buf->nodes[i];
+        bool module;
+        int32_t index;
+        if (n->op == IR_NOP || !peelLocationOf(n, &module, &index)) continue;
+
+        int k = findPeelLocation(locs, locCount, module, index);
+        if (k < 0) {
+            if (locCount == PEEL_MAX_LOCATIONS) return;
+            k = locCount++;
+            locs[k].module = module;
+            locs[k].index = index;
+            locs[k].loaded = false;
+            locs[k].init = IR_NONE;
+            locs[k].phi = IR_NONE;
+        }
+
+        if (n->op == IR_STORE_STACK || n->op == IR_STORE_MODULE_VAR) {
+            locs[k].init = n->op1;
+        } else if (locs[k].init != IR_NONE) {
+            replaceUses(buf, i, locs[k].init);
+            killNode(n);
+        } else {
+            locs[k].loaded = true;
+        }
+    }
+
+    // Size the copy.
+    int carried = 0, carriedSlots = 0, phis = 0;
+    for (int k = 0; k < locCount; k++) {
+        if (!locs[k].loaded || locs[k].init == IR_NONE) continue;
+        carried++;
+        if (!locs[k].module) carriedSlots++;
+    }
+    for (uint16_t p = 0; p < header; p++) {
+        if (buf->nodes[p].op == IR_PHI) phis++;
+    }
+    int nodes = 0, snaps = 0, entries = 0;
+    for (uint16_t i = header + 1; i < back; i++) {
+        const IRNode* n = &buf->nodes[i];
+        if (n->op == IR_NOP) continue;
+        nodes++;
+        if (n->op == IR_SNAPSHOT) {
+            snaps++;
+            entries += buf->snapshots[n->imm.snapshot_id].num_entries +
+                       carriedSlots;
+        }
+    }
+    if ((int)buf->count + 2 * carried + phis + nodes + 2 > IR_MAX_NODES ||
+        (int)buf->snapshot_count + snaps > IR_MAX_SNAPSHOTS ||
+        (int)buf->snapshot_entry_count + entries > IR_MAX_NODES)
+        return;
+
+    // subst[i] is what node i of the pre-roll is in the copy.
+    static uint16_t subst[IR_MAX_NODES];
+    static uint16_t snapMap[IR_MAX_SNAPSHOTS];
+    for (uint16_t i = 0; i < IR_MAX_NODES; i++) subst[i] = i;
+    for (uint16_t s = 0; s < buf->snapshot_count; s++) snapMap[s] = s;
+
+    bool heapWritten = loopWritesHeap(buf, header, back);
+
+    // PHIs for the carried slots and variables. A number stays unboxed
+    // across the back edge, as a double or as the integer an iterator
+    // keeps, and is boxed again for the loads it replaces.
+    for (int k = 0; k < locCount; k++) {
+        PeelLocation* l = &locs[k];
+        if (!l->loaded || l->init == IR_NONE) continue;
+        const IRNode* v = &buf->nodes[l->init];
+        if (v->op == IR_BOX_NUM) {
+            l->phi = irEmitPhi(buf, v->op1, IR_NONE, IR_TYPE_NUM);
+        } else if (v->op == IR_BOX_INT) {
+            l->phi = irEmitPhi(buf, v->op1, IR_NONE, IR_TYPE_INT);
+        } else {
+            l->phi = irEmitPhi(buf, l->init, IR_NONE, v->type);
+        }
+    }
+    // Each promoted PHI starts the loop from what the pre-roll computed.
+    for (uint16_t p = 0; p < header; p++) {
+        const IRNode* x = &buf->nodes[p];
+        if (x->op != IR_PHI) continue;
+        subst[p] = irEmitPhi(buf, x->op2, IR_NONE, x->type);
+    }
+
+    uint16_t newHeader = irEmitLoopHeader(buf);
+    for (int k = 0; k < locCount; k++) {
+        PeelLocation* l = &locs[k];
+        if (l->phi == IR_NONE) continue;
+        IRType type = buf->nodes[l->phi].type;
+        if (type == IR_TYPE_NUM) l->cur = irEmitBox(buf, l->phi);
+        else if (type == IR_TYPE_INT)
+            l->cur = irEmit(buf, IR_BOX_INT, l->phi, IR_NONE, IR_TYPE_VALUE);
+        else l->cur = l->phi;
+        l->value = l->cur;
+    }
+
+    for (uint16_t i = header + 1; i < back; i++) {
+        const IRNode* n = &buf->nodes[i];
+        if (n->op == IR_NOP) continue;
+
+        bool module;
+        int32_t index;
+        int k = -1;
+        if (peelLocationOf(n, &module, &index))
+            k = findPeelLocation(locs, locCount, module, index);
+
+        if ((n->op == IR_LOAD_STACK || n->op == IR_LOAD_MODULE_VAR) &&
+            k >= 0 && locs[k].phi != IR_NONE) {
+            subst[i] = locs[k].cur;
+            continue;
+        }
+
+        if (n->op == IR_SNAPSHOT) {
+            const IRSnapshot* from = &buf->snapshots[n->imm.snapshot_id];
+            uint16_t s = buf->snapshot_count++;
+            IRSnapshot* to = &buf->snapshots[s];
+            *to = *from;
+            to->num_entries = 0;
+            to->entry_start = buf->snapshot_entry_count;
+            for (uint16_t e = 0; e < from->num_entries; e++) {
+                const IRSnapshotEntry* ent =
+                    &buf->snapshot_entries[from->entry_start + e];
+                uint16_t ref = ent->ssa_ref;
+                irSnapshotAddEntry(buf, s, ent->slot,
+                                   ref < IR_MAX_NODES ? subst[ref] : ref);
+            }
+            // The loop no longer reloads carried slots, so their stores may
+            // go; every exit must write them back itself.
+            for (int c = 0; c < locCount; c++) {
+                const PeelLocation* l = &locs[c];
+                if (l->module || l->phi == IR_NONE) continue;
+                if (l->index >= to->stack_depth) continue;
+                bool present = false;
+                for (uint16_t e = 0; e < from->num_entries && !present; e++) {
+                    present = buf->snapshot_entries[from->entry_start + e]
+                                  .slot == l->index;
+                }
+                if (!present)
+                    irSnapshotAddEntry(buf, s, (uint16_t)l->index, l->value);
+            }
+            snapMap[n->imm.snapshot_id] = s;
+            uint16_t id = irEmit(buf, IR_SNAPSHOT, IR_NONE, IR_NONE,
+                                 IR_TYPE_VOID);
+            buf->nodes[id].imm.snapshot_id = s;
+            continue;
+        }
+
+        uint16_t op1 = n->op1 == IR_NONE ? IR_NONE : subst[n->op1];
+        uint16_t op2 = n->op2;
+        if (n->op != IR_GUARD_CLASS && op2 != IR_NONE) op2 = subst[op2];
+        bool unchanged = op1 == n->op1 && op2 == n->op2;
+
+        if (unchanged && isGuard(n->op)) continue;
+        if (unchanged && !hasSideEffect(n) &&
+            !(isMutableLoad(n) && heapWritten))
+            continue;
+
+        uint16_t id = irEmit(buf, n->op, op1, op2, n->type);
+        IRNode* copy = &buf->nodes[id];
+        copy->imm = n->imm;
+        copy->flags = n->flags & (uint8_t)~(IR_FLAG_INVARIANT |
+                                            IR_FLAG_HOISTED);
+        uint16_t snap = exitSnapshotOf(n);
+        if (snap != IR_NONE) setExitSnapshot(copy, snapMap[snap]);
+        subst[i] = id;
+
+        if ((n->op == IR_STORE_STACK || n->op == IR_STORE_MODULE_VAR) &&
+            k >= 0)
+            locs[k].value = op1;
+    }
+
+    // Close the PHIs over the copy.
+    for (int k = 0; k < locCount; k++) {
+        const PeelLocation* l = &locs[k];
+        if (l->phi == IR_NONE) continue;
+        uint16_t v = subst[l->init];
+        if ((buf->nodes[l->phi].type == IR_TYPE_NUM &&
+             buf->nodes[v].op == IR_BOX_NUM) ||
+            (buf->nodes[l->phi].type == IR_TYPE_INT &&
+             buf->nodes[v].op == IR_BOX_INT))
+            v = buf->nodes[v].op1;
+        buf->nodes[l->phi].op2 = v;
+    }
+    for (uint16_t p = 0; p < header; p++) {
+        IRNode* x = &buf->nodes[p];
+        if (x->op != IR_PHI) continue;
+        buf->nodes[subst[p]].op2 = subst[x->op2];
+    }
+
+    irEmit(buf, IR_LOOP_BACK, newHeader, IR_NONE, IR_TYPE_VOID);
+
+    // The pre-roll is straight-line code now: each promoted PHI there is
+    // just its pre-loop value.
+    killNode(&buf->nodes[header]);
+    killNode(&buf->nodes[back]);
+    for (uint16_t p = 0; p < header; p++) {
+        IRNode* x = &buf->nodes[p];
+        if (x->op != IR_PHI) continue;
+        uint16_t init = x->op1;
+        killNode(x);
+        replaceUses(buf, p, init);
+    }
+}
+
+// ===========================================================================
+// Pass 15: Loop unrolling
+//
+// A short loop body is copied after itself so that one trip round the back
+// edge runs buf->unroll_factor iterations:
+//
+//   PHIs | LOOP_HEADER | body | copy 2 | ... | copy N | LOOP_BACK
+//
+// Where the body reads a PHI, each copy reads what the copy before it
+// computed, and the PHIs close over the last copy. Every copy keeps its own
+// guards and snapshots, so an exit between copies resumes the interpreter
+// in the iteration it left. As in peeling, a node whose operands a copy
+// leaves unchanged is reused instead of copied, and a guard on it dropped.
+//
+// Runs after irOptIVTypeInference, which still sees one step per trip. An
+// integer ADD/SUB of a constant applied to another folds into one add of
+// the combined step, so copy k of a counter computes phi + k directly
+// rather than through every copy before it, and the back edge stays an
+// induction step.
+//
+// The factor is halved until the unrolled body fits in UNROLL_MAX_NODES, so
+// only short bodies (where the back edge, the PHI moves and the loop
+// condition dominate) are unrolled at all. Nothing is unrolled when the
+// copies would overflow the node, snapshot or snapshot-entry tables.
+// ===========================================================================
+
+#define UNROLL_MAX_NODES 64
+
+// True if the body stores to the stack slot or module variable n loads, so
+// each copy must load it again.
+static bool bodyStoresTo(const IRBuffer* buf, uint16_t header, uint16_t back,
+                         const IRNode* n)
+{
+    bool module;
+    int32_t index;
+    if (!peelLocationOf(n, &module, &index)) return false;
+    for (uint16_t k = header + 1; k < back; k++) {
+        const IRNode* s = &buf->nodes[k];
+        bool m;
+        int32_t x;
+        if (s->flags & IR_FLAG_DEAD) continue;
+        if (s->op != IR_STORE_STACK && s->op != IR_STORE_MODULE_VAR) continue;
+        if (peelLocationOf(s, &m, &x) && m == module && x == index)
+            return true;
+    }
+    return false;
+}
+
+// A CONST_INT of value v defined before the loop: an existing one, else a
+// new one in a free pre-header slot. Falls back to appending it.
+static uint16_t unrollConstInt(IRBuffer* buf, uint16_t header, int64_t v)
+{
+    for (uint16_t j = 0; j < header; j++) {
+        const IRNode* c = &buf->nodes[j];
+        if (c->op == IR_CONST_INT && c->imm.i64 == v) return j;
+    }
+    for (uint16_t j = 0; j < header; j++) {
+        IRNode* c = &buf->nodes[j];
+        if (c->op != IR_NOP) continue;
+        memset(c, 0, sizeof(IRNode));
+        c->op = IR_CONST_INT;
+        c->id = j;
+        c->op1 = IR_NONE;
+        c->op2 = IR_NONE;
+        c->type = IR_TYPE_INT;
+        c->imm.i64 = v;
+        return j;
+    }
+    return irEmitConstInt(buf, v);
+}
+
+// The step of an integer ADD/SUB of a constant, or false.
+static bool intStepOf(const IRBuffer* buf, const IRNode* n, int64_t* step)
+{
+    if ((n->op != IR_ADD && n->op != IR_SUB) || n->type != IR_TYPE_INT)
+        return false;
+    if (n->op2 == IR_NONE || buf->nodes[n->op2].op != IR_CONST_INT)
+        return false;
+    int64_t c = buf->nodes[n->op2].imm.i64;
+    *step = n->op == IR_ADD ? c : (int64_t)(0 - (uint64_t)c);
+    return true;
+}
+
+void irOptUnrollLoop(IRBuffer* buf)
+{
+    int factor = buf->unroll_factor;
+    if (factor < 2) return;
+    if (factor > 8) factor = 8;
+
+    uint16_t header = findLoopHeader(buf);
+    uint16_t back = findLoopBack(buf);
+    if (header == IR_NONE || back == IR_NONE || back < header) return;
+    for (uint16_t i = (uint16_t)(back + 1); i < buf->count; i++) {
+        if (buf->nodes[i].op != IR_NOP) return;
+    }
+
+    int nodes = 0, snaps = 0, entries = 0;
+    for (uint16_t i = header + 1; i < back; i++) {
+        const IRNode* n = &buf->nodes[i];
+        if (n->op == IR_NOP || (n->flags & IR_FLAG_DEAD)) continue;
+        nodes++;
+        if (n->op == IR_SNAPSHOT) {
+            snaps++;
+            entries += buf->snapshots[n->imm.snapshot_id].num_entries;
+        }
+    }
+    if (nodes == 0) return;
+    while (factor > 1 && nodes * factor > UNROLL_MAX_NODES) factor /= 2;
+    if (factor < 2) return;
+
+    // Each folded step may add a constant.
+    int copies = factor - 1;
+    if ((int)buf->count + 2 * copies * nodes + 1 > IR_MAX_NODES ||
+        (int)buf->snapshot_count + copies * snaps > IR_MAX_SNAPSHOTS ||
+        (int)buf->snapshot_entry_count + copies * entries > IR_MAX_NODES)
+        return;
+
+    // subst[i] is what node i of the body is in the current copy.
+    static uint16_t subst[IR_MAX_NODES];
+    static uint16_t snapMap[IR_MAX_SNAPSHOTS];
+    static uint16_t next[IR_MAX_NODES];
+    for (uint16_t i = 0; i < IR_MAX_NODES; i++) subst[i] = i;
+    for (uint16_t s = 0; s < buf->snapshot_count; s++) snapMap[s] = s;
+
+    bool heapWritten = loopWritesHeap(buf, header, back);
+
+    // The old LOOP_BACK goes; the copies are appended after it.
+    killNode(&buf->nodes[back]);
+
+    for (int c = 0; c < copies; c++) {
+        // A PHI in this copy is what the last copy hands to the back edge.
+        for (uint16_t p = 0; p < header; p++) {
+            const IRNode* x = &buf->nodes[p];
+            if (x->op == IR_PHI) next[p] = subst[x->op2];
+        }
+        for (uint16_t p = 0; p < header; p++) {
+            if (buf->nodes[p].op == IR_PHI) subst[p] = next[p];
+        }
+
+        for (uint16_t i = header + 1; i < back; i++) {
+            const IRNode* n = &buf->nodes[i];
+            if (n->op == IR_NOP || (n->flags & IR_FLAG_DEAD)) continue;
+
+            if (n->op == IR_SNAPSHOT) {
+                const IRSnapshot* from = &buf->snapshots[n->imm.snapshot_id];
+                uint16_t s = buf->snapshot_count++;
+                IRSnapshot* to = &buf->snapshots[s];
+                *to = *from;
+                to->num_entries = 0;
+                to->entry_start = buf->snapshot_entry_count;
+                for (uint16_t e = 0; e < from->num_entries; e++) {
+                    const IRSnapshotEntry* ent =
+                        &buf->snapshot_entries[from->entry_start + e];
+                    uint16_t ref = ent->ssa_ref;
+                    irSnapshotAddEntry(buf, s, ent->slot,
+                                       ref < IR_MAX_NODES ? subst[ref] : ref);
+                }
+                snapMap[n->imm.snapshot_id] = s;
+                uint16_t id = irEmit(buf, IR_SNAPSHOT, IR_NONE, IR_NONE,
+                                     IR_TYPE_VOID);
+                buf->nodes[id].imm.snapshot_id = s;
+                subst[i] = id;
+                continue;
+            }
+
+            IROp op = n->op;
+            uint16_t op1 = n->op1 == IR_NONE ? IR_NONE : subst[n->op1];
+            uint16_t op2 = n->op2;
+            if (op != IR_GUARD_CLASS && op2 != IR_NONE) op2 = subst[op2];
+            bool unchanged = op1 == n->op1 && op2 == n->op2;
+
+            // subst may still name an earlier copy's node: PHIs that swap
+            // values change a node in one copy and not the next.
+            subst[i] = i;
+            if (unchanged && isGuard(op)) continue;
+            if (unchanged && !hasSideEffect(n) &&
+                !(isMutableLoad(n) && heapWritten) &&
+                !bodyStoresTo(buf, header, back, n))
+                continue;
+
+            // (x + a) + b  =>  x + (a + b)
+            int64_t a, b;
+            if (op1 != IR_NONE && intStepOf(buf, n, &b) &&
+                intStepOf(buf, &buf->nodes[op1], &a)) {
+                op = IR_ADD;
+                op1 = buf->nodes[op1].op1;
+                op2 = unrollConstInt(buf, header,
+                                     (int64_t)((uint64_t)a + (uint64_t)b));
+            }
+
+            uint16_t id = irEmit(buf, op, op1, op2, n->type);
+            IRNode* copy = &buf->nodes[id];
+            copy->imm = n->imm;
+            copy->flags = n->flags & (uint8_t)~(IR_FLAG_INVARIANT |
+                                                IR_FLAG_HOISTED);
+            uint16_t snap = exitSnapshotOf(n);
+            if (snap != IR_NONE) setExitSnapshot(copy, snapMap[snap]);
+            subst[i] = id;
+        }
+    }
+
+    for (uint16_t p = 0; p < header; p++) {
+        IRNode* x = &buf->nodes[p];
+        if (x->op == IR_PHI) x->op2 = subst[x->op2];
+    }
+    irEmit(buf, IR_LOOP_BACK, header, IR_NONE, IR_TYPE_VOID);
+}
+
+// ===========================================================================
+// Pass 16: List element tag checks
+//
+// A loop that walks a List of numbers guards every element it reads:
+//
+//   LT(idx, count) -> GUARD_TRUE ... LOAD_ELEM(data, idx) -> GUARD_NUM
+//
+// When idx only grows (an INT PHI stepped by a positive constant, plus a
+// non-negative constant) and nothing in the loop writes the heap, the
+// elements cannot change under the loop. Once before the loop,
+// LIST_NUM_END scans them in vector-sized blocks for the first one from the
+// PHI's start value on that is not a number. The bounds guard then compares
+// against that index instead of the count, which proves the element is a
+// number, and the GUARD_NUM goes. A loop that reaches a non-number leaves
+// through the bounds guard, before the iteration that would read it, and
+// the next entry scans on from there.
+//
+// The element arithmetic itself stays scalar: reordering a reduction over
+// doubles would change its result.
+// ===========================================================================
+
+#define NUM_RUN_MAX 16
+
+// The increasing INT PHI idx is, plus a constant >= 0, or IR_NONE.
+static uint16_t growingIndexPhi(const IRBuffer* buf, uint16_t header,
+                                uint16_t idx)
+{
+    const IRNode* n = &buf->nodes[idx];
+    uint16_t p = idx;
+    if (n->op == IR_ADD && n->type == IR_TYPE_INT &&
+        buf->nodes[n->op2].op == IR_CONST_INT &&
+        buf->nodes[n->op2].imm.i64 >= 0)
+        p = n->op1;
+    if (p >= header) return IR_NONE;
+
+    const IRNode* phi = &buf->nodes[p];
+    if (phi->op != IR_PHI || phi->type != IR_TYPE_INT) return IR_NONE;
+    if (phi->op1 == IR_NONE || phi->op2 == IR_NONE) return IR_NONE;
+    const IRNode* step = &buf->nodes[phi->op2];
+    if (step->op != IR_ADD || step->op1 != p ||
+        buf->nodes[step->op2].op != IR_CONST_INT ||
+        buf->nodes[step->op2].imm.i64 <= 0)
+        return IR_NONE;
+    return p;
+}
+
+// True if every use of the comparison cmp is a GUARD_TRUE, directly or
+// through a BOX_BOOL that only guards use, and no snapshot keeps it.
+static bool onlyGuarded(const IRBuffer* buf, uint16_t cmp)
+{
+    for (uint16_t i = 0; i < buf->count; i++) {
+        const IRNode* u = &buf->nodes[i];
+        if (u->op == IR_NOP) continue;
+        bool uses = u->op1 == cmp ||
+                    (u->op2 == cmp && u->op != IR_GUARD_CLASS);
+        if (!uses) continue;
+        if (u->op == IR_GUARD_TRUE) continue;
+        if (u->op != IR_BOX_BOOL || !onlyGuarded(buf, i)) return false;
+    }
+    for (uint16_t e = 0; e < buf->snapshot_entry_count; e++) {
+        if (buf->snapshot_entries[e].ssa_ref == cmp) return false;
+    }
+    return true;
+}
+
+// The guarded comparison of idx against the count of list before `before`,
+// with the count read before the loop, or IR_NONE. The count is the only
+// integer field LOAD_RAW reads from a List.
+static uint16_t findBoundsGuard(const IRBuffer* buf, uint16_t header,
+                                uint16_t before, uint16_t idx, uint16_t list)
+{
+    for (uint16_t i = header + 1; i < before; i++) {
+        const IRNode* g = &buf->nodes[i];
+        if (g->op != IR_GUARD_TRUE || g->op1 == IR_NONE) continue;
+        uint16_t c = g->op1;
+        if (buf->nodes[c].op == IR_BOX_BOOL) c = buf->nodes[c].op1;
+        const IRNode* cmp = &buf->nodes[c];
+        if (cmp->op != IR_LT || cmp->op1 != idx) continue;
+        if (cmp->op2 == IR_NONE || cmp->op2 >= header) continue;
+        const IRNode* count = &buf->nodes[cmp->op2];
+        if (count->op != IR_LOAD_RAW || count->op1 != list ||
+            count->type != IR_TYPE_INT)
+            continue;
+        if (onlyGuarded(buf, c)) return c;
+    }
+    return IR_NONE;
+}
+
+void irOptListNumRuns(IRBuffer* buf)
+{
+    uint16_t header = findLoopHeader(buf);
+    uint16_t back = findLoopBack(buf);
+    if (header == IR_NONE || back == IR_NONE || back < header) return;
+    if (loopWritesHeap(buf, header, back)) return;
+
+    // One scan per (list, start) pair.
+    uint16_t runList[NUM_RUN_MAX], runFrom[NUM_RUN_MAX], runEnd[NUM_RUN_MAX];
+    int runs = 0;
+
+    for (uint16_t i = header + 1; i < back; i++) {
+        IRNode* g = &buf->nodes[i];
+        if (g->op != IR_GUARD_NUM || g->op1 == IR_NONE) continue;
+        const IRNode* elem = &buf->nodes[g->op1];
+        if (elem->op != IR_LOAD_ELEM || elem->op1 >= header) continue;
+        const IRNode* data = &buf->nodes[elem->op1];
+        if (data->op != IR_LOAD_RAW || data->op1 == IR_NONE) continue;
+
+        uint16_t list = data->op1;
+        uint16_t idx = elem->op2;
+        uint16_t phi = growingIndexPhi(buf, header, idx);
+        if (phi == IR_NONE) continue;
+        uint16_t from = buf->nodes[phi].op1;
+        if (buf->nodes[from].type != IR_TYPE_INT) continue;
+        uint16_t cmp = findBoundsGuard(buf, header, i, idx, list);
+        if (cmp == IR_NONE) continue;
+
+        int k = 0;
+        while (k < runs && (runList[k] != list || runFrom[k] != from)) k++;
+        if (k == runs) {
+            if (runs == NUM_RUN_MAX) continue;
+            // The scan must see the elements as the loop will.
+            IRNode probe = { .op = IR_LIST_NUM_END, .op1 = list, .op2 = from };
+            uint16_t slot = findHoistSlot(buf, header, &probe, 0);
+            if (slot == IR_NONE || loopWritesHeap(buf, slot, header))
+                continue;
+            IRNode* n = &buf->nodes[slot];
+            memset(n, 0, sizeof(IRNode));
+            n->op = IR_LIST_NUM_END;
+            n->id = slot;
+            n->op1 = list;
+            n->op2 = from;
+            n->type = IR_TYPE_INT;
+            runList[runs] = list;
+            runFrom[runs] = from;
+            runEnd[runs] = slot;
+            runs++;
+        }
+
+        buf->nodes[cmp].op2 = runEnd[k];
+        killNode(g);
+    }
+}
+
 // ===========================================================================
 // Master optimization pipeline
 // ===========================================================================
@@ -1323,8 +2220,19 @@ void irOptimize(IRBuffer* buf)
     irOptStrengthReduce(buf);      // 7. Cheaper ops (MUL->ADD, DIV->MUL)
     irOptBoundsCheckElim(buf);     // 8. Eliminate redundant bounds checks
     irOptEscapeAnalysis(buf);      // 9. Scalar replacement + store-load fwd
-    irOptDCE(buf);                 // 10. Sweep dead code
-    irOptGuardElim(buf);           // 11. Prove-and-delete loop-invariant guards
-    irOptIVTypeInference(buf);     // 12. Integer induction variable promotion
-    irOptDCE(buf);                 // 13. Re-sweep after new eliminations
+    irOptPeelLoop(buf);            // 10. Peel one iteration off the loop,
+    irOptBoxUnboxElim(buf);        //     then fold the copy against it
+    irOptConstPropFold(buf);
+    irOptGVN(buf);
+    irOptDCE(buf);                 // 11. Sweep dead code
+    irOptGuardElim(buf);           // 12. Prove-and-delete loop-invariant guards
+    irOptNarrowNumbers(buf);       // 13. Narrow numbers recorded as integers
+    irOptIVTypeInference(buf);     // 14. Integer induction variable promotion,
+    irOptBoxUnboxElim(buf);        //     then drop the boxes it made redundant
+    irOptUnrollLoop(buf);          // 15. Unroll short loop bodies, then
+    irOptGVN(buf);                 //     merge what the copies recompute
+    irOptListNumRuns(buf);         // 16. Scan list elements once per entry
+    irOptRangeAnalysis(buf);       // 17. Check INT results not proven exact
+    irOptDCE(buf);                 // 18. Re-sweep after new eliminations
+    irOptStringBuilders(buf);      // 19. Grow loop-carried strings in place
 }
@@ -21,9 +21,19 @@ void irOptPromoteLoopVars(IRBuffer* buf);
 //   7. Strength reduction
 //   8. Bounds check elimination
 //   9. Escape analysis
-//  10. Dead code elimination
-//  11. Guard elimination (prove-and-delete loop-invariant guards)
-//  12. IV type inference (integer induction variable promotion)
+//  10. Loop peeling, followed by box/unbox elimination, constant folding
+//      and GVN over the copied body
+//  11. Dead code elimination
+//  12. Guard elimination (prove-and-delete loop-invariant guards)
+//  13. Speculative narrowing of numbers recorded as integers
+//  14. IV type inference (integer induction variable promotion), followed
+//      by box/unbox elimination
+//  15. Loop unrolling by buf->unroll_factor, for short bodies
+//  16. List element tag checks hoisted into one LIST_NUM_END scan
+//  17. Integer range analysis (checks only the INT results it cannot
+//      prove exact)
+//  18. Dead code elimination
+//  19. String builders (in-place STRING_APPEND)
 void irOptimize(IRBuffer* buf);
 
 // Individual passes (exposed for testing / selective use).
@@ -39,5 +49,15 @@ void irOptEscapeAnalysis(IRBuffer* buf);
 void irOptDCE(IRBuffer* buf);
 void irOptGuardElim(IRBuffer* buf);
 void irOptIVTypeInference(IRBuffer* buf);
+void irOptStringBuilders(IRBuffer* buf);
+void irOptPeelLoop(IRBuffer* buf);
+void irOptUnrollLoop(IRBuffer* buf);
+void irOptListNumRuns(IRBuffer* buf);
+void irOptRangeAnalysis(IRBuffer* buf);
+void irOptNarrowNumbers(IRBuffer* buf);
+
+// The snapshot a check at node [id] can exit to: the nearest earlier one in
+// the same iteration with no side effect in between, or IR_NONE.
+uint16_t irOptCheckSnapshot(const IRBuffer* buf, uint16_t id);
 
 #endif // wren_jit_opt_h
@@ -1,5 +1,5 @@
 // ===========================================================================
-// Pass 11: Guard Elimination (~300 LOC)
+// Pass 12: Guard Elimination (~300 LOC)
 //
 // Phase A — prove-and-delete loop-invariant guards:
 //   After GVN + LICM + Guard Hoisting, some guards that were hoisted out of
@@ -43,6 +43,7 @@ static inline bool bsTest(const uint64_t* bs, uint16_t id) {
 //   - its type is IR_TYPE_NUM  (already unboxed double)
 //   - its op is IR_BOX_NUM     (result of boxing a double)
 //   - its op is IR_CONST_NUM   (a constant double)
+//   - its op is IR_BOX_INT     (an integer IV or list index, boxed)
 static bool writtenValueIsNumeric(const IRBuffer* buf, uint16_t val_id)
 {
     if (val_id == IR_NONE || val_id >= buf->count) return false;
@@ -50,6 +51,7 @@ static bool writtenValueIsNumeric(const IRBuffer* buf, uint16_t val_id)
     if (v->type == IR_TYPE_NUM) return true;
     if (v->op == IR_BOX_NUM)    return true;
     if (v->op == IR_CONST_NUM)  return true;
+    if (v->op == IR_BOX_INT)    return true;
     // BOX_BOOL / CONST_BOOL results are Wren booleans, not numbers.
     return false;
 }
@@ -87,7 +89,7 @@ static void phaseA(IRBuffer* buf)
                 const IRNode* s = &buf->nodes[j];
                 if (s->flags & IR_FLAG_DEAD) continue;
                 if (s->op != IR_STORE_MODULE_VAR) continue;
-                if (s->imm.ptr != n->imm.ptr) continue; // different var
+                if (s->imm.intval != n->imm.intval) continue; // different var
                 found = true;
                 if (!writtenValueIsNumeric(buf, s->op1)) {
                     allNumericWrites = false;
@@ -1,5 +1,5 @@
 // ===========================================================================
-// Pass 12: Induction Variable Type Inference (~350 LOC)
+// Pass 14: Induction Variable Type Inference (~350 LOC)
 //
 // Detects integer induction variables (loop counters that increment by a
 // constant integer each iteration) and marks them IR_TYPE_INT so that the
@@ -8,10 +8,15 @@
 //
 // Algorithm:
 //   1. Find IR_PHI nodes where:
-//        op1 (pre-loop value)   is CONST_NUM with an integer value
+//        op1 (pre-loop value)   is CONST_NUM with an integer value, or a
+//                               promoted module variable, or integer
+//                               arithmetic on those (irOptPeelLoop leaves
+//                               the first iteration's increment there)
 //        op2 (back-edge value)  is IR_ADD/IR_SUB with one operand being the
-//                               PHI itself and the other an integer CONST_NUM
-//   2. Tag those PHIs IR_TYPE_INT.
+//                               PHI itself (or such an ADD/SUB) and the
+//                               other an integer CONST_NUM or INT
+//   2. Tag those PHIs IR_TYPE_INT, and compute their pre-loop value in
+//      integers too.
 //   3. Propagate forward: IR_ADD / IR_SUB / IR_MUL with both operands
 //      IR_TYPE_INT produce an IR_TYPE_INT result.
 //   4. Replace type-conversion ops:
@@ -19,6 +24,9 @@
 //        IR_BOX_NUM   whose source is IR_TYPE_INT  ->  IR_BOX_INT
 //   5. Mark comparisons (IR_LT etc.) on two IR_TYPE_INT operands as
 //      IR_TYPE_INT so the codegen selects the integer compare path.
+//
+// The int64 results match the interpreter's doubles only within +-2^53;
+// irOptRangeAnalysis checks the ones it cannot bound.
 // ===========================================================================
 
 #include "wren_jit_ir.h"
@@ -45,6 +53,70 @@ static bool isIntType(const IRBuffer* buf, uint16_t id)
     return buf->nodes[id].type == IR_TYPE_INT;
 }
 
+// True if a PHI's pre-loop value can be computed in integers: an INT, an
+// integer constant, a module variable irOptPromoteLoopVars unboxed, or
+// ADD/SUB/MUL of those. A stack slot's value is not trusted to be integral.
+static bool preValueIsInt(const IRBuffer* buf, uint16_t id, int depth)
+{
+    if (id == IR_NONE || id >= buf->count || depth > 8) return false;
+    const IRNode* n = &buf->nodes[id];
+    if (n->type == IR_TYPE_INT || isIntegerConstNum(n)) return true;
+    if (n->op == IR_UNBOX_NUM) {
+        return n->op1 < buf->count &&
+               buf->nodes[n->op1].op == IR_LOAD_MODULE_VAR;
+    }
+    if (n->op == IR_ADD || n->op == IR_SUB || n->op == IR_MUL) {
+        return preValueIsInt(buf, n->op1, depth + 1) &&
+               preValueIsInt(buf, n->op2, depth + 1);
+    }
+    return false;
+}
+
+// True if [id] is the PHI [phi] with integer constants or INT values added
+// or subtracted, one or more times: a body that updates the variable twice
+// (`i = i + 1` in two places) leaves a chain on the back-edge.
+static bool stepsFromPhi(const IRBuffer* buf, uint16_t id, uint16_t phi,
+                         int depth)
+{
+    if (id == IR_NONE || id >= buf->count || depth > 8) return false;
+    const IRNode* n = &buf->nodes[id];
+    if (n->op != IR_ADD && n->op != IR_SUB) return false;
+    if (n->op1 >= buf->count || n->op2 >= buf->count) return false;
+
+    for (int side = 0; side < 2; side++) {
+        uint16_t var  = side == 0 ? n->op1 : n->op2;
+        uint16_t step = side == 0 ? n->op2 : n->op1;
+        if (!isIntegerConstNum(&buf->nodes[step]) && !isIntType(buf, step))
+            continue;
+        if (var == phi || stepsFromPhi(buf, var, phi, depth + 1))
+            return true;
+    }
+    return false;
+}
+
+// Switch a value preValueIsInt accepted over to integers.
+static void convertPreValue(IRBuffer* buf, uint16_t id)
+{
+    IRNode* n = &buf->nodes[id];
+    if (n->type == IR_TYPE_INT) return;
+    switch (n->op) {
+        case IR_CONST_NUM:
+            n->op      = IR_CONST_INT;
+            n->imm.i64 = (int64_t)n->imm.num;
+            break;
+        case IR_UNBOX_NUM:
+            // The variable's number, not a truncation of it.
+            n->op = IR_UNBOX_INT;
+            n->flags |= IR_FLAG_INTEGRAL;
+            break;
+        default:
+            convertPreValue(buf, n->op1);
+            convertPreValue(buf, n->op2);
+            break;
+    }
+    n->type = IR_TYPE_INT;
+}
+
 // ---------------------------------------------------------------------------
 // Public entry point
 // ---------------------------------------------------------------------------
@@ -81,38 +153,18 @@ void irOptIVTypeInference(IRBuffer* buf)
             if (pre >= buf->count || back >= buf->count) continue;
 
             const IRNode* preNode = &buf->nodes[pre];
-            const IRNode* backNode = &buf->nodes[back];
 
-            // Pre-loop value must be an integer constant, INT, or NUM type.
-            // We accept NUM because irOptPromoteLoopVars places UNBOX_NUM
-            // (type NUM) as the initial value in the pre-header PHI.
+            // Pre-loop value must be an integer constant or computable in
+            // integers (irOptPromoteLoopVars places UNBOX_NUM of the
+            // variable there; a peeled loop the first iteration's result).
             if (!isIntegerConstNum(preNode) &&
-                preNode->type != IR_TYPE_INT &&
-                preNode->type != IR_TYPE_NUM) continue;
-
-            // Back-edge must be ADD or SUB of (phi, const/int) or (const/int, phi).
-            bool backIsIV = false;
-            if (backNode->op == IR_ADD || backNode->op == IR_SUB) {
-                uint16_t b1 = backNode->op1;
-                uint16_t b2 = backNode->op2;
-                if (b1 == IR_NONE || b2 == IR_NONE) continue;
-                if (b1 >= buf->count || b2 >= buf->count) continue;
-
-                bool phiIsLHS = (b1 == i);
-                bool phiIsRHS = (b2 == i);
-                uint16_t step_id = phiIsLHS ? b2 : b1;
-                const IRNode* step = &buf->nodes[step_id];
-
-                if (phiIsLHS || phiIsRHS) {
-                    // Accept constant-integer step or INT-typed step.
-                    if (isIntegerConstNum(step) || isIntType(buf, step_id)) {
-                        backIsIV = true;
-                    }
-                }
-            }
+                !preValueIsInt(buf, pre, 0)) continue;
 
-            if (backIsIV) {
+            // Back-edge must step the PHI by integers: ADD or SUB of
+            // (phi, const/int) or (const/int, phi), possibly chained.
+            if (stepsFromPhi(buf, back, i, 0)) {
                 phi->type = IR_TYPE_INT;
+                if (!isIntegerConstNum(preNode)) convertPreValue(buf, pre);
                 changed = true;
             }
         }
@@ -175,19 +227,6 @@ void irOptIVTypeInference(IRBuffer* buf)
         }
     }
 
-    // --- Step 4b: backward — UNBOX_NUM that feeds op1 of INT PHI → UNBOX_INT ---
-    for (uint16_t i = 0; i < buf->count; i++) {
-        const IRNode* phi = &buf->nodes[i];
-        if (phi->flags & IR_FLAG_DEAD) continue;
-        if (phi->op != IR_PHI || phi->type != IR_TYPE_INT) continue;
-        if (phi->op1 == IR_NONE || phi->op1 >= buf->count) continue;
-        IRNode* preVal = &buf->nodes[phi->op1];
-        if (!(preVal->flags & IR_FLAG_DEAD) && preVal->op == IR_UNBOX_NUM) {
-            preVal->op   = IR_UNBOX_INT;
-            preVal->type = IR_TYPE_INT;
-        }
-    }
-
     // --- Step 5: mark comparisons on INT operands ---
     // Also promote integer-valued CONST_NUM operands to CONST_INT, same as
     // step 3 does for arithmetic, so the codegen uses the integer compare path.
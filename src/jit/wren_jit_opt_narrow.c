@@ -0,0 +1,100 @@
+// ===========================================================================
+// Pass 13: Speculative Integer Narrowing
+//
+// IV type inference finds integers only in loop counters. Other numbers
+// that were integers when the trace was recorded (an index computed as
+// i * w + j, a counter kept in a field, an element loaded from a list) have
+// IR_FLAG_INTEGRAL on their UNBOX_NUM. This pass turns those that meet
+// integer arithmetic into UNBOX_INT, so IV type inference carries the
+// arithmetic in GP registers; where one meets a fractional value the code
+// generator converts it back to a double.
+//
+// The speculation is checked: irOptRangeAnalysis makes each narrowed
+// UNBOX_INT exit unless the Value is an integer within +-2^53, and each
+// integer result it cannot bound exit when it leaves that range. A value is
+// only narrowed where such a check has a snapshot to exit to.
+// ===========================================================================
+
+#include "wren_jit_ir.h"
+#include "wren_jit_opt.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+// ---------------------------------------------------------------------------
+// Helpers
+// ---------------------------------------------------------------------------
+
+static bool isIntegralConst(const IRNode* n)
+{
+    if (n->op == IR_CONST_INT) return true;
+    if (n->op != IR_CONST_NUM) return false;
+    double v = n->imm.num;
+    return (v == (double)(int64_t)v) &&
+           (v >= -((double)(1LL << 52))) &&
+           (v <=  ((double)(1LL << 52)));
+}
+
+static bool isCandidate(const IRNode* n)
+{
+    return n->op == IR_UNBOX_NUM && (n->flags & IR_FLAG_INTEGRAL) &&
+           !(n->flags & IR_FLAG_DEAD);
+}
+
+static bool isIntArith(IROp op)
+{
+    return op == IR_ADD || op == IR_SUB || op == IR_MUL;
+}
+
+static bool isCompare(IROp op)
+{
+    return op == IR_LT || op == IR_GT || op == IR_LTE || op == IR_GTE ||
+           op == IR_EQ || op == IR_NEQ;
+}
+
+// ---------------------------------------------------------------------------
+// Public entry point
+// ---------------------------------------------------------------------------
+void irOptNarrowNumbers(IRBuffer* buf)
+{
+    if (!buf || buf->count == 0) return;
+
+    // intish[id]: an integer now, or one once the candidates are narrowed.
+    // Operands precede their users outside PHIs, so one forward scan sees
+    // every chain (i * w + j).
+    static bool intish[IR_MAX_NODES];
+    static bool wanted[IR_MAX_NODES];
+
+    for (uint16_t i = 0; i < buf->count; i++) {
+        const IRNode* n = &buf->nodes[i];
+        wanted[i] = false;
+        intish[i] = false;
+        if (n->flags & IR_FLAG_DEAD) continue;
+        if (n->type == IR_TYPE_INT || isIntegralConst(n) || isCandidate(n)) {
+            intish[i] = true;
+        } else if (isIntArith(n->op) && n->op1 < i && n->op2 < i) {
+            intish[i] = intish[n->op1] && intish[n->op2];
+        }
+    }
+
+    // A candidate is worth narrowing when integer arithmetic or an integer
+    // comparison uses it; elsewhere it would only be converted back.
+    for (uint16_t i = 0; i < buf->count; i++) {
+        const IRNode* n = &buf->nodes[i];
+        if (n->flags & IR_FLAG_DEAD) continue;
+        if (!isIntArith(n->op) && !isCompare(n->op)) continue;
+        if (n->op1 >= i || n->op2 >= i) continue;
+        if (intish[n->op1] && intish[n->op2]) {
+            wanted[n->op1] = true;
+            wanted[n->op2] = true;
+        }
+    }
+
+    for (uint16_t i = 0; i < buf->count; i++) {
+        IRNode* n = &buf->nodes[i];
+        if (!isCandidate(n) || !wanted[i]) continue;
+        uint16_t snap = irOptCheckSnapshot(buf, i);
+        if (snap == IR_NONE || snap >= buf->snapshot_count) continue;
+        n->op   = IR_UNBOX_INT;
+        n->type = IR_TYPE_INT;
+    }
+}
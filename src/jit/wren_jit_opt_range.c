@@ -0,0 +1,340 @@
+// ===========================================================================
+// Pass 17: Integer Range Analysis
+//
+// IV type inference runs integer arithmetic in int64, but Wren numbers are
+// doubles: an integer result is the value the interpreter would compute
+// only while it stays within +-2^53, and an IR_FLAG_INTEGRAL UNBOX_INT
+// only matches the Value it converts if that held an integer. This pass
+// bounds every INT value with a conservative [lo, hi] interval and marks
+// the arithmetic and conversions it cannot prove exact IR_FLAG_CHECKED, so
+// the code generator tests those results and exits to imm.snapshot_id when
+// they leave the exact range. Counters bounded by the loop condition need
+// no check.
+//
+// Intervals come from:
+//   - constants
+//   - LOAD_RAW widths (4-byte counts are zero-extended) and LIST_NUM_END
+//   - interval arithmetic over ADD / SUB / MUL
+//   - integer comparisons asserted by GUARD_TRUE, for the nodes after it
+//   - induction variables: a PHI stepped by a constant starts at its
+//     pre-loop value and is bounded on the other side by a loop guard
+//     GUARD_TRUE(phi + k < lim) whose lim is computed before the loop
+//   - a checked value, which is within +-2^53 once its check has passed
+//
+// A check resumes at the nearest earlier snapshot of the same iteration,
+// provided nothing in between has a visible side effect; before the first
+// one that is the loop entry snapshot, as for hoisted guards. A value with
+// no such snapshot is left unchecked.
+// ===========================================================================
+
+#include "wren_jit_ir.h"
+#include "wren_jit_opt.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+// Every integer up to this magnitude is exactly representable as a double.
+#define EXACT_LIMIT ((int64_t)1 << 53)
+
+typedef struct {
+    int64_t lo;
+    int64_t hi;
+} IntRange;
+
+static const IntRange fullRange  = { INT64_MIN, INT64_MAX };
+static const IntRange exactRange = { -EXACT_LIMIT, EXACT_LIMIT };
+
+// ---------------------------------------------------------------------------
+// Saturating interval arithmetic
+// ---------------------------------------------------------------------------
+
+static int64_t satAdd(int64_t a, int64_t b)
+{
+    if (b > 0 && a > INT64_MAX - b) return INT64_MAX;
+    if (b < 0 && a < INT64_MIN - b) return INT64_MIN;
+    return a + b;
+}
+
+static int64_t satSub(int64_t a, int64_t b)
+{
+    return satAdd(a, b == INT64_MIN ? INT64_MAX : -b);
+}
+
+static int64_t satMul(int64_t a, int64_t b)
+{
+    // The double product is close enough to tell whether the exact one fits.
+    double p = (double)a * (double)b;
+    if (p >= 9.2e18) return INT64_MAX;
+    if (p <= -9.2e18) return INT64_MIN;
+    return a * b;
+}
+
+static int64_t min64(int64_t a, int64_t b) { return a < b ? a : b; }
+static int64_t max64(int64_t a, int64_t b) { return a > b ? a : b; }
+
+static bool isExact(IntRange r)
+{
+    return r.lo >= -EXACT_LIMIT && r.hi <= EXACT_LIMIT;
+}
+
+static IntRange arithRange(IROp op, IntRange a, IntRange b)
+{
+    IntRange r;
+    switch (op) {
+        case IR_ADD:
+            r.lo = satAdd(a.lo, b.lo);
+            r.hi = satAdd(a.hi, b.hi);
+            return r;
+        case IR_SUB:
+            r.lo = satSub(a.lo, b.hi);
+            r.hi = satSub(a.hi, b.lo);
+            return r;
+        case IR_MUL: {
+            int64_t p1 = satMul(a.lo, b.lo), p2 = satMul(a.lo, b.hi);
+            int64_t p3 = satMul(a.hi, b.lo), p4 = satMul(a.hi, b.hi);
+            r.lo = min64(min64(p1, p2), min64(p3, p4));
+            r.hi = max64(max64(p1, p2), max64(p3, p4));
+            return r;
+        }
+        default:
+            return fullRange;
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Induction variables
+// ---------------------------------------------------------------------------
+
+// True if [id] is the PHI [phi] plus a constant, returned in [k]: the
+// variable itself, or ADD / SUB chains of it with CONST_INT.
+static bool offsetFromPhi(const IRBuffer* buf, uint16_t id, uint16_t phi,
+                          int64_t* k)
+{
+    int64_t sum = 0;
+    for (int depth = 0; depth < 16; depth++) {
+        if (id == phi) { *k = sum; return true; }
+        if (id >= buf->count) return false;
+        const IRNode* n = &buf->nodes[id];
+        if (n->type != IR_TYPE_INT) return false;
+        if (n->op != IR_ADD && n->op != IR_SUB) return false;
+        if (n->op1 >= buf->count || n->op2 >= buf->count) return false;
+
+        const IRNode* b = &buf->nodes[n->op2];
+        const IRNode* a = &buf->nodes[n->op1];
+        int64_t c;
+        if (b->op == IR_CONST_INT) {
+            c = n->op == IR_SUB ? -b->imm.i64 : b->imm.i64;
+            id = n->op1;
+        } else if (a->op == IR_CONST_INT && n->op == IR_ADD) {
+            c = a->imm.i64;
+            id = n->op2;
+        } else {
+            return false;
+        }
+        if (c > EXACT_LIMIT || c < -EXACT_LIMIT) return false;
+        sum += c;
+    }
+    return false;
+}
+
+// If [guard] asserts an integer comparison, normalize it to lhs < rhs
+// ([strict] = 1) or lhs <= rhs ([strict] = 0).
+static bool guardedOrder(const IRBuffer* buf, const IRNode* guard,
+                         uint16_t* lhs, uint16_t* rhs, int64_t* strict)
+{
+    uint16_t c = guard->op1;
+    if (c < buf->count && buf->nodes[c].op == IR_BOX_BOOL)
+        c = buf->nodes[c].op1;
+    if (c >= buf->count) return false;
+    const IRNode* cmp = &buf->nodes[c];
+    if (cmp->type != IR_TYPE_INT) return false;
+    if (cmp->op1 >= buf->count || cmp->op2 >= buf->count) return false;
+
+    switch (cmp->op) {
+        case IR_LT:  *lhs = cmp->op1; *rhs = cmp->op2; *strict = 1; return true;
+        case IR_LTE: *lhs = cmp->op1; *rhs = cmp->op2; *strict = 0; return true;
+        case IR_GT:  *lhs = cmp->op2; *rhs = cmp->op1; *strict = 1; return true;
+        case IR_GTE: *lhs = cmp->op2; *rhs = cmp->op1; *strict = 0; return true;
+        default:     return false;
+    }
+}
+
+// The interval of a PHI stepped by a constant, from its start value and
+// the loop guards that stop it.
+static IntRange phiRange(const IRBuffer* buf, const IntRange* ranges,
+                         uint16_t p, uint16_t header)
+{
+    const IRNode* phi = &buf->nodes[p];
+    int64_t step;
+    if (phi->op1 >= p || phi->op2 >= buf->count) return fullRange;
+    if (!offsetFromPhi(buf, phi->op2, p, &step) || step == 0)
+        return fullRange;
+
+    IntRange start = ranges[phi->op1];
+    int64_t bound = step > 0 ? INT64_MAX : INT64_MIN;
+
+    for (uint16_t g = header + 1; g < buf->count; g++) {
+        const IRNode* guard = &buf->nodes[g];
+        if ((guard->flags & IR_FLAG_DEAD) || guard->op != IR_GUARD_TRUE)
+            continue;
+        uint16_t lhs, rhs;
+        int64_t strict;
+        if (!guardedOrder(buf, guard, &lhs, &rhs, &strict)) continue;
+
+        // The limit must be computed before the PHI, so it is invariant
+        // and its interval is known.
+        int64_t k;
+        if (step > 0 && rhs < p && buf->nodes[rhs].op != IR_PHI &&
+            offsetFromPhi(buf, lhs, p, &k)) {
+            // phi + k <= lim - strict, so the next value is at most
+            // lim - strict - k + step.
+            int64_t next = satAdd(satSub(satSub(ranges[rhs].hi, strict), k),
+                                  step);
+            bound = min64(bound, next);
+        } else if (step < 0 && lhs < p && buf->nodes[lhs].op != IR_PHI &&
+                   offsetFromPhi(buf, rhs, p, &k)) {
+            int64_t next = satAdd(satSub(satAdd(ranges[lhs].lo, strict), k),
+                                  step);
+            bound = max64(bound, next);
+        }
+    }
+
+    IntRange r;
+    if (step > 0) {
+        r.lo = start.lo;
+        r.hi = max64(start.hi, bound);
+    } else {
+        r.lo = min64(start.lo, bound);
+        r.hi = start.hi;
+    }
+    return r;
+}
+
+// ---------------------------------------------------------------------------
+// Checks
+// ---------------------------------------------------------------------------
+
+uint16_t irOptCheckSnapshot(const IRBuffer* buf, uint16_t id)
+{
+    for (uint16_t j = id; j-- > 0;) {
+        const IRNode* n = &buf->nodes[j];
+        if (n->flags & IR_FLAG_DEAD) continue;
+        switch (n->op) {
+            case IR_SNAPSHOT:
+                return n->imm.snapshot_id;
+            case IR_LOOP_HEADER:
+            case IR_STORE_STACK:
+            case IR_STORE_FIELD:
+            case IR_STORE_RAW:
+            case IR_STORE_MODULE_VAR:
+            case IR_CALL_C:
+            case IR_CALL_WREN:
+            case IR_NEW_INSTANCE:
+            case IR_STRING_APPEND:
+            case IR_RANDOM:
+                return IR_NONE;
+            default:
+                break;
+        }
+    }
+    return buf->entry_snapshot;
+}
+
+// Check [n] if a snapshot can take its exit. Returns whether it is checked.
+static bool addCheck(IRBuffer* buf, IRNode* n)
+{
+    uint16_t snap = irOptCheckSnapshot(buf, n->id);
+    if (snap == IR_NONE || snap >= buf->snapshot_count) return false;
+    n->flags |= IR_FLAG_CHECKED;
+    n->imm.snapshot_id = snap;
+    return true;
+}
+
+// ---------------------------------------------------------------------------
+// Public entry point
+// ---------------------------------------------------------------------------
+void irOptRangeAnalysis(IRBuffer* buf)
+{
+    if (!buf || buf->count == 0) return;
+
+    uint16_t header = buf->loop_header;
+    if (header >= buf->count || buf->nodes[header].op != IR_LOOP_HEADER)
+        return;
+
+    static IntRange ranges[IR_MAX_NODES];
+
+    for (uint16_t i = 0; i < buf->count; i++) {
+        IRNode* n = &buf->nodes[i];
+        ranges[i] = fullRange;
+        if (n->flags & IR_FLAG_DEAD) continue;
+
+        // The trace is straight-line code: everything after a guard runs
+        // only once it has passed, so its comparison narrows both sides
+        // for the nodes that follow.
+        uint16_t lhs, rhs;
+        int64_t strict;
+        if (n->op == IR_GUARD_TRUE &&
+            guardedOrder(buf, n, &lhs, &rhs, &strict) &&
+            lhs < i && rhs < i) {
+            ranges[lhs].hi = min64(ranges[lhs].hi,
+                                   satSub(ranges[rhs].hi, strict));
+            ranges[rhs].lo = max64(ranges[rhs].lo,
+                                   satAdd(ranges[lhs].lo, strict));
+            continue;
+        }
+        if (n->type != IR_TYPE_INT) continue;
+
+        switch (n->op) {
+            case IR_CONST_INT:
+                ranges[i].lo = ranges[i].hi = n->imm.i64;
+                break;
+
+            case IR_LOAD_RAW:
+                if (n->imm.raw.size == 1) {
+                    ranges[i].lo = 0;
+                    ranges[i].hi = UINT8_MAX;
+                } else if (n->imm.raw.size == 4) {
+                    ranges[i].lo = 0;
+                    ranges[i].hi = UINT32_MAX;
+                }
+                break;
+
+            case IR_LIST_NUM_END:
+                // An index at or after max(from, 0), at most the count.
+                if (n->op2 < i) {
+                    ranges[i].lo = max64(ranges[n->op2].lo, 0);
+                    ranges[i].hi = max64(ranges[n->op2].hi, INT32_MAX);
+                }
+                break;
+
+            case IR_PHI:
+                if (i < header) ranges[i] = phiRange(buf, ranges, i, header);
+                break;
+
+            case IR_ADD:
+            case IR_SUB:
+            case IR_MUL: {
+                if (n->op1 >= i || n->op2 >= i) break;
+                IntRange a = buf->nodes[n->op1].type == IR_TYPE_INT
+                           ? ranges[n->op1] : fullRange;
+                IntRange b = buf->nodes[n->op2].type == IR_TYPE_INT
+                           ? ranges[n->op2] : fullRange;
+                ranges[i] = arithRange(n->op, a, b);
+                if (!isExact(ranges[i]) &&
+                    ((n->flags & IR_FLAG_CHECKED) || addCheck(buf, n)))
+                    ranges[i] = exactRange;
+                break;
+            }
+
+            case IR_UNBOX_INT:
+                // One standing for the number itself must be an integer;
+                // the others truncate on purpose (floor, isInteger).
+                if (!(n->flags & IR_FLAG_INTEGRAL)) break;
+                if ((n->flags & IR_FLAG_CHECKED) || addCheck(buf, n))
+                    ranges[i] = exactRange;
+                break;
+
+            default:
+                break;
+        }
+    }
+}
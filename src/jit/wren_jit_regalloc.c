@@ -166,6 +166,7 @@ void regAllocComputeRanges(RegAllocState* state, const IRBuffer* buf)
         // Skip nodes that don't produce a usable value.
         if (n->op == IR_NOP || n->op == IR_STORE_STACK ||
             n->op == IR_STORE_FIELD || n->op == IR_STORE_MODULE_VAR ||
+            n->op == IR_STORE_RAW ||
             n->op == IR_LOOP_HEADER || n->op == IR_LOOP_BACK ||
             n->op == IR_SIDE_EXIT || n->op == IR_SNAPSHOT)
             continue;
@@ -210,6 +211,9 @@ void regAllocComputeRanges(RegAllocState* state, const IRBuffer* buf)
         } else if (n->op == IR_GUARD_NUM || n->op == IR_GUARD_TRUE ||
                    n->op == IR_GUARD_FALSE || n->op == IR_GUARD_NOT_NULL) {
             sid = n->imm.snapshot_id;
+        } else if (n->flags & IR_FLAG_CHECKED) {
+            // Checked INT arithmetic exits like a guard.
+            sid = n->imm.snapshot_id;
         }
         if (sid != IR_NONE && sid < buf->snapshot_count && i > last_exit_for_snap[sid])
             last_exit_for_snap[sid] = i;
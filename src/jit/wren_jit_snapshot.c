@@ -7,6 +7,7 @@ void jitSnapshotInit(JitSnapshot* snap, uint8_t* resume_pc, int stack_depth)
     snap->resume_pc = resume_pc;
     snap->stack_depth = stack_depth;
     snap->num_entries = 0;
+    snap->num_frames = 0;
 }
 
 bool jitSnapshotAddEntry(JitSnapshot* snap, uint16_t slot, uint16_t ssa_ref)
@@ -18,3 +19,15 @@ bool jitSnapshotAddEntry(JitSnapshot* snap, uint16_t slot, uint16_t ssa_ref)
     snap->num_entries++;
     return true;
 }
+
+bool jitSnapshotAddFrame(JitSnapshot* snap, void* closure, uint8_t* return_pc,
+                         uint16_t base)
+{
+    if (snap->num_frames >= JIT_MAX_SNAPSHOT_FRAMES) return false;
+
+    JitSnapshotFrame* f = &snap->frames[snap->num_frames++];
+    f->closure = closure;
+    f->return_pc = return_pc;
+    f->base = base;
+    return true;
+}
@@ -12,6 +12,15 @@ typedef struct {
 } JitSnapshotEntry;
 
 #define JIT_MAX_SNAPSHOT_ENTRIES 64
+#define JIT_MAX_SNAPSHOT_FRAMES 8
+
+// An inlined method frame the interpreter must re-enter at a side exit
+typedef struct {
+    void* closure;          // ObjClosure* of the method
+    uint8_t* return_pc;     // where its caller resumes after the call
+    uint16_t base;          // stack slot of the receiver, relative to the
+                            // trace's stackStart
+} JitSnapshotFrame;
 
 // A deoptimization snapshot
 typedef struct JitSnapshot {
@@ -19,6 +28,8 @@ typedef struct JitSnapshot {
     int stack_depth;                 // how deep the stack is
     JitSnapshotEntry entries[JIT_MAX_SNAPSHOT_ENTRIES];
     uint16_t num_entries;
+    JitSnapshotFrame frames[JIT_MAX_SNAPSHOT_FRAMES];  // outermost first
+    uint8_t num_frames;
 } JitSnapshot;
 
 // Initialize a snapshot
@@ -27,4 +38,9 @@ void jitSnapshotInit(JitSnapshot* snap, uint8_t* resume_pc, int stack_depth);
 // Add an entry to a snapshot. Returns false if full.
 bool jitSnapshotAddEntry(JitSnapshot* snap, uint16_t slot, uint16_t ssa_ref);
 
+// Append an inlined frame (callers add outermost first). Returns false if
+// full.
+bool jitSnapshotAddFrame(JitSnapshot* snap, void* closure, uint8_t* return_pc,
+                         uint16_t base);
+
 #endif
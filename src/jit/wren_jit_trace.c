@@ -6,6 +6,8 @@
 #include "wren_vm.h"
 #include "wren_value.h"
 
+#include <math.h>
+#include <stddef.h>
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
@@ -49,6 +51,88 @@ static uint16_t emitSnapshot(JitRecorder* r, uint8_t* resume_pc)
     return snap_id;
 }
 
+// Emit a constant node for a Value known at record time. Objects are boxed
+// so the slot holds a proper Value if a snapshot writes it back.
+static uint16_t emitValueConst(JitRecorder* r, Value v)
+{
+    if (IS_NUM(v)) return irEmitConst(&r->ir, AS_NUM(v));
+    if (IS_NULL(v)) return irEmitConstNull(&r->ir);
+    if (IS_BOOL(v)) return irEmitConstBool(&r->ir, AS_BOOL(v));
+    uint16_t obj = irEmitConstObj(&r->ir, AS_OBJ(v));
+    return irEmit(&r->ir, IR_BOX_OBJ, obj, IR_NONE, IR_TYPE_VALUE);
+}
+
+// Unbox a number, noting whether it was an integer when recorded so that
+// irOptNarrowNumbers may keep it in an integer register. -0.0 is not one: it
+// would come back from int64 as +0.
+static uint16_t unboxNum(JitRecorder* r, uint16_t value, Value recorded)
+{
+    uint16_t id = irEmitUnbox(&r->ir, value);
+    double d = AS_NUM(recorded);
+    if (d >= -9007199254740992.0 && d <= 9007199254740992.0 &&
+        d == (double)(int64_t)d && !(d == 0 && signbit(d))) {
+        r->ir.nodes[id].flags |= IR_FLAG_INTEGRAL;
+    }
+    return id;
+}
+
+// The ObjInstance* inside a boxed instance Value, for field access.
+static uint16_t instancePtr(JitRecorder* r, uint16_t value)
+{
+    return irEmit(&r->ir, IR_UNBOX_OBJ, value, IR_NONE, IR_TYPE_PTR);
+}
+
+// The address of the upvalue cell holding upvalue [index] of the function
+// being recorded, as a PTR to its Value. An inlined frame's closure is fixed
+// by the guard that entered it; the anchor frame must be a function, whose
+// closure sits in local 0. Aborts and returns IR_NONE when neither holds, or
+// when the upvalue is still open on a slot the trace itself keeps in SSA
+// form, where the two views of the variable would drift apart.
+static uint16_t upvalueCell(WrenJitState* jit, JitRecorder* r,
+                            ObjClosure* closure, Value* stackStart, int index)
+{
+    ObjUpvalue* upvalue = closure->upvalues[index];
+    if (upvalue->value >= stackStart &&
+        upvalue->value < stackStart + JIT_TRACE_MAX_SLOTS) {
+        jitRecorderAbort(jit, "upvalue open on a trace slot");
+        return IR_NONE;
+    }
+
+    uint16_t closure_ptr;
+    if (r->ir.cur_frame != IR_NONE) {
+        closure_ptr = irEmitConstObj(&r->ir, closure);
+    } else if (stackStart[r->base] == OBJ_VAL(closure)) {
+        uint16_t fn = slotGet(r, r->base);
+        if (fn == IR_NONE) {
+            fn = irEmitLoad(&r->ir, (uint16_t)r->base);
+            slotSet(r, r->base, fn);
+        }
+        closure_ptr = instancePtr(r, fn);
+    } else {
+        jitRecorderAbort(jit, "upvalue of a method");
+        return IR_NONE;
+    }
+
+    uint16_t upvalue_ptr = irEmitLoadRaw(
+        &r->ir, closure_ptr,
+        (int32_t)(offsetof(ObjClosure, upvalues) +
+                  (size_t)index * sizeof(ObjUpvalue*)),
+        sizeof(ObjUpvalue*), IR_TYPE_PTR, true);
+    // The cell moves into the upvalue itself when the variable is closed.
+    return irEmitLoadRaw(&r->ir, upvalue_ptr,
+                         (int32_t)offsetof(ObjUpvalue, value),
+                         sizeof(Value*), IR_TYPE_PTR, false);
+}
+
+static bool modVarListHas(const JitModVarRef* list, int count,
+                          void* module, uint16_t index)
+{
+    for (int i = 0; i < count; i++) {
+        if (list[i].module == module && list[i].index == index) return true;
+    }
+    return false;
+}
+
 // Check if a method symbol name matches a given C string.
 // Uses the VM's global methodNames symbol table.
 static bool methodNameEquals(WrenVM* vm, int symbol, const char* name)
@@ -138,6 +222,10 @@ void jitRecorderStart(WrenJitState* jit, uint8_t* anchor_pc, int num_slots)
         slotSet(r, s, ssa);
     }
 
+    // Guards hoisted out of the loop exit through this snapshot: it resumes
+    // the iteration from the top, before any of the body has run.
+    r->ir.entry_snapshot = emitSnapshot(r, anchor_pc);
+
     // Mark JIT state as recording.
     jit->state = JIT_STATE_RECORDING;
     jit->anchor_pc = anchor_pc;
@@ -157,6 +245,7 @@ void jitRecorderAbort(WrenJitState* jit, const char* reason)
     r->aborted = true;
     r->abort_reason = reason;
 
+    wrenJitHotBackoff(jit, r->anchor_pc);
     jit->state = JIT_STATE_IDLE;
     jit->traces_aborted++;
 }
@@ -184,6 +273,12 @@ bool jitRecorderStep(WrenJitState* jit, WrenVM* vm, uint8_t* ip)
     JitRecorder* r = (JitRecorder*)jit->recorder;
     if (r->aborted) return false;
 
+    // The body of an inlined accessor is already in the trace.
+    if (r->skip_until != NULL) {
+        if (ip != r->skip_until) return false;
+        r->skip_until = NULL;
+    }
+
     // Abort if we've recorded too many instructions.
     r->instr_count++;
     if (r->instr_count > JIT_TRACE_MAX_INSNS) {
@@ -191,10 +286,13 @@ bool jitRecorderStep(WrenJitState* jit, WrenVM* vm, uint8_t* ip)
         return false;
     }
 
-    // Current fiber and frame for inspecting runtime state.
+    // Current fiber and frame for inspecting runtime state. Slots are
+    // numbered from the anchor frame, which sits r->base slots below the
+    // frame of an inlined method.
     ObjFiber* fiber = vm->fiber;
     CallFrame* frame = &fiber->frames[fiber->numFrames - 1];
-    Value* stackStart = frame->stackStart;
+    Value* stackStart = frame->stackStart - r->base;
+    if (r->module == NULL) r->module = frame->closure->fn->module;
 
     Code opcode = (Code)(*ip);
 
@@ -213,7 +311,7 @@ bool jitRecorderStep(WrenJitState* jit, WrenVM* vm, uint8_t* ip)
     case CODE_LOAD_LOCAL_6:
     case CODE_LOAD_LOCAL_7:
     case CODE_LOAD_LOCAL_8: {
-        int src_slot = (int)(opcode - CODE_LOAD_LOCAL_0);
+        int src_slot = r->base + (int)(opcode - CODE_LOAD_LOCAL_0);
         uint16_t ssa = slotGet(r, src_slot);
         if (ssa == IR_NONE) {
             ssa = irEmitLoad(&r->ir, (uint16_t)src_slot);
@@ -229,7 +327,7 @@ bool jitRecorderStep(WrenJitState* jit, WrenVM* vm, uint8_t* ip)
     // LOAD_LOCAL (with 1-byte arg)
     // -----------------------------------------------------------------
     case CODE_LOAD_LOCAL: {
-        int src_slot = ip[1];
+        int src_slot = r->base + ip[1];
         uint16_t ssa = slotGet(r, src_slot);
         if (ssa == IR_NONE) {
             ssa = irEmitLoad(&r->ir, (uint16_t)src_slot);
@@ -245,7 +343,7 @@ bool jitRecorderStep(WrenJitState* jit, WrenVM* vm, uint8_t* ip)
     // Store top-of-stack into a local slot. Does NOT pop.
     // -----------------------------------------------------------------
     case CODE_STORE_LOCAL: {
-        int dst_slot = ip[1];
+        int dst_slot = r->base + ip[1];
         if (r->stack_top <= 0) {
             jitRecorderAbort(jit, "stack underflow at STORE_LOCAL");
             return false;
@@ -266,16 +364,17 @@ bool jitRecorderStep(WrenJitState* jit, WrenVM* vm, uint8_t* ip)
 
     // -----------------------------------------------------------------
     // LOAD_FIELD_THIS (with 1-byte field index)
-    // Pushes the value of field [arg] of the receiver (slot 0).
+    // Pushes the value of field [arg] of the receiver (local 0).
     // -----------------------------------------------------------------
     case CODE_LOAD_FIELD_THIS: {
         int field_idx = ip[1];
-        uint16_t receiver = slotGet(r, 0);
+        uint16_t receiver = slotGet(r, r->base);
         if (receiver == IR_NONE) {
-            receiver = irEmitLoad(&r->ir, 0);
-            slotSet(r, 0, receiver);
+            receiver = irEmitLoad(&r->ir, (uint16_t)r->base);
+            slotSet(r, r->base, receiver);
         }
-        uint16_t ssa = irEmitLoadField(&r->ir, receiver, (uint16_t)field_idx);
+        uint16_t ssa = irEmitLoadField(&r->ir, instancePtr(r, receiver),
+                                       (uint16_t)field_idx);
         slotSet(r, r->stack_top, ssa);
         r->stack_top++;
         break;
@@ -283,14 +382,14 @@ bool jitRecorderStep(WrenJitState* jit, WrenVM* vm, uint8_t* ip)
 
     // -----------------------------------------------------------------
     // STORE_FIELD_THIS (with 1-byte field index)
-    // Stores TOS into field [arg] of receiver (slot 0). Does NOT pop.
+    // Stores TOS into field [arg] of receiver (local 0). Does NOT pop.
     // -----------------------------------------------------------------
     case CODE_STORE_FIELD_THIS: {
         int field_idx = ip[1];
-        uint16_t receiver = slotGet(r, 0);
+        uint16_t receiver = slotGet(r, r->base);
         if (receiver == IR_NONE) {
-            receiver = irEmitLoad(&r->ir, 0);
-            slotSet(r, 0, receiver);
+            receiver = irEmitLoad(&r->ir, (uint16_t)r->base);
+            slotSet(r, r->base, receiver);
         }
         if (r->stack_top <= 0) {
             jitRecorderAbort(jit, "stack underflow at STORE_FIELD_THIS");
@@ -301,7 +400,8 @@ bool jitRecorderStep(WrenJitState* jit, WrenVM* vm, uint8_t* ip)
             jitRecorderAbort(jit, "untracked value at STORE_FIELD_THIS");
             return false;
         }
-        irEmitStoreField(&r->ir, receiver, (uint16_t)field_idx, val);
+        irEmitStoreField(&r->ir, instancePtr(r, receiver),
+                         (uint16_t)field_idx, val);
         break;
     }
 
@@ -315,18 +415,7 @@ bool jitRecorderStep(WrenJitState* jit, WrenVM* vm, uint8_t* ip)
             jitRecorderAbort(jit, "constant index out of range");
             return false;
         }
-        Value constant = fn->constants.data[const_idx];
-        uint16_t ssa;
-        if (IS_NUM(constant)) {
-            ssa = irEmitConst(&r->ir, AS_NUM(constant));
-        } else if (IS_NULL(constant)) {
-            ssa = irEmitConstNull(&r->ir);
-        } else if (IS_BOOL(constant)) {
-            ssa = irEmitConstBool(&r->ir, AS_BOOL(constant));
-        } else {
-            // Object constant -- store the pointer.
-            ssa = irEmitConstObj(&r->ir, AS_OBJ(constant));
-        }
+        uint16_t ssa = emitValueConst(r, fn->constants.data[const_idx]);
         slotSet(r, r->stack_top, ssa);
         r->stack_top++;
         break;
@@ -386,6 +475,7 @@ bool jitRecorderStep(WrenJitState* jit, WrenVM* vm, uint8_t* ip)
         if (IS_NUM(recv_val)) {
             IROp uop = numUnaryToIROp(vm, symbol);
             if (uop == IR_NOP) {
+                if (jitTryWidenCall0(jit, vm, stackStart, symbol, ip)) break;
                 jitRecorderAbort(jit, "unsupported Num unary method");
                 return false;
             }
@@ -401,7 +491,7 @@ bool jitRecorderStep(WrenJitState* jit, WrenVM* vm, uint8_t* ip)
             irEmitGuardNum(&r->ir, recv_ssa, snap);
 
             // Unbox, operate, box.
-            uint16_t unboxed = irEmitUnbox(&r->ir, recv_ssa);
+            uint16_t unboxed = unboxNum(r, recv_ssa, recv_val);
             uint16_t result = irEmit(&r->ir, uop, unboxed, IR_NONE, IR_TYPE_NUM);
             uint16_t boxed = irEmitBox(&r->ir, result);
 
@@ -410,6 +500,8 @@ bool jitRecorderStep(WrenJitState* jit, WrenVM* vm, uint8_t* ip)
             // stack_top stays the same.
         } else {
             if (jitTryWidenCall0(jit, vm, stackStart, symbol, ip)) break;
+            if (jitTryInlineAccessor(jit, vm, stackStart, symbol, 0, ip)) break;
+            if (jitTryInlineMethod(jit, vm, stackStart, symbol, 0, ip)) break;
             jitRecorderAbort(jit, "unsupported CALL_0 receiver type");
             return false;
         }
@@ -433,6 +525,7 @@ bool jitRecorderStep(WrenJitState* jit, WrenVM* vm, uint8_t* ip)
         if (IS_NUM(recv_val)) {
             IROp binop = numMethodToIROp(vm, symbol);
             if (binop == IR_NOP) {
+                if (jitTryWidenCall1(jit, vm, stackStart, symbol, ip)) break;
                 jitRecorderAbort(jit, "unsupported Num binary method");
                 return false;
             }
@@ -454,8 +547,8 @@ bool jitRecorderStep(WrenJitState* jit, WrenVM* vm, uint8_t* ip)
             irEmitGuardNum(&r->ir, arg_ssa, snap);
 
             // Unbox both.
-            uint16_t left = irEmitUnbox(&r->ir, recv_ssa);
-            uint16_t right = irEmitUnbox(&r->ir, arg_ssa);
+            uint16_t left = unboxNum(r, recv_ssa, recv_val);
+            uint16_t right = unboxNum(r, arg_ssa, stackStart[arg_slot]);
 
             // Emit the operation.
             IRType result_type = isComparisonOp(binop) ? IR_TYPE_BOOL : IR_TYPE_NUM;
@@ -479,6 +572,8 @@ bool jitRecorderStep(WrenJitState* jit, WrenVM* vm, uint8_t* ip)
             slotSet(r, recv_slot, boxed);
         } else {
             if (jitTryWidenCall1(jit, vm, stackStart, symbol, ip)) break;
+            if (jitTryInlineAccessor(jit, vm, stackStart, symbol, 1, ip)) break;
+            if (jitTryInlineMethod(jit, vm, stackStart, symbol, 1, ip)) break;
             jitRecorderAbort(jit, "unsupported CALL_1 receiver type");
             return false;
         }
@@ -486,7 +581,7 @@ bool jitRecorderStep(WrenJitState* jit, WrenVM* vm, uint8_t* ip)
     }
 
     // -----------------------------------------------------------------
-    // CALL_2 .. CALL_16: abort for v0.1
+    // CALL_2 .. CALL_16: only Wren methods, which are inlined
     // -----------------------------------------------------------------
     case CODE_CALL_2:
     case CODE_CALL_3:
@@ -503,6 +598,14 @@ bool jitRecorderStep(WrenJitState* jit, WrenVM* vm, uint8_t* ip)
     case CODE_CALL_14:
     case CODE_CALL_15:
     case CODE_CALL_16: {
+        uint16_t symbol = readShort(ip);
+        int num_args = (int)(opcode - CODE_CALL_0);
+        if (r->stack_top < num_args + 1) {
+            jitRecorderAbort(jit, "stack underflow at CALL_N");
+            return false;
+        }
+        if (jitTryInlineMethod(jit, vm, stackStart, symbol, num_args, ip))
+            break;
         jitRecorderAbort(jit, "unsupported CALL_N with N >= 2");
         return false;
     }
@@ -653,7 +756,7 @@ bool jitRecorderStep(WrenJitState* jit, WrenVM* vm, uint8_t* ip)
         // The loop target is ip + 3 - offset (3 bytes for opcode + 2-byte arg).
         uint8_t* target = ip + 3 - offset;
 
-        if (target == r->anchor_pc) {
+        if (target == r->anchor_pc && r->call_depth == 0) {
             // We've looped back to the anchor -- trace is complete!
             irEmitLoopBack(&r->ir);
             jit->state = JIT_STATE_COMPILING;
@@ -667,7 +770,10 @@ bool jitRecorderStep(WrenJitState* jit, WrenVM* vm, uint8_t* ip)
 
     // -----------------------------------------------------------------
     // LOAD_MODULE_VAR (2-byte arg)
-    // imm.ptr = absolute address of the variable in module->variables.data
+    // imm.intval = variable index. Traces address variables off the base the
+    // caller passes in, so the module's variable buffer may grow freely.
+    // A variable not seen reassigned (wrenJitModuleVarStable) is folded into
+    // a constant; wrenJitExecute leaves the trace if it has changed since.
     // -----------------------------------------------------------------
     case CODE_LOAD_MODULE_VAR: {
         uint16_t var_idx = readShort(ip);
@@ -676,10 +782,30 @@ bool jitRecorderStep(WrenJitState* jit, WrenVM* vm, uint8_t* ip)
             jitRecorderAbort(jit, "module var index out of range");
             return false;
         }
-        Value* varPtr = &fn2->module->variables.data[var_idx];
-        uint16_t ssa = irEmit(&r->ir, IR_LOAD_MODULE_VAR, var_idx, IR_NONE,
+        ObjModule* module = fn2->module;
+        if (r->num_modvar_deps < JIT_TRACE_MAX_MODVARS &&
+            !modVarListHas(r->modvar_stores, r->num_modvar_stores,
+                           module, var_idx) &&
+            wrenJitModuleVarStable(jit, module, var_idx)) {
+            if (!modVarListHas(r->modvar_deps, r->num_modvar_deps,
+                               module, var_idx)) {
+                JitModVarRef* dep = &r->modvar_deps[r->num_modvar_deps++];
+                dep->module = module;
+                dep->index = var_idx;
+                dep->value = module->variables.data[var_idx];
+            }
+            uint16_t ssa = emitValueConst(r, module->variables.data[var_idx]);
+            slotSet(r, r->stack_top, ssa);
+            r->stack_top++;
+            break;
+        }
+        if (module != r->module) {
+            jitRecorderAbort(jit, "module var of another module");
+            return false;
+        }
+        uint16_t ssa = irEmit(&r->ir, IR_LOAD_MODULE_VAR, IR_NONE, IR_NONE,
                               IR_TYPE_VALUE);
-        r->ir.nodes[ssa].imm.ptr = (void*)varPtr;
+        r->ir.nodes[ssa].imm.intval = var_idx;
         slotSet(r, r->stack_top, ssa);
         r->stack_top++;
         break;
@@ -687,7 +813,7 @@ bool jitRecorderStep(WrenJitState* jit, WrenVM* vm, uint8_t* ip)
 
     // -----------------------------------------------------------------
     // STORE_MODULE_VAR (2-byte arg)
-    // op1 = value SSA, imm.ptr = absolute address of the variable
+    // op1 = value SSA, imm.intval = variable index
     // -----------------------------------------------------------------
     case CODE_STORE_MODULE_VAR: {
         uint16_t var_idx = readShort(ip);
@@ -704,10 +830,30 @@ bool jitRecorderStep(WrenJitState* jit, WrenVM* vm, uint8_t* ip)
             jitRecorderAbort(jit, "module var index out of range");
             return false;
         }
-        Value* varPtr = &fn2->module->variables.data[var_idx];
+        if (fn2->module != r->module) {
+            jitRecorderAbort(jit, "module var of another module");
+            return false;
+        }
+        if (modVarListHas(r->modvar_deps, r->num_modvar_deps,
+                          fn2->module, var_idx)) {
+            // Load it the next time round, as in a top-level loop counter.
+            wrenJitModuleVarReassigned(jit, fn2->module, var_idx);
+            jitRecorderAbort(jit, "store to a module var folded earlier");
+            return false;
+        }
+        if (!modVarListHas(r->modvar_stores, r->num_modvar_stores,
+                           fn2->module, var_idx)) {
+            if (r->num_modvar_stores == JIT_TRACE_MAX_MODVARS) {
+                jitRecorderAbort(jit, "too many module var stores");
+                return false;
+            }
+            JitModVarRef* st = &r->modvar_stores[r->num_modvar_stores++];
+            st->module = fn2->module;
+            st->index = var_idx;
+        }
         uint16_t node = irEmit(&r->ir, IR_STORE_MODULE_VAR, val_ssa, IR_NONE,
                                IR_TYPE_VOID);
-        r->ir.nodes[node].imm.ptr = (void*)varPtr;
+        r->ir.nodes[node].imm.intval = var_idx;
         // Does not pop.
         break;
     }
@@ -716,17 +862,33 @@ bool jitRecorderStep(WrenJitState* jit, WrenVM* vm, uint8_t* ip)
     // LOAD_UPVALUE (1-byte arg)
     // -----------------------------------------------------------------
     case CODE_LOAD_UPVALUE: {
-        // Upvalues are tricky for the JIT. For v0.1, abort.
-        jitRecorderAbort(jit, "unsupported opcode: LOAD_UPVALUE");
-        return false;
+        uint16_t cell = upvalueCell(jit, r, frame->closure, stackStart, ip[1]);
+        if (cell == IR_NONE) return false;
+        uint16_t ssa = irEmitLoadRaw(&r->ir, cell, 0, sizeof(Value),
+                                     IR_TYPE_VALUE, false);
+        slotSet(r, r->stack_top, ssa);
+        r->stack_top++;
+        break;
     }
 
     // -----------------------------------------------------------------
     // STORE_UPVALUE (1-byte arg)
+    // Stores TOS into the upvalue. Does NOT pop.
     // -----------------------------------------------------------------
     case CODE_STORE_UPVALUE: {
-        jitRecorderAbort(jit, "unsupported opcode: STORE_UPVALUE");
-        return false;
+        if (r->stack_top <= 0) {
+            jitRecorderAbort(jit, "stack underflow at STORE_UPVALUE");
+            return false;
+        }
+        uint16_t val = slotGet(r, r->stack_top - 1);
+        if (val == IR_NONE) {
+            jitRecorderAbort(jit, "untracked value at STORE_UPVALUE");
+            return false;
+        }
+        uint16_t cell = upvalueCell(jit, r, frame->closure, stackStart, ip[1]);
+        if (cell == IR_NONE) return false;
+        irEmitStoreRaw(&r->ir, cell, 0, val);
+        break;
     }
 
     // -----------------------------------------------------------------
@@ -744,7 +906,8 @@ bool jitRecorderStep(WrenJitState* jit, WrenVM* vm, uint8_t* ip)
             obj_ssa = irEmitLoad(&r->ir, (uint16_t)obj_slot);
             slotSet(r, obj_slot, obj_ssa);
         }
-        uint16_t ssa = irEmitLoadField(&r->ir, obj_ssa, (uint16_t)field_idx);
+        uint16_t ssa = irEmitLoadField(&r->ir, instancePtr(r, obj_ssa),
+                                       (uint16_t)field_idx);
         // LOAD_FIELD has stack effect 0 (pops instance, pushes value).
         slotSet(r, obj_slot, ssa);
         break;
@@ -770,21 +933,56 @@ bool jitRecorderStep(WrenJitState* jit, WrenVM* vm, uint8_t* ip)
         if (val_ssa == IR_NONE) {
             val_ssa = irEmitLoad(&r->ir, (uint16_t)val_slot);
         }
-        irEmitStoreField(&r->ir, inst_ssa, (uint16_t)field_idx, val_ssa);
+        irEmitStoreField(&r->ir, instancePtr(r, inst_ssa),
+                         (uint16_t)field_idx, val_ssa);
         // Stack effect -1: pop the instance, value stays.
         r->stack_top--;
         r->slot_live[r->stack_top] = false;
         break;
     }
 
+    // -----------------------------------------------------------------
+    // CONSTRUCT
+    // Replaces the class in slot 0 of an inlined constructor with a new
+    // instance. The allocation exits back to this instruction when a GC is
+    // due, so the collector only ever runs from the interpreter.
+    // -----------------------------------------------------------------
+    case CODE_CONSTRUCT: {
+        if (r->ir.cur_frame == IR_NONE) {
+            jitRecorderAbort(jit, "CONSTRUCT outside an inlined constructor");
+            return false;
+        }
+        ObjClass* cls = AS_CLASS(stackStart[r->base]);
+        uint16_t snap = emitSnapshot(r, ip);
+        uint16_t inst = irEmitNewInstance(&r->ir,
+                                          irEmitConstObj(&r->ir, cls), snap);
+        slotSet(r, r->base, inst);
+        break;
+    }
+
     // -----------------------------------------------------------------
     // RETURN
     // -----------------------------------------------------------------
     case CODE_RETURN: {
         if (r->call_depth > 0) {
+            // Leaving an inlined method: like the interpreter, replace the
+            // receiver with the return value and drop the callee's slots.
+            if (r->stack_top <= r->base) {
+                jitRecorderAbort(jit, "stack underflow at RETURN");
+                return false;
+            }
+            uint16_t result = slotGet(r, r->stack_top - 1);
+            if (result == IR_NONE) {
+                result = irEmitLoad(&r->ir, (uint16_t)(r->stack_top - 1));
+            }
+            for (int s = r->base; s < r->stack_top; s++) r->slot_live[s] = false;
+            r->stack_top = r->base + 1;
+            slotSet(r, r->base, result);
+
+            irPopFrame(&r->ir);
+            uint16_t caller = r->ir.cur_frame;
+            r->base = caller == IR_NONE ? 0 : r->ir.frames[caller].base;
             r->call_depth--;
-            // The caller's frame will be restored by the interpreter.
-            // We don't emit IR for the return itself; just track call depth.
         } else {
             jitRecorderAbort(jit, "returning out of trace root");
             return false;
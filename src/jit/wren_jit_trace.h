@@ -17,6 +17,14 @@ typedef struct WrenJitState WrenJitState;
 #define JIT_TRACE_MAX_INSNS 1000
 #define JIT_TRACE_MAX_CALL_DEPTH 8
 #define JIT_TRACE_MAX_SLOTS 256
+#define JIT_TRACE_MAX_MODVARS 32
+
+// A module variable referenced by a trace.
+typedef struct {
+    void* module;            // ObjModule*
+    uint16_t index;
+    uint64_t value;          // value folded into the trace (deps only)
+} JitModVarRef;
 
 // Recorder state
 typedef struct {
@@ -33,6 +41,25 @@ typedef struct {
     // relative to stackStart, so slot indices 0..stack_top-1 are in use).
     int stack_top;
 
+    // Slot of local 0 in the method being recorded: 0 in the anchor's
+    // function, the receiver's slot inside an inlined method. All slot
+    // indices above are relative to the anchor frame's stackStart.
+    int base;
+
+    // Module of the anchor's function; traces address only its variables.
+    void* module;
+
+    // Caller ip to wait for while the interpreter runs the body of a call
+    // the recorder has already lowered (an inlined accessor), else NULL.
+    uint8_t* skip_until;
+
+    // Module variables folded into constants (the trace is invalid once one
+    // is written) and module variables the trace itself writes.
+    JitModVarRef modvar_deps[JIT_TRACE_MAX_MODVARS];
+    int num_modvar_deps;
+    JitModVarRef modvar_stores[JIT_TRACE_MAX_MODVARS];
+    int num_modvar_stores;
+
     int instr_count;
     int call_depth;
     bool aborted;
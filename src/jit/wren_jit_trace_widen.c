@@ -4,6 +4,19 @@
 // Currently supported:
 //   Range.iterate(_)       — inline the iteration step as integer arithmetic
 //   Range.iteratorValue(_) — trivial (return iterator as value)
+//   List.iterate(_)        — integer index step, guarded by the list's count
+//   List.iteratorValue(_)  — bounds-checked direct element load
+//   List[_]                — the same load, for integral indices
+//   Builtin accessors      — count, isEmpty, Range bounds, Num.isNan, ...
+//                            from a table (see widenGetters)
+//   !, ==, !=, is          — tag and bit compares on any receiver that
+//                            inherits Object's primitives
+//   String + String        — STRING_APPEND, grown in place for loop
+//                            accumulators
+//   Random.float(), int()  — IR_RANDOM, a direct call into the generator
+//   Getters and setters    — a field load or store on the receiver
+//   Methods written in Wren — followed into their bytecode behind a class
+//                            guard (e.g. a user Sequence's iterate(_))
 // =============================================================================
 
 #include "wren_jit_trace_widen.h"
@@ -14,7 +27,11 @@
 // Wren VM headers
 #include "wren_vm.h"
 #include "wren_value.h"
+#if WREN_OPT_RANDOM
+#include "wren_opt_random.h"
+#endif
 
+#include <stddef.h>
 #include <string.h>
 #include <stdbool.h>
 #include <stdio.h>
@@ -57,6 +74,59 @@ static uint16_t widenEmitSnapshot(JitRecorder* r, uint8_t* ip)
     return snap_id;
 }
 
+// Guard that the receiver's class is [cls]. An object constant keeps its
+// class, so it needs no guard: this is what makes a static call such as
+// `Util.hash(x)` on a class folded from a module variable dispatch straight
+// to the method (the receiver's class is then its metaclass). A trace that
+// folded a module variable is not entered once the variable is reassigned
+// (wrenJitExecute checks it), so it never runs with the old class; a
+// variable seen reassigned is loaded and guarded instead. Likewise an
+// instance the trace allocated itself, such as `this` in a constructor.
+static void widenGuardClass(JitRecorder* r, uint16_t recv_ssa, ObjClass* cls,
+                            uint16_t snap)
+{
+    const IRNode* n = &r->ir.nodes[recv_ssa];
+    if (n->op == IR_BOX_OBJ && n->op1 != IR_NONE) {
+        const IRNode* obj = &r->ir.nodes[n->op1];
+        if (obj->op == IR_CONST_OBJ && ((Obj*)obj->imm.ptr)->classObj == cls)
+            return;
+    }
+    if (n->op == IR_NEW_INSTANCE && n->op1 != IR_NONE &&
+        r->ir.nodes[n->op1].imm.ptr == (void*)cls)
+        return;
+    irEmitGuardClass(&r->ir, recv_ssa, cls, snap);
+}
+
+// Guard that the Fn receiver runs the same code as [closure]. Closures
+// without upvalues are interchangeable when they share an ObjFn, so a
+// callback created afresh on each call still matches; one with upvalues must
+// be the very closure recorded, since the trace addresses its upvalues.
+static void widenGuardClosure(JitRecorder* r, uint16_t recv_ssa,
+                              ObjClosure* closure, uint16_t snap)
+{
+    const IRNode* n = &r->ir.nodes[recv_ssa];
+    if (n->op == IR_BOX_OBJ && r->ir.nodes[n->op1].op == IR_CONST_OBJ)
+        return;
+
+    uint16_t same;
+    if (closure->fn->numUpvalues > 0) {
+        uint16_t expected = irEmit(&r->ir, IR_BOX_OBJ,
+                                   irEmitConstObj(&r->ir, closure), IR_NONE,
+                                   IR_TYPE_VALUE);
+        same = irEmit(&r->ir, IR_EQ, recv_ssa, expected, IR_TYPE_INT);
+    } else {
+        uint16_t ptr = irEmit(&r->ir, IR_UNBOX_OBJ, recv_ssa, IR_NONE,
+                              IR_TYPE_PTR);
+        uint16_t fn = irEmitLoadRaw(&r->ir, ptr,
+                                    (int32_t)offsetof(ObjClosure, fn),
+                                    sizeof(ObjFn*), IR_TYPE_PTR, true);
+        same = irEmit(&r->ir, IR_EQ, fn, irEmitConstObj(&r->ir, closure->fn),
+                      IR_TYPE_INT);
+    }
+    uint16_t boxed = irEmit(&r->ir, IR_BOX_BOOL, same, IR_NONE, IR_TYPE_VALUE);
+    irEmitGuardTrue(&r->ir, boxed, snap);
+}
+
 // ---------------------------------------------------------------------------
 // Range.iterate(_) inlining
 //
@@ -81,11 +151,38 @@ static bool inlineRangeIterate(JitRecorder* r, WrenVM* vm,
 
     ObjRange* range = AS_RANGE(recv_val);
 
-    // Determine iteration direction and step at trace time.
-    bool ascending  = (range->from <= range->to);
+    // The trace is specialised to the direction and inclusivity seen now;
+    // the bounds themselves are read at run time, so one trace serves every
+    // Range with the same shape (e.g. `0...n` for any n). Range fields never
+    // change, so LICM hoists the loads and shape guards out of the loop.
+    bool ascending  = (range->from < range->to);
     bool inclusive  = range->isInclusive;
     double step     = ascending ? 1.0 : -1.0;
-    double limit    = range->to;
+
+    uint16_t range_ptr = irEmit(&r->ir, IR_UNBOX_OBJ, recv_ssa, IR_NONE,
+                                IR_TYPE_PTR);
+    uint16_t from_ssa = irEmitLoadRaw(&r->ir, range_ptr,
+                                      (int32_t)offsetof(ObjRange, from),
+                                      sizeof(double), IR_TYPE_NUM, true);
+    uint16_t to_ssa   = irEmitLoadRaw(&r->ir, range_ptr,
+                                      (int32_t)offsetof(ObjRange, to),
+                                      sizeof(double), IR_TYPE_NUM, true);
+    uint16_t incl_ssa = irEmitLoadRaw(&r->ir, range_ptr,
+                                      (int32_t)offsetof(ObjRange, isInclusive),
+                                      sizeof(bool), IR_TYPE_BOOL, true);
+
+    // Guard: same direction (range_iterate steps up iff from < to).
+    uint16_t dir = irEmit(&r->ir, IR_LT, from_ssa, to_ssa, IR_TYPE_BOOL);
+    uint16_t boxed_dir = irEmit(&r->ir, IR_BOX_BOOL, dir, IR_NONE,
+                                IR_TYPE_VALUE);
+    if (ascending) irEmitGuardTrue(&r->ir, boxed_dir, snap);
+    else           irEmitGuardFalse(&r->ir, boxed_dir, snap);
+
+    // Guard: same inclusivity.
+    uint16_t boxed_incl = irEmit(&r->ir, IR_BOX_BOOL, incl_ssa, IR_NONE,
+                                 IR_TYPE_VALUE);
+    if (inclusive) irEmitGuardTrue(&r->ir, boxed_incl, snap);
+    else           irEmitGuardFalse(&r->ir, boxed_incl, snap);
 
     // Guard: arg is Num (the iterator is always a number in a hot loop).
     irEmitGuardNum(&r->ir, arg_ssa, snap);
@@ -102,10 +199,9 @@ static bool inlineRangeIterate(JitRecorder* r, WrenVM* vm,
     // Ascending  + exclusive:  exit when new_iter >= to → guard new_iter <  to
     // Descending + inclusive:  exit when new_iter <  to → guard new_iter >= to
     // Descending + exclusive:  exit when new_iter <= to → guard new_iter >  to
-    uint16_t limit_ssa = irEmitConst(&r->ir, limit);
     IROp cmp_op = ascending ? (inclusive ? IR_LTE : IR_LT)
                             : (inclusive ? IR_GTE : IR_GT);
-    uint16_t cmp_result  = irEmit(&r->ir, cmp_op, new_iter, limit_ssa, IR_TYPE_BOOL);
+    uint16_t cmp_result  = irEmit(&r->ir, cmp_op, new_iter, to_ssa, IR_TYPE_BOOL);
     uint16_t boxed_cmp   = irEmit(&r->ir, IR_BOX_BOOL, cmp_result, IR_NONE,
                                   IR_TYPE_VALUE);
     irEmitGuardTrue(&r->ir, boxed_cmp, snap);
@@ -145,6 +241,272 @@ static bool inlineRangeIteratorValue(JitRecorder* r,
     return true;
 }
 
+// ---------------------------------------------------------------------------
+// List.iterate(_) inlining
+//
+// Semantics (from wren_core.c list_iterate):
+//   if IS_NULL(arg): return 0 or false     (first iteration — never traced hot)
+//   if arg < 0 or arg >= count - 1: return false
+//   return arg + 1
+//
+// The iterator is kept as an integer: it is unboxed once, stepped with a GP
+// add and boxed only for the interpreter-visible slot. The count is re-read
+// every iteration, so the loop body may grow or shrink the list; LICM hoists
+// the load when nothing in the loop can write to the heap.
+// ---------------------------------------------------------------------------
+static uint16_t listCount(JitRecorder* r, uint16_t list_ptr)
+{
+    return irEmitLoadRaw(&r->ir, list_ptr,
+                         (int32_t)(offsetof(ObjList, elements) +
+                                   offsetof(ValueBuffer, count)),
+                         sizeof(int), IR_TYPE_INT, false);
+}
+
+// Guard that a GP boolean is true.
+static void widenGuardCond(JitRecorder* r, uint16_t cond, uint16_t snap)
+{
+    uint16_t boxed = irEmit(&r->ir, IR_BOX_BOOL, cond, IR_NONE, IR_TYPE_VALUE);
+    irEmitGuardTrue(&r->ir, boxed, snap);
+}
+
+// The iterator as a raw integer. A BOX_INT from an earlier step of this
+// trace is looked through instead of round-tripping via a double. Anything
+// else must already be an integer (the interpreter rejects a fractional
+// index), so the UNBOX_INT is IR_FLAG_INTEGRAL rather than truncating.
+static uint16_t widenIndex(JitRecorder* r, uint16_t arg_ssa, uint16_t snap)
+{
+    const IRNode* a = &r->ir.nodes[arg_ssa];
+    if (a->op == IR_BOX_INT) return a->op1;
+
+    irEmitGuardNum(&r->ir, arg_ssa, snap);
+    uint16_t index = irEmit(&r->ir, IR_UNBOX_INT, arg_ssa, IR_NONE,
+                            IR_TYPE_INT);
+    r->ir.nodes[index].flags |= IR_FLAG_INTEGRAL;
+    return index;
+}
+
+static bool inlineListIterate(JitRecorder* r, int recv_slot, uint16_t snap,
+                              uint16_t recv_ssa, uint16_t arg_ssa)
+{
+    uint16_t list_ptr = irEmit(&r->ir, IR_UNBOX_OBJ, recv_ssa, IR_NONE,
+                               IR_TYPE_PTR);
+    uint16_t index = widenIndex(r, arg_ssa, snap);
+
+    // Guard: 0 <= index and index + 1 < count.
+    uint16_t zero = irEmitConstInt(&r->ir, 0);
+    widenGuardCond(r, irEmit(&r->ir, IR_GTE, index, zero, IR_TYPE_INT), snap);
+
+    uint16_t next = irEmit(&r->ir, IR_ADD, index, irEmitConstInt(&r->ir, 1),
+                           IR_TYPE_INT);
+    uint16_t count = listCount(r, list_ptr);
+    widenGuardCond(r, irEmit(&r->ir, IR_LT, next, count, IR_TYPE_INT), snap);
+
+    // CALL_1 stack effect: pop arg, replace receiver with result.
+    r->stack_top--;
+    r->slot_live[r->stack_top] = false;
+    widenSlotSet(r, recv_slot, irEmit(&r->ir, IR_BOX_INT, next, IR_NONE,
+                                      IR_TYPE_VALUE));
+    return true;
+}
+
+// ---------------------------------------------------------------------------
+// List.iteratorValue(_) inlining
+//
+// list_iteratorValue returns elements.data[arg] after validating the index.
+// Negative indices (which the interpreter counts from the end) and anything
+// past the count leave the trace.
+// ---------------------------------------------------------------------------
+static bool inlineListIteratorValue(JitRecorder* r, int recv_slot,
+                                    uint16_t snap,
+                                    uint16_t recv_ssa, uint16_t arg_ssa)
+{
+    uint16_t list_ptr = irEmit(&r->ir, IR_UNBOX_OBJ, recv_ssa, IR_NONE,
+                               IR_TYPE_PTR);
+    uint16_t index = widenIndex(r, arg_ssa, snap);
+
+    uint16_t zero = irEmitConstInt(&r->ir, 0);
+    widenGuardCond(r, irEmit(&r->ir, IR_GTE, index, zero, IR_TYPE_INT), snap);
+    uint16_t count = listCount(r, list_ptr);
+    widenGuardCond(r, irEmit(&r->ir, IR_LT, index, count, IR_TYPE_INT), snap);
+
+    uint16_t data = irEmitLoadRaw(&r->ir, list_ptr,
+                                  (int32_t)(offsetof(ObjList, elements) +
+                                            offsetof(ValueBuffer, data)),
+                                  sizeof(Value*), IR_TYPE_PTR, false);
+    uint16_t elem = irEmit(&r->ir, IR_LOAD_ELEM, data, index, IR_TYPE_VALUE);
+
+    // CALL_1 stack effect: pop arg, replace receiver with the element.
+    r->stack_top--;
+    r->slot_live[r->stack_top] = false;
+    widenSlotSet(r, recv_slot, elem);
+    return true;
+}
+
+// ---------------------------------------------------------------------------
+// Identity and type tests: `!`, `==(_)`, `!=(_)` and `is(_)`
+//
+// These are Object's primitives, which every class inherits unless it
+// defines its own (Num defines `==`). Once the receiver's kind is guarded
+// they reduce to compares of the NaN-boxed bits:
+//   !x         false for objects; for Bool and Null a tag compare
+//   a == b     bit equality, except on strings and ranges: Object's `==`
+//              (wrenValuesEqual) compares their contents, so those are left
+//              to the interpreter. A user class cannot inherit from either.
+//   x is C     constant: the receiver's class is guarded, so its superclass
+//              chain is walked once while recording
+// ---------------------------------------------------------------------------
+
+// Whether [cls] still uses [owner]'s primitive for [symbol].
+static bool widenInheritsPrimitive(ObjClass* cls, ObjClass* owner, int symbol)
+{
+    if (symbol >= cls->methods.count || symbol >= owner->methods.count)
+        return false;
+    const Method* m = &cls->methods.data[symbol];
+    const Method* base = &owner->methods.data[symbol];
+    return m->type == METHOD_PRIMITIVE && base->type == METHOD_PRIMITIVE &&
+           m->as.primitive == base->as.primitive;
+}
+
+// Guard that [recv_ssa] has the kind of [recv_val]: a Num, null, a Bool
+// (either value) or an object of its class. Returns that class.
+static ObjClass* widenGuardKind(JitRecorder* r, WrenVM* vm, Value recv_val,
+                                uint16_t recv_ssa, uint16_t snap)
+{
+    if (IS_NUM(recv_val)) {
+        irEmitGuardNum(&r->ir, recv_ssa, snap);
+        return vm->numClass;
+    }
+    if (IS_NULL(recv_val)) {
+        widenGuardCond(r, irEmit(&r->ir, IR_EQ, recv_ssa,
+                                 irEmitConstNull(&r->ir), IR_TYPE_INT), snap);
+        return vm->nullClass;
+    }
+    if (IS_BOOL(recv_val)) {
+        uint16_t t = irEmit(&r->ir, IR_EQ, recv_ssa,
+                            irEmitConstBool(&r->ir, true), IR_TYPE_INT);
+        uint16_t f = irEmit(&r->ir, IR_EQ, recv_ssa,
+                            irEmitConstBool(&r->ir, false), IR_TYPE_INT);
+        widenGuardCond(r, irEmit(&r->ir, IR_BOR, t, f, IR_TYPE_INT), snap);
+        return vm->boolClass;
+    }
+    ObjClass* cls = AS_OBJ(recv_val)->classObj;
+    widenGuardClass(r, recv_ssa, cls, snap);
+    return cls;
+}
+
+// `!` on any receiver whose class does not define its own.
+static bool widenNot(JitRecorder* r, WrenVM* vm, int recv_slot,
+                     uint16_t symbol, uint8_t* ip, Value recv_val)
+{
+    ObjClass* cls = wrenGetClassInline(vm, recv_val);
+    if (cls != vm->boolClass && cls != vm->nullClass &&
+        !widenInheritsPrimitive(cls, vm->objectClass, symbol))
+        return false;
+
+    uint16_t snap = widenEmitSnapshot(r, ip);
+    uint16_t recv_ssa = widenSlotGet(r, recv_slot);
+    if (recv_ssa == IR_NONE) recv_ssa = irEmitLoad(&r->ir, (uint16_t)recv_slot);
+    cls = widenGuardKind(r, vm, recv_val, recv_ssa, snap);
+
+    uint16_t result;
+    if (cls == vm->boolClass) {
+        uint16_t f = irEmit(&r->ir, IR_EQ, recv_ssa,
+                            irEmitConstBool(&r->ir, false), IR_TYPE_INT);
+        result = irEmit(&r->ir, IR_BOX_BOOL, f, IR_NONE, IR_TYPE_VALUE);
+    } else {
+        result = irEmitConstBool(&r->ir, cls == vm->nullClass);
+    }
+    widenSlotSet(r, recv_slot, result);
+    return true;
+}
+
+// `==(_)`, `!=(_)` and `is(_)` on any receiver that inherits Object's.
+static bool widenIdentity(JitRecorder* r, WrenVM* vm, int recv_slot,
+                          uint16_t symbol, uint8_t* ip,
+                          Value recv_val, Value arg_val)
+{
+    bool is_eq  = widenMethodNameEquals(vm, symbol, "==(_)");
+    bool is_neq = widenMethodNameEquals(vm, symbol, "!=(_)");
+    bool is_is  = widenMethodNameEquals(vm, symbol, "is(_)");
+    if (!is_eq && !is_neq && !is_is) return false;
+
+    ObjClass* cls = wrenGetClassInline(vm, recv_val);
+    if (!widenInheritsPrimitive(cls, vm->objectClass, symbol)) return false;
+    // Two distinct strings or ranges may still be equal.
+    if (!is_is && (cls == vm->stringClass || cls == vm->rangeClass))
+        return false;
+    // `x is 3` is a runtime error; leave it to the interpreter.
+    if (is_is && !IS_CLASS(arg_val)) return false;
+
+    int arg_slot = recv_slot + 1;
+    uint16_t snap = widenEmitSnapshot(r, ip);
+    uint16_t recv_ssa = widenSlotGet(r, recv_slot);
+    if (recv_ssa == IR_NONE) recv_ssa = irEmitLoad(&r->ir, (uint16_t)recv_slot);
+    uint16_t arg_ssa = widenSlotGet(r, arg_slot);
+    if (arg_ssa == IR_NONE) arg_ssa = irEmitLoad(&r->ir, (uint16_t)arg_slot);
+    cls = widenGuardKind(r, vm, recv_val, recv_ssa, snap);
+
+    uint16_t result;
+    if (is_is) {
+        // The class operand is nearly always a folded module variable; any
+        // other must be the class seen while recording.
+        ObjClass* target = AS_CLASS(arg_val);
+        const IRNode* a = &r->ir.nodes[arg_ssa];
+        if (!(a->op == IR_BOX_OBJ && a->op1 != IR_NONE &&
+              r->ir.nodes[a->op1].op == IR_CONST_OBJ &&
+              r->ir.nodes[a->op1].imm.ptr == (void*)target)) {
+            uint16_t expect = irEmit(&r->ir, IR_BOX_OBJ,
+                                     irEmitConstObj(&r->ir, target),
+                                     IR_NONE, IR_TYPE_VALUE);
+            widenGuardCond(r, irEmit(&r->ir, IR_EQ, arg_ssa, expect,
+                                     IR_TYPE_INT), snap);
+        }
+        bool found = false;
+        for (ObjClass* c = cls; c != NULL; c = c->superclass) {
+            if (c == target) { found = true; break; }
+        }
+        result = irEmitConstBool(&r->ir, found);
+    } else {
+        uint16_t cmp = irEmit(&r->ir, is_eq ? IR_EQ : IR_NEQ,
+                              recv_ssa, arg_ssa, IR_TYPE_INT);
+        result = irEmit(&r->ir, IR_BOX_BOOL, cmp, IR_NONE, IR_TYPE_VALUE);
+    }
+
+    // CALL_1 stack effect: -1 (pops arg, replaces receiver with result).
+    r->stack_top--;
+    r->slot_live[r->stack_top] = false;
+    widenSlotSet(r, recv_slot, result);
+    return true;
+}
+
+// ---------------------------------------------------------------------------
+// String concatenation (CALL_1 `+(_)` on two strings)
+//
+// Becomes STRING_APPEND, a call to wrenJitStringAppend. When the optimizer
+// proves the left operand is a loop-carried accumulator nothing else sees,
+// the append grows it in place (see irOptStringBuilders).
+// ---------------------------------------------------------------------------
+static bool widenStringAppend(JitRecorder* r, WrenVM* vm, int recv_slot,
+                              uint8_t* ip)
+{
+    int arg_slot = recv_slot + 1;
+    uint16_t snap = widenEmitSnapshot(r, ip);
+    uint16_t recv_ssa = widenSlotGet(r, recv_slot);
+    if (recv_ssa == IR_NONE) recv_ssa = irEmitLoad(&r->ir, (uint16_t)recv_slot);
+    uint16_t arg_ssa = widenSlotGet(r, arg_slot);
+    if (arg_ssa == IR_NONE) arg_ssa = irEmitLoad(&r->ir, (uint16_t)arg_slot);
+
+    widenGuardClass(r, recv_ssa, vm->stringClass, snap);
+    widenGuardClass(r, arg_ssa, vm->stringClass, snap);
+    uint16_t result = irEmitStringAppend(&r->ir, recv_ssa, arg_ssa, snap);
+
+    // CALL_1 stack effect: -1 (pops arg, replaces receiver with result).
+    r->stack_top--;
+    r->slot_live[r->stack_top] = false;
+    widenSlotSet(r, recv_slot, result);
+    return true;
+}
+
 // ---------------------------------------------------------------------------
 // Public: jitTryWidenCall1
 // ---------------------------------------------------------------------------
@@ -161,44 +523,355 @@ bool jitTryWidenCall1(WrenJitState* jit, WrenVM* vm, Value* stackStart,
     Value recv_val = stackStart[recv_slot];
     Value arg_val  = stackStart[arg_slot];
 
+    if (widenIdentity(r, vm, recv_slot, symbol, ip, recv_val, arg_val))
+        return true;
+    if (IS_STRING(recv_val) && IS_STRING(arg_val) &&
+        widenMethodNameEquals(vm, symbol, "+(_)"))
+        return widenStringAppend(r, vm, recv_slot, ip);
+
     // ------------------------------------------------------------------
-    // Range methods
+    // Range and List iteration protocol
     // ------------------------------------------------------------------
-    if (IS_RANGE(recv_val)) {
-        bool is_iterate = widenMethodNameEquals(vm, symbol, "iterate(_)");
-        bool is_iterval = widenMethodNameEquals(vm, symbol, "iteratorValue(_)");
+    ObjClass* cls;
+    if (IS_RANGE(recv_val))     cls = vm->rangeClass;
+    else if (IS_LIST(recv_val)) cls = vm->listClass;
+    else return false;          // unsupported receiver type
 
-        if (!is_iterate && !is_iterval) return false;
+    // The first iterate(null) of a loop is left to the interpreter.
+    if (!IS_NUM(arg_val)) return false;
 
-        uint16_t snap = widenEmitSnapshot(r, ip);
+    bool is_iterate = widenMethodNameEquals(vm, symbol, "iterate(_)");
+    bool is_iterval = widenMethodNameEquals(vm, symbol, "iteratorValue(_)");
+    bool is_subscript = cls == vm->listClass &&
+                        widenMethodNameEquals(vm, symbol, "[_]");
 
-        // Get or load receiver SSA.
-        uint16_t recv_ssa = widenSlotGet(r, recv_slot);
-        if (recv_ssa == IR_NONE) {
-            recv_ssa = irEmitLoad(&r->ir, (uint16_t)recv_slot);
-            widenSlotSet(r, recv_slot, recv_ssa);
-        }
+    if (!is_iterate && !is_iterval && !is_subscript) return false;
 
-        // Get or load arg SSA.
-        uint16_t arg_ssa = widenSlotGet(r, arg_slot);
-        if (arg_ssa == IR_NONE) {
-            arg_ssa = irEmitLoad(&r->ir, (uint16_t)arg_slot);
-            widenSlotSet(r, arg_slot, arg_ssa);
-        }
+    uint16_t snap = widenEmitSnapshot(r, ip);
+
+    // Get or load receiver SSA.
+    uint16_t recv_ssa = widenSlotGet(r, recv_slot);
+    if (recv_ssa == IR_NONE) {
+        recv_ssa = irEmitLoad(&r->ir, (uint16_t)recv_slot);
+        widenSlotSet(r, recv_slot, recv_ssa);
+    }
 
-        // Guard: receiver's class == vm->rangeClass.
-        irEmitGuardClass(&r->ir, recv_ssa, vm->rangeClass, snap);
+    // Get or load arg SSA.
+    uint16_t arg_ssa = widenSlotGet(r, arg_slot);
+    if (arg_ssa == IR_NONE) {
+        arg_ssa = irEmitLoad(&r->ir, (uint16_t)arg_slot);
+        widenSlotSet(r, arg_slot, arg_ssa);
+    }
+
+    // Guard: receiver's class is the one seen while recording.
+    widenGuardClass(r, recv_ssa, cls, snap);
 
-        if (is_iterate) {
-            return inlineRangeIterate(r, vm, recv_val, arg_val,
-                                      recv_slot, arg_slot,
-                                      snap, recv_ssa, arg_ssa);
+    if (cls == vm->listClass) {
+        if (is_iterate)
+            return inlineListIterate(r, recv_slot, snap, recv_ssa, arg_ssa);
+        if (is_subscript) {
+            // list[i] reads like iteratorValue(i) but must reject a
+            // fractional index: it has to survive a round trip through int.
+            uint16_t index = widenIndex(r, arg_ssa, snap);
+            uint16_t back = irEmit(&r->ir, IR_BOX_INT, index, IR_NONE,
+                                   IR_TYPE_VALUE);
+            widenGuardCond(r, irEmit(&r->ir, IR_EQ, back, arg_ssa,
+                                     IR_TYPE_INT), snap);
         }
-        // is_iterval
-        return inlineRangeIteratorValue(r, recv_slot, arg_slot, snap, arg_ssa);
+        return inlineListIteratorValue(r, recv_slot, snap, recv_ssa, arg_ssa);
     }
 
-    return false; // unsupported receiver type
+    if (is_iterate) {
+        return inlineRangeIterate(r, vm, recv_val, arg_val,
+                                  recv_slot, arg_slot,
+                                  snap, recv_ssa, arg_ssa);
+    }
+    // is_iterval
+    return inlineRangeIteratorValue(r, recv_slot, arg_slot, snap, arg_ssa);
+}
+
+// ---------------------------------------------------------------------------
+// Builtin accessors (CALL_0)
+//
+// Each entry lowers a zero-argument primitive of a core class to loads from
+// the receiver. Core classes cannot be reopened, so once the receiver's
+// class is guarded the method is known. A lowering returns the result Value.
+// String.count decodes UTF-8 and is left to the interpreter.
+// ---------------------------------------------------------------------------
+typedef uint16_t (*WidenGetterFn)(JitRecorder* r, Value recv_val,
+                                  uint16_t recv_ssa, uint16_t snap);
+
+typedef struct {
+    size_t cls_offset;       // offsetof(WrenVM, <class>) of the receiver class
+    const char* name;        // method signature
+    WidenGetterFn lower;
+} WidenGetter;
+
+static uint16_t widenPtr(JitRecorder* r, uint16_t recv_ssa)
+{
+    return irEmit(&r->ir, IR_UNBOX_OBJ, recv_ssa, IR_NONE, IR_TYPE_PTR);
+}
+
+static uint16_t widenBoxInt(JitRecorder* r, uint16_t value)
+{
+    return irEmit(&r->ir, IR_BOX_INT, value, IR_NONE, IR_TYPE_VALUE);
+}
+
+static uint16_t widenIsZero(JitRecorder* r, uint16_t value)
+{
+    uint16_t cmp = irEmit(&r->ir, IR_EQ, value, irEmitConstInt(&r->ir, 0),
+                          IR_TYPE_INT);
+    return irEmit(&r->ir, IR_BOX_BOOL, cmp, IR_NONE, IR_TYPE_VALUE);
+}
+
+static uint16_t mapCount(JitRecorder* r, uint16_t recv_ssa)
+{
+    return irEmitLoadRaw(&r->ir, widenPtr(r, recv_ssa),
+                         (int32_t)offsetof(ObjMap, count),
+                         sizeof(uint32_t), IR_TYPE_INT, false);
+}
+
+static uint16_t stringLength(JitRecorder* r, uint16_t recv_ssa)
+{
+    return irEmitLoadRaw(&r->ir, widenPtr(r, recv_ssa),
+                         (int32_t)offsetof(ObjString, length),
+                         sizeof(uint32_t), IR_TYPE_INT, true);
+}
+
+static uint16_t rangeBound(JitRecorder* r, uint16_t recv_ssa, size_t offset)
+{
+    return irEmitLoadRaw(&r->ir, widenPtr(r, recv_ssa), (int32_t)offset,
+                         sizeof(double), IR_TYPE_NUM, true);
+}
+
+static uint16_t getListCount(JitRecorder* r, Value v, uint16_t recv,
+                             uint16_t snap)
+{
+    (void)v; (void)snap;
+    return widenBoxInt(r, listCount(r, widenPtr(r, recv)));
+}
+
+static uint16_t getListIsEmpty(JitRecorder* r, Value v, uint16_t recv,
+                               uint16_t snap)
+{
+    (void)v; (void)snap;
+    return widenIsZero(r, listCount(r, widenPtr(r, recv)));
+}
+
+static uint16_t getMapCount(JitRecorder* r, Value v, uint16_t recv,
+                            uint16_t snap)
+{
+    (void)v; (void)snap;
+    return widenBoxInt(r, mapCount(r, recv));
+}
+
+static uint16_t getMapIsEmpty(JitRecorder* r, Value v, uint16_t recv,
+                              uint16_t snap)
+{
+    (void)v; (void)snap;
+    return widenIsZero(r, mapCount(r, recv));
+}
+
+static uint16_t getStringByteCount(JitRecorder* r, Value v, uint16_t recv,
+                                   uint16_t snap)
+{
+    (void)v; (void)snap;
+    return widenBoxInt(r, stringLength(r, recv));
+}
+
+static uint16_t getStringIsEmpty(JitRecorder* r, Value v, uint16_t recv,
+                                 uint16_t snap)
+{
+    (void)v; (void)snap;
+    return widenIsZero(r, stringLength(r, recv));
+}
+
+static uint16_t getRangeFrom(JitRecorder* r, Value v, uint16_t recv,
+                             uint16_t snap)
+{
+    (void)v; (void)snap;
+    return irEmitBox(&r->ir, rangeBound(r, recv, offsetof(ObjRange, from)));
+}
+
+static uint16_t getRangeTo(JitRecorder* r, Value v, uint16_t recv,
+                           uint16_t snap)
+{
+    (void)v; (void)snap;
+    return irEmitBox(&r->ir, rangeBound(r, recv, offsetof(ObjRange, to)));
+}
+
+static uint16_t getRangeIsInclusive(JitRecorder* r, Value v, uint16_t recv,
+                                    uint16_t snap)
+{
+    (void)v; (void)snap;
+    uint16_t incl = irEmitLoadRaw(&r->ir, widenPtr(r, recv),
+                                  (int32_t)offsetof(ObjRange, isInclusive),
+                                  sizeof(bool), IR_TYPE_BOOL, true);
+    return irEmit(&r->ir, IR_BOX_BOOL, incl, IR_NONE, IR_TYPE_VALUE);
+}
+
+// min and max pick a bound by the direction seen while recording and guard
+// that it holds, as iterate(_) does.
+static uint16_t rangeMinMax(JitRecorder* r, Value v, uint16_t recv,
+                            uint16_t snap, bool wantMin)
+{
+    ObjRange* range = AS_RANGE(v);
+    bool ascending = range->from < range->to;
+
+    uint16_t from = rangeBound(r, recv, offsetof(ObjRange, from));
+    uint16_t to   = rangeBound(r, recv, offsetof(ObjRange, to));
+    uint16_t dir  = irEmit(&r->ir, IR_LT, from, to, IR_TYPE_BOOL);
+    uint16_t boxed_dir = irEmit(&r->ir, IR_BOX_BOOL, dir, IR_NONE,
+                                IR_TYPE_VALUE);
+    if (ascending) irEmitGuardTrue(&r->ir, boxed_dir, snap);
+    else           irEmitGuardFalse(&r->ir, boxed_dir, snap);
+
+    // Equal bounds take the descending path; either one is then right.
+    return irEmitBox(&r->ir, (ascending == wantMin) ? from : to);
+}
+
+static uint16_t getRangeMin(JitRecorder* r, Value v, uint16_t recv,
+                            uint16_t snap)
+{
+    return rangeMinMax(r, v, recv, snap, true);
+}
+
+static uint16_t getRangeMax(JitRecorder* r, Value v, uint16_t recv,
+                            uint16_t snap)
+{
+    return rangeMinMax(r, v, recv, snap, false);
+}
+
+static uint16_t getNumIsNan(JitRecorder* r, Value v, uint16_t recv,
+                            uint16_t snap)
+{
+    (void)v; (void)snap;
+    // Only NaN compares unequal to itself.
+    uint16_t x = irEmitUnbox(&r->ir, recv);
+    uint16_t same = irEmit(&r->ir, IR_EQ, x, x, IR_TYPE_BOOL);
+    return widenIsZero(r, same);
+}
+
+// Truncates through an int64 and compares. Values of magnitude 2^53 or more
+// (all integers), infinities and NaN do not fit and leave the trace.
+static uint16_t getNumIsInteger(JitRecorder* r, Value v, uint16_t recv,
+                                uint16_t snap)
+{
+    (void)v;
+    uint16_t x = irEmitUnbox(&r->ir, recv);
+    uint16_t limit = irEmitConst(&r->ir, 9007199254740992.0);
+    widenGuardCond(r, irEmit(&r->ir, IR_LT, x, limit, IR_TYPE_BOOL), snap);
+    uint16_t neg_limit = irEmitConst(&r->ir, -9007199254740992.0);
+    widenGuardCond(r, irEmit(&r->ir, IR_GT, x, neg_limit, IR_TYPE_BOOL), snap);
+
+    uint16_t whole = irEmit(&r->ir, IR_UNBOX_INT, recv, IR_NONE, IR_TYPE_INT);
+    uint16_t back = irEmitUnbox(&r->ir, widenBoxInt(r, whole));
+    uint16_t same = irEmit(&r->ir, IR_EQ, back, x, IR_TYPE_BOOL);
+    return irEmit(&r->ir, IR_BOX_BOOL, same, IR_NONE, IR_TYPE_VALUE);
+}
+
+// floor(x) is trunc(x), less one when truncation rounded up (x < 0 with a
+// fraction). The same range guards as isInteger keep the int64 exact, and
+// -0.0, whose floor is -0.0 rather than the integer 0, leaves the trace for
+// the interpreter's floor(). It is found by its bits: it compares equal to 0.
+static uint16_t getNumFloor(JitRecorder* r, Value v, uint16_t recv,
+                            uint16_t snap)
+{
+    (void)v;
+    uint16_t neg_zero = irEmitConstInt(&r->ir, INT64_MIN);
+    widenGuardCond(r, irEmit(&r->ir, IR_NEQ, recv, neg_zero, IR_TYPE_INT),
+                   snap);
+
+    uint16_t x = irEmitUnbox(&r->ir, recv);
+    uint16_t limit = irEmitConst(&r->ir, 9007199254740992.0);
+    widenGuardCond(r, irEmit(&r->ir, IR_LT, x, limit, IR_TYPE_BOOL), snap);
+    uint16_t neg_limit = irEmitConst(&r->ir, -9007199254740992.0);
+    widenGuardCond(r, irEmit(&r->ir, IR_GT, x, neg_limit, IR_TYPE_BOOL), snap);
+
+    uint16_t whole = irEmit(&r->ir, IR_UNBOX_INT, recv, IR_NONE, IR_TYPE_INT);
+    uint16_t back = irEmitUnbox(&r->ir, widenBoxInt(r, whole));
+    uint16_t above = irEmit(&r->ir, IR_GT, back, x, IR_TYPE_BOOL);
+    return widenBoxInt(r, irEmit(&r->ir, IR_SUB, whole, above, IR_TYPE_INT));
+}
+
+static uint16_t getFnArity(JitRecorder* r, Value v, uint16_t recv,
+                           uint16_t snap)
+{
+    (void)v; (void)snap;
+    uint16_t fn = irEmitLoadRaw(&r->ir, widenPtr(r, recv),
+                                (int32_t)offsetof(ObjClosure, fn),
+                                sizeof(ObjFn*), IR_TYPE_PTR, true);
+    uint16_t arity = irEmitLoadRaw(&r->ir, fn, (int32_t)offsetof(ObjFn, arity),
+                                   sizeof(int), IR_TYPE_INT, true);
+    return widenBoxInt(r, arity);
+}
+
+static const WidenGetter widenGetters[] = {
+    { offsetof(WrenVM, listClass),   "count",       getListCount },
+    { offsetof(WrenVM, listClass),   "isEmpty",     getListIsEmpty },
+    { offsetof(WrenVM, mapClass),    "count",       getMapCount },
+    { offsetof(WrenVM, mapClass),    "isEmpty",     getMapIsEmpty },
+    { offsetof(WrenVM, stringClass), "byteCount_",  getStringByteCount },
+    { offsetof(WrenVM, stringClass), "isEmpty",     getStringIsEmpty },
+    { offsetof(WrenVM, rangeClass),  "from",        getRangeFrom },
+    { offsetof(WrenVM, rangeClass),  "to",          getRangeTo },
+    { offsetof(WrenVM, rangeClass),  "min",         getRangeMin },
+    { offsetof(WrenVM, rangeClass),  "max",         getRangeMax },
+    { offsetof(WrenVM, rangeClass),  "isInclusive", getRangeIsInclusive },
+    { offsetof(WrenVM, numClass),    "isNan",       getNumIsNan },
+    { offsetof(WrenVM, numClass),    "isInteger",   getNumIsInteger },
+    { offsetof(WrenVM, numClass),    "floor",       getNumFloor },
+    { offsetof(WrenVM, fnClass),     "arity",       getFnArity },
+};
+
+// ---------------------------------------------------------------------------
+// Random.float() and Random.int() (CALL_0 on an instance of the optional
+// random module's foreign class)
+//
+// The methods are recognised by their foreign function, so a user class
+// that happens to be called Random is not. The generator is advanced by a
+// direct call (wrenJitRandomFloat/Int) instead of the foreign-call path;
+// its state stays in the object. float(end), int(end) and the rest are
+// written in Wren on top of these two and are inlined as methods.
+// ---------------------------------------------------------------------------
+static bool widenRandom(JitRecorder* r, WrenVM* vm, int recv_slot,
+                        uint16_t symbol, uint8_t* ip, Value recv_val)
+{
+#if WREN_OPT_RANDOM
+    if (!IS_FOREIGN(recv_val)) return false;
+    ObjClass* cls = AS_OBJ(recv_val)->classObj;
+    if (symbol >= cls->methods.count) return false;
+    Method* method = &cls->methods.data[symbol];
+    if (method->type != METHOD_FOREIGN) return false;
+
+    bool asInt;
+    if (method->as.foreign ==
+        wrenRandomBindForeignMethod(vm, "Random", false, "float()")) {
+        asInt = false;
+    } else if (method->as.foreign ==
+               wrenRandomBindForeignMethod(vm, "Random", false, "int()")) {
+        asInt = true;
+    } else {
+        return false;
+    }
+
+    uint16_t snap = widenEmitSnapshot(r, ip);
+    uint16_t recv_ssa = widenSlotGet(r, recv_slot);
+    if (recv_ssa == IR_NONE) {
+        recv_ssa = irEmitLoad(&r->ir, (uint16_t)recv_slot);
+        widenSlotSet(r, recv_slot, recv_ssa);
+    }
+    widenGuardClass(r, recv_ssa, cls, snap);
+
+    uint16_t next = irEmitRandom(&r->ir, widenPtr(r, recv_ssa), asInt);
+    // CALL_0 stack effect: the receiver is replaced by the result.
+    widenSlotSet(r, recv_slot, irEmitBox(&r->ir, next));
+    return true;
+#else
+    (void)r; (void)vm; (void)recv_slot; (void)symbol; (void)ip;
+    (void)recv_val;
+    return false;
+#endif
 }
 
 // ---------------------------------------------------------------------------
@@ -207,6 +880,180 @@ bool jitTryWidenCall1(WrenJitState* jit, WrenVM* vm, Value* stackStart,
 bool jitTryWidenCall0(WrenJitState* jit, WrenVM* vm, Value* stackStart,
                       uint16_t symbol, uint8_t* ip)
 {
-    (void)jit; (void)vm; (void)stackStart; (void)symbol; (void)ip;
-    return false;
+    JitRecorder* r = jitRecorderGet(jit);
+    if (!r || r->aborted) return false;
+    if (r->stack_top < 1) return false;
+
+    int recv_slot = r->stack_top - 1;
+    Value recv_val = stackStart[recv_slot];
+    ObjClass* cls = wrenGetClassInline(vm, recv_val);
+
+    if (widenMethodNameEquals(vm, symbol, "!"))
+        return widenNot(r, vm, recv_slot, symbol, ip, recv_val);
+    if (widenRandom(r, vm, recv_slot, symbol, ip, recv_val)) return true;
+
+    const WidenGetter* getter = NULL;
+    for (size_t i = 0; i < sizeof(widenGetters) / sizeof(widenGetters[0]); i++) {
+        const WidenGetter* g = &widenGetters[i];
+        if (*(ObjClass**)((char*)vm + g->cls_offset) == cls &&
+            widenMethodNameEquals(vm, symbol, g->name)) {
+            getter = g;
+            break;
+        }
+    }
+    if (getter == NULL) return false;
+
+    uint16_t snap = widenEmitSnapshot(r, ip);
+
+    uint16_t recv_ssa = widenSlotGet(r, recv_slot);
+    if (recv_ssa == IR_NONE) {
+        recv_ssa = irEmitLoad(&r->ir, (uint16_t)recv_slot);
+        widenSlotSet(r, recv_slot, recv_ssa);
+    }
+
+    if (cls == vm->numClass) irEmitGuardNum(&r->ir, recv_ssa, snap);
+    else                     widenGuardClass(r, recv_ssa, cls, snap);
+
+    // CALL_0 stack effect: the receiver is replaced by the result.
+    widenSlotSet(r, recv_slot, getter->lower(r, recv_val, recv_ssa, snap));
+    return true;
+}
+
+// ---------------------------------------------------------------------------
+// Public: jitTryInlineAccessor
+//
+// The compiler emits a getter's body as LOAD_FIELD_THIS f; RETURN and a
+// setter's as LOAD_LOCAL_1; STORE_FIELD_THIS f; RETURN (the assigned value is
+// the result). Those bodies become one field load or store on the receiver;
+// the interpreter still runs the call, and the recorder skips its body.
+// ---------------------------------------------------------------------------
+bool jitTryInlineAccessor(WrenJitState* jit, WrenVM* vm, Value* stackStart,
+                          uint16_t symbol, int numArgs, uint8_t* ip)
+{
+    (void)vm;
+    JitRecorder* r = jitRecorderGet(jit);
+    if (!r || r->aborted) return false;
+
+    int recv_slot = r->stack_top - numArgs - 1;
+    if (recv_slot < r->base) return false;
+
+    Value recv_val = stackStart[recv_slot];
+    if (!IS_INSTANCE(recv_val)) return false;
+
+    ObjClass* cls = AS_OBJ(recv_val)->classObj;
+    if (symbol >= cls->methods.count) return false;
+    Method* method = &cls->methods.data[symbol];
+    if (method->type != METHOD_BLOCK) return false;
+
+    const uint8_t* code = method->as.closure->fn->code.data;
+    int length = method->as.closure->fn->code.count;
+    int field;
+    if (length < 4) return false;
+    if (numArgs == 0 && code[0] == CODE_LOAD_FIELD_THIS &&
+        code[2] == CODE_RETURN) {
+        field = code[1];
+    } else if (numArgs == 1 && code[0] == CODE_LOAD_LOCAL_1 &&
+               code[1] == CODE_STORE_FIELD_THIS && code[3] == CODE_RETURN) {
+        field = code[2];
+    } else {
+        return false;
+    }
+    if (field >= cls->numFields) return false;
+
+    uint16_t snap = widenEmitSnapshot(r, ip);
+    uint16_t recv_ssa = widenSlotGet(r, recv_slot);
+    if (recv_ssa == IR_NONE) {
+        recv_ssa = irEmitLoad(&r->ir, (uint16_t)recv_slot);
+        widenSlotSet(r, recv_slot, recv_ssa);
+    }
+    widenGuardClass(r, recv_ssa, cls, snap);
+    uint16_t obj = widenPtr(r, recv_ssa);
+
+    uint16_t result;
+    if (numArgs == 0) {
+        result = irEmitLoadField(&r->ir, obj, (uint16_t)field);
+    } else {
+        result = widenSlotGet(r, recv_slot + 1);
+        if (result == IR_NONE) {
+            result = irEmitLoad(&r->ir, (uint16_t)(recv_slot + 1));
+        }
+        irEmitStoreField(&r->ir, obj, (uint16_t)field, result);
+        r->stack_top--;
+        r->slot_live[r->stack_top] = false;
+    }
+    widenSlotSet(r, recv_slot, result);
+
+    // CALL_N is the opcode and a two-byte symbol.
+    r->skip_until = ip + 3;
+    return true;
+}
+
+// ---------------------------------------------------------------------------
+// Public: jitTryInlineMethod
+//
+// The interpreter still performs the call; the recorder only has to follow
+// it. Inside the callee, local slots are offset by the receiver's slot
+// (r->base) and snapshots carry the frame so a side exit can rebuild the
+// callee's CallFrame. A class guard suffices: Wren cannot redefine a method
+// once its class is created.
+// ---------------------------------------------------------------------------
+bool jitTryInlineMethod(WrenJitState* jit, WrenVM* vm, Value* stackStart,
+                        uint16_t symbol, int numArgs, uint8_t* ip)
+{
+    JitRecorder* r = jitRecorderGet(jit);
+    if (!r || r->aborted) return false;
+    if (r->call_depth >= JIT_TRACE_MAX_CALL_DEPTH) return false;
+
+    int recv_slot = r->stack_top - numArgs - 1;
+    if (recv_slot < r->base) return false;
+
+    Value recv_val = stackStart[recv_slot];
+    if (!IS_OBJ(recv_val)) return false;
+
+    ObjClass* cls = AS_OBJ(recv_val)->classObj;
+    if (symbol >= cls->methods.count) return false;
+    Method* method = &cls->methods.data[symbol];
+
+    ObjClosure* closure;
+    if (method->type == METHOD_BLOCK) {
+        closure = method->as.closure;
+    } else if (method->type == METHOD_FUNCTION_CALL) {
+        // Fn.call(...): the receiver is the closure, called with the
+        // receiver as local 0 just like a method. Too few arguments is a
+        // runtime error, left to the interpreter.
+        closure = AS_CLOSURE(recv_val);
+        if (numArgs < closure->fn->arity) return false;
+    } else {
+        return false;
+    }
+    if (recv_slot + closure->fn->maxSlots > JIT_TRACE_MAX_SLOTS) return false;
+
+    // A running trace cannot grow the fiber, so an exit inside the method
+    // needs its frame and slots to fit the fiber as it is now.
+    ObjFiber* fiber = vm->fiber;
+    if ((stackStart - fiber->stack) + recv_slot + closure->fn->maxSlots >
+            fiber->stackCapacity ||
+        fiber->numFrames >= fiber->frameCapacity) {
+        return false;
+    }
+
+    // Exits before the frame is entered re-run the call in the interpreter.
+    uint16_t snap = widenEmitSnapshot(r, ip);
+
+    uint16_t recv_ssa = widenSlotGet(r, recv_slot);
+    if (recv_ssa == IR_NONE) {
+        recv_ssa = irEmitLoad(&r->ir, (uint16_t)recv_slot);
+        widenSlotSet(r, recv_slot, recv_ssa);
+    }
+    widenGuardClass(r, recv_ssa, cls, snap);
+    if (method->type == METHOD_FUNCTION_CALL)
+        widenGuardClosure(r, recv_ssa, closure, snap);
+
+    // CALL_N is the opcode and a two-byte symbol.
+    if (irPushFrame(&r->ir, closure, ip + 3, (uint16_t)recv_slot) == IR_NONE)
+        return false;
+
+    r->base = recv_slot;
+    r->call_depth++;
+    return true;
 }
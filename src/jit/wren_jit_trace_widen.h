@@ -29,4 +29,18 @@ bool jitTryWidenCall1(WrenJitState* jit, WrenVM* vm, Value* stackStart,
 bool jitTryWidenCall0(WrenJitState* jit, WrenVM* vm, Value* stackStart,
                       uint16_t symbol, uint8_t* ip);
 
+// Attempt to inline a getter (`x { _x }`) or setter (`x=(v) { _x = v }`)
+// of a user class as a direct field access behind a class guard, without
+// entering the method's frame. [numArgs] is 0 for a getter, 1 for a setter.
+bool jitTryInlineAccessor(WrenJitState* jit, WrenVM* vm, Value* stackStart,
+                          uint16_t symbol, int numArgs, uint8_t* ip);
+
+// Attempt to inline a call to a method written in Wren (METHOD_BLOCK) on the
+// receiver below [numArgs] arguments. Guards the receiver's class and enters
+// the method's frame; the recorder then follows its bytecode until RETURN.
+// Returns false if the method is not a Wren method or the trace cannot hold
+// another frame.
+bool jitTryInlineMethod(WrenJitState* jit, WrenVM* vm, Value* stackStart,
+                        uint16_t symbol, int numArgs, uint8_t* ip);
+
 #endif // wren_jit_trace_widen_h
@@ -421,6 +421,404 @@ TEST(test_gvn) {
     (void)s2;
 }
 
+TEST(test_promote_loop_vars_by_index) {
+    // Variable 0 is read and written in the loop; variable 1 is only read.
+    // Only variable 0 gets a pre-header load and PHI.
+    IRBuffer buf;
+    irBufferInit(&buf);
+    for (int i = 0; i < 6; i++) irEmit(&buf, IR_NOP, IR_NONE, IR_NONE, IR_TYPE_VOID);
+    irEmitLoopHeader(&buf);
+    uint16_t l0 = irEmit(&buf, IR_LOAD_MODULE_VAR, IR_NONE, IR_NONE, IR_TYPE_VALUE);
+    buf.nodes[l0].imm.intval = 0;
+    uint16_t u0 = irEmitUnbox(&buf, l0);
+    uint16_t l1 = irEmit(&buf, IR_LOAD_MODULE_VAR, IR_NONE, IR_NONE, IR_TYPE_VALUE);
+    buf.nodes[l1].imm.intval = 1;
+    uint16_t u1 = irEmitUnbox(&buf, l1);
+    uint16_t sum = irEmit(&buf, IR_ADD, u0, u1, IR_TYPE_NUM);
+    uint16_t st = irEmit(&buf, IR_STORE_MODULE_VAR, irEmitBox(&buf, sum),
+                         IR_NONE, IR_TYPE_VOID);
+    buf.nodes[st].imm.intval = 0;
+    irEmitLoopBack(&buf);
+
+    irOptPromoteLoopVars(&buf);
+    assert(buf.nodes[0].op == IR_LOAD_MODULE_VAR);
+    assert(buf.nodes[0].imm.intval == 0);
+    assert(buf.nodes[2].op == IR_PHI);
+    assert(buf.nodes[l0].flags & IR_FLAG_DEAD);
+    assert(!(buf.nodes[l1].flags & IR_FLAG_DEAD));
+    assert(buf.nodes[sum].op1 == 2);
+}
+
+TEST(test_snapshot_frames) {
+    // Snapshots remember the inlined frame they were taken in.
+    IRBuffer buf;
+    irBufferInit(&buf);
+    uint16_t outer = irEmitSnapshot(&buf, (uint8_t*)0x10, 2);
+    uint16_t f0 = irPushFrame(&buf, (void*)0x100, (uint8_t*)0x13, 1);
+    uint16_t f1 = irPushFrame(&buf, (void*)0x200, (uint8_t*)0x23, 3);
+    uint16_t inner = irEmitSnapshot(&buf, (uint8_t*)0x30, 5);
+    irPopFrame(&buf);
+    uint16_t middle = irEmitSnapshot(&buf, (uint8_t*)0x26, 4);
+    irPopFrame(&buf);
+
+    assert(buf.snapshots[outer].frame == IR_NONE);
+    assert(buf.snapshots[inner].frame == f1);
+    assert(buf.frames[f1].parent == f0);
+    assert(buf.frames[f0].parent == IR_NONE);
+    assert(buf.snapshots[middle].frame == f0);
+    assert(buf.cur_frame == IR_NONE);
+}
+
+TEST(test_gvn_mutable_load) {
+    // Two reads of a list's count merge; a store in between keeps the
+    // later read.
+    IRBuffer buf;
+    irBufferInit(&buf);
+    uint16_t obj = irEmit(&buf, IR_UNBOX_OBJ, irEmitLoad(&buf, 0), IR_NONE,
+                          IR_TYPE_PTR);
+    uint16_t c1 = irEmitLoadRaw(&buf, obj, 16, 4, IR_TYPE_INT, false);
+    uint16_t c2 = irEmitLoadRaw(&buf, obj, 16, 4, IR_TYPE_INT, false);
+    uint16_t sum = irEmit(&buf, IR_ADD, c1, c2, IR_TYPE_INT);
+    irEmitStoreField(&buf, obj, 0, irEmit(&buf, IR_BOX_INT, sum, IR_NONE,
+                                          IR_TYPE_VALUE));
+    uint16_t c3 = irEmitLoadRaw(&buf, obj, 16, 4, IR_TYPE_INT, false);
+    irEmitStore(&buf, 1, irEmit(&buf, IR_BOX_INT, c3, IR_NONE, IR_TYPE_VALUE));
+
+    irOptGVN(&buf);
+    assert(buf.nodes[c2].flags & IR_FLAG_DEAD);
+    assert(buf.nodes[sum].op2 == c1);
+    assert(!(buf.nodes[c3].flags & IR_FLAG_DEAD));
+}
+
+TEST(test_store_raw_barrier) {
+    // An upvalue write through STORE_RAW is kept and orders the reads of
+    // the cell around it.
+    IRBuffer buf;
+    irBufferInit(&buf);
+    uint16_t cell = irEmit(&buf, IR_UNBOX_OBJ, irEmitLoad(&buf, 0), IR_NONE,
+                           IR_TYPE_PTR);
+    uint16_t v1 = irEmitLoadRaw(&buf, cell, 0, 8, IR_TYPE_VALUE, false);
+    uint16_t st = irEmitStoreRaw(&buf, cell, 0, irEmitLoad(&buf, 1));
+    uint16_t v2 = irEmitLoadRaw(&buf, cell, 0, 8, IR_TYPE_VALUE, false);
+    irEmitStore(&buf, 2, v1);
+    irEmitStore(&buf, 3, v2);
+
+    irOptGVN(&buf);
+    irOptDCE(&buf);
+    assert(!(buf.nodes[st].flags & IR_FLAG_DEAD));
+    assert(!(buf.nodes[v2].flags & IR_FLAG_DEAD));
+    assert(strcmp(irOpName(IR_STORE_RAW), "STORE_RAW") == 0);
+}
+
+TEST(test_licm_load_raw) {
+    // Immutable raw loads leave the loop behind their class guard; a mutable
+    // one stays when the loop stores to the heap.
+    IRBuffer buf;
+    irBufferInit(&buf);
+    for (int i = 0; i < 8; i++) irEmit(&buf, IR_NOP, IR_NONE, IR_NONE, IR_TYPE_VOID);
+    irEmitLoopHeader(&buf);
+    uint16_t snap = irEmitSnapshot(&buf, (uint8_t*)0x1000, 1);
+    uint16_t recv = irEmitLoad(&buf, 0);
+    uint16_t guard = irEmitGuardClass(&buf, recv, (void*)0x2000, snap);
+    uint16_t ptr = irEmit(&buf, IR_UNBOX_OBJ, recv, IR_NONE, IR_TYPE_PTR);
+    uint16_t to = irEmitLoadRaw(&buf, ptr, 32, 8, IR_TYPE_NUM, true);
+    uint16_t cnt = irEmitLoadRaw(&buf, ptr, 40, 4, IR_TYPE_INT, false);
+    irEmitStoreField(&buf, ptr, 0, irEmitBox(&buf, to));
+    irEmitLoopBack(&buf);
+
+    irOptLICM(&buf);
+    assert(buf.nodes[recv].flags & IR_FLAG_DEAD);
+    assert(buf.nodes[guard].flags & IR_FLAG_DEAD);
+    assert(buf.nodes[to].flags & IR_FLAG_DEAD);
+    assert(!(buf.nodes[cnt].flags & IR_FLAG_DEAD));
+
+    int guardAt = -1, loadAt = -1;
+    for (int i = 0; i < 8; i++) {
+        if (buf.nodes[i].op == IR_GUARD_CLASS) guardAt = i;
+        if (buf.nodes[i].op == IR_LOAD_RAW) loadAt = i;
+    }
+    assert(guardAt >= 0 && loadAt > guardAt);
+    assert(buf.nodes[cnt].op1 < buf.loop_header);
+}
+
+TEST(test_hoisted_guard_exits_at_entry) {
+    // A guard moved before the loop exits through the loop-entry snapshot,
+    // not the one taken mid-iteration.
+    IRBuffer buf;
+    irBufferInit(&buf);
+    uint16_t x = irEmitLoad(&buf, 0);
+    for (int i = 0; i < 8; i++) irEmit(&buf, IR_NOP, IR_NONE, IR_NONE, IR_TYPE_VOID);
+    irEmitLoopHeader(&buf);
+    buf.entry_snapshot = irEmitSnapshot(&buf, (uint8_t*)0x1000, 1);
+    uint16_t snap = irEmitSnapshot(&buf, (uint8_t*)0x1010, 2);
+    irEmitGuardClass(&buf, x, (void*)0x2000, snap);
+    irEmitLoopBack(&buf);
+
+    irOptGuardHoist(&buf);
+    int guardAt = -1;
+    for (int i = 1; i < 9; i++) {
+        if (buf.nodes[i].op == IR_GUARD_CLASS) guardAt = i;
+    }
+    assert(guardAt >= 0);
+    assert(buf.nodes[guardAt].op2 == buf.entry_snapshot);
+}
+
+TEST(test_new_instance) {
+    // Allocations stay in the loop and are never merged; an unused one is
+    // dropped.
+    IRBuffer buf;
+    irBufferInit(&buf);
+    for (int i = 0; i < 8; i++) irEmit(&buf, IR_NOP, IR_NONE, IR_NONE, IR_TYPE_VOID);
+    irEmitLoopHeader(&buf);
+    uint16_t snap = irEmitSnapshot(&buf, (uint8_t*)0x1000, 1);
+    uint16_t cls = irEmitConstObj(&buf, (void*)0x2000);
+    uint16_t a = irEmitNewInstance(&buf, cls, snap);
+    uint16_t b = irEmitNewInstance(&buf, cls, snap);
+    uint16_t c = irEmitNewInstance(&buf, cls, snap);
+    irEmitStore(&buf, 0, a);
+    irEmitStore(&buf, 1, b);
+    irEmitLoopBack(&buf);
+
+    irOptGVN(&buf);
+    irOptLICM(&buf);
+    irOptDCE(&buf);
+    assert(!(buf.nodes[a].flags & IR_FLAG_DEAD));
+    assert(!(buf.nodes[b].flags & IR_FLAG_DEAD));
+    assert(buf.nodes[c].flags & IR_FLAG_DEAD);
+    assert(buf.nodes[a].op == IR_NEW_INSTANCE);
+    assert(buf.nodes[b].op == IR_NEW_INSTANCE);
+}
+
+TEST(test_string_builder) {
+    // A loop-carried accumulator is appended to in place; one whose old
+    // value is still used elsewhere is not.
+    IRBuffer buf;
+    irBufferInit(&buf);
+    for (int i = 0; i < 8; i++) irEmit(&buf, IR_NOP, IR_NONE, IR_NONE, IR_TYPE_VOID);
+    irEmitLoopHeader(&buf);
+    uint16_t snap = irEmitSnapshot(&buf, (uint8_t*)0x1000, 2);
+    uint16_t piece = irEmitConstObj(&buf, (void*)0x2000);
+    uint16_t s = irEmitLoad(&buf, 0);
+    uint16_t s1 = irEmitStringAppend(&buf, s, piece, snap);
+    uint16_t s2 = irEmitStringAppend(&buf, s1, piece, snap);
+    irEmitStore(&buf, 0, s2);
+    uint16_t t = irEmitLoad(&buf, 1);
+    uint16_t t1 = irEmitStringAppend(&buf, t, piece, snap);
+    irEmitStore(&buf, 1, t1);
+    irEmitStore(&buf, 2, t);
+    irEmitLoopBack(&buf);
+
+    irOptStringBuilders(&buf);
+    assert(buf.nodes[s1].flags & IR_FLAG_IN_PLACE);
+    assert(buf.nodes[s2].flags & IR_FLAG_IN_PLACE);
+    assert(!(buf.nodes[t1].flags & IR_FLAG_IN_PLACE));
+}
+
+TEST(test_random) {
+    // Each draw advances the generator: none is merged, hoisted or dropped.
+    IRBuffer buf;
+    irBufferInit(&buf);
+    for (int i = 0; i < 8; i++) irEmit(&buf, IR_NOP, IR_NONE, IR_NONE, IR_TYPE_VOID);
+    uint16_t obj = irEmitConstObj(&buf, (void*)0x2000);
+    irEmitLoopHeader(&buf);
+    uint16_t a = irEmitRandom(&buf, obj, false);
+    uint16_t b = irEmitRandom(&buf, obj, false);
+    uint16_t c = irEmitRandom(&buf, obj, true);
+    irEmitStore(&buf, 0, irEmitBox(&buf, irEmit(&buf, IR_ADD, a, b, IR_TYPE_NUM)));
+    irEmitLoopBack(&buf);
+
+    irOptGVN(&buf);
+    irOptLICM(&buf);
+    irOptDCE(&buf);
+    assert(buf.nodes[a].op == IR_RANDOM);
+    assert(buf.nodes[b].op == IR_RANDOM);
+    assert(buf.nodes[c].op == IR_RANDOM);
+    assert(!(buf.nodes[c].flags & IR_FLAG_DEAD));
+    assert(buf.nodes[c].imm.intval == 1);
+}
+
+TEST(test_peel_loop) {
+    // The body runs once ahead of the loop. The loop reads the carried slot
+    // through a PHI and no longer re-checks what the first iteration proved.
+    IRBuffer buf;
+    irBufferInit(&buf);
+    uint16_t header = irEmitLoopHeader(&buf);
+    uint16_t i = irEmitLoad(&buf, 0);
+    uint16_t obj = irEmitLoad(&buf, 1);
+    uint16_t snap = irEmitSnapshot(&buf, (uint8_t*)0x1000, 2);
+    irSnapshotAddEntry(&buf, snap, 0, i);
+    irSnapshotAddEntry(&buf, snap, 1, obj);
+    irEmitGuardClass(&buf, obj, (void*)0x2000, snap);
+    irEmitGuardNum(&buf, i, snap);
+    uint16_t next = irEmit(&buf, IR_ADD, irEmitUnbox(&buf, i),
+                           irEmitConst(&buf, 1), IR_TYPE_NUM);
+    irEmitStore(&buf, 0, irEmitBox(&buf, next));
+    uint16_t back = irEmitLoopBack(&buf);
+
+    irOptPeelLoop(&buf);
+    irOptBoxUnboxElim(&buf);
+    irOptConstPropFold(&buf);
+    assert(buf.nodes[header].op == IR_NOP);
+    assert(buf.nodes[back].op == IR_NOP);
+    assert(buf.loop_header > back);
+    assert(buf.nodes[buf.loop_header].op == IR_LOOP_HEADER);
+    assert(buf.snapshot_count == 2);
+
+    uint16_t phi = buf.loop_header - 1;
+    assert(buf.nodes[phi].op == IR_PHI);
+    assert(buf.nodes[phi].type == IR_TYPE_NUM);
+    assert(buf.nodes[phi].op1 == next);
+    const IRNode* inc = &buf.nodes[buf.nodes[phi].op2];
+    assert(inc->op == IR_ADD && inc->op1 == phi);
+
+    for (uint16_t k = buf.loop_header; k < buf.count; k++) {
+        IROp op = buf.nodes[k].op;
+        assert(op < IR_GUARD_NUM || op > IR_GUARD_NOT_NULL);
+        assert(op != IR_LOAD_STACK);
+    }
+}
+
+TEST(test_unroll_loop) {
+    // A counted loop unrolled four times keeps a guard and a snapshot per
+    // copy, and each copy steps the counter from the PHI directly.
+    IRBuffer buf;
+    irBufferInit(&buf);
+    buf.unroll_factor = 4;
+    for (int k = 0; k < 4; k++)
+        irEmit(&buf, IR_NOP, IR_NONE, IR_NONE, IR_TYPE_VOID);
+    uint16_t zero = irEmitConstInt(&buf, 0);
+    uint16_t one = irEmitConstInt(&buf, 1);
+    uint16_t limit = irEmitConstInt(&buf, 100);
+    uint16_t phi = irEmitPhi(&buf, zero, IR_NONE, IR_TYPE_INT);
+    uint16_t header = irEmitLoopHeader(&buf);
+    uint16_t snap = irEmitSnapshot(&buf, (uint8_t*)0x1000, 1);
+    irSnapshotAddEntry(&buf, snap, 0, phi);
+    uint16_t cmp = irEmit(&buf, IR_LT, phi, limit, IR_TYPE_INT);
+    irEmitGuardTrue(&buf, cmp, snap);
+    buf.nodes[phi].op2 = irEmit(&buf, IR_ADD, phi, one, IR_TYPE_INT);
+    uint16_t back = irEmitLoopBack(&buf);
+
+    irOptUnrollLoop(&buf);
+    assert(buf.nodes[back].op == IR_NOP);
+    assert(buf.loop_header == header);
+    assert(buf.nodes[buf.count - 1].op == IR_LOOP_BACK);
+    assert(buf.snapshot_count == 4);
+
+    int guards = 0;
+    for (uint16_t k = header; k < buf.count; k++) {
+        const IRNode* n = &buf.nodes[k];
+        if (n->op == IR_GUARD_TRUE) guards++;
+        if (n->op == IR_ADD) assert(n->op1 == phi);
+    }
+    assert(guards == 4);
+
+    const IRNode* inc = &buf.nodes[buf.nodes[phi].op2];
+    assert(inc->op == IR_ADD && inc->op1 == phi);
+    assert(buf.nodes[inc->op2].op == IR_CONST_INT);
+    assert(buf.nodes[inc->op2].imm.i64 == 4);
+    assert(inc->op2 < header);
+}
+
+TEST(test_list_num_runs) {
+    // A loop over a list's elements checks their tags once, before the
+    // loop: the bounds guard compares against the first non-number.
+    IRBuffer buf;
+    irBufferInit(&buf);
+    uint16_t list = irEmitConstObj(&buf, (void*)0x3000);
+    uint16_t count = irEmitLoadRaw(&buf, list, 16, 4, IR_TYPE_INT, false);
+    uint16_t data = irEmitLoadRaw(&buf, list, 8, 8, IR_TYPE_PTR, false);
+    uint16_t start = irEmitConstInt(&buf, 0);
+    uint16_t one = irEmitConstInt(&buf, 1);
+    irEmit(&buf, IR_NOP, IR_NONE, IR_NONE, IR_TYPE_VOID);
+    uint16_t phi = irEmitPhi(&buf, start, IR_NONE, IR_TYPE_INT);
+    uint16_t header = irEmitLoopHeader(&buf);
+    uint16_t snap = irEmitSnapshot(&buf, (uint8_t*)0x1000, 1);
+    irSnapshotAddEntry(&buf, snap, 0, phi);
+    uint16_t next = irEmit(&buf, IR_ADD, phi, one, IR_TYPE_INT);
+    uint16_t lt = irEmit(&buf, IR_LT, next, count, IR_TYPE_INT);
+    irEmitGuardTrue(&buf, irEmit(&buf, IR_BOX_BOOL, lt, IR_NONE,
+                                 IR_TYPE_VALUE), snap);
+    uint16_t elem = irEmit(&buf, IR_LOAD_ELEM, data, next, IR_TYPE_VALUE);
+    uint16_t guard = irEmitGuardNum(&buf, elem, snap);
+    buf.nodes[phi].op2 = next;
+    irEmitLoopBack(&buf);
+
+    irOptListNumRuns(&buf);
+    assert(buf.nodes[guard].op == IR_NOP);
+    uint16_t end = buf.nodes[lt].op2;
+    assert(end < header);
+    assert(buf.nodes[end].op == IR_LIST_NUM_END);
+    assert(buf.nodes[end].op1 == list);
+    assert(buf.nodes[end].op2 == start);
+}
+
+TEST(test_range_checks) {
+    // A counter bounded by the loop guard needs no check; an accumulator
+    // and an unboxed module variable do, each exiting through a snapshot
+    // that precedes it.
+    IRBuffer buf;
+    irBufferInit(&buf);
+    buf.entry_snapshot = irEmitSnapshot(&buf, (uint8_t*)0x1000, 0);
+    uint16_t var = irEmit(&buf, IR_LOAD_MODULE_VAR, IR_NONE, IR_NONE,
+                          IR_TYPE_VALUE);
+    uint16_t total = irEmit(&buf, IR_UNBOX_INT, var, IR_NONE, IR_TYPE_INT);
+    buf.nodes[total].flags |= IR_FLAG_INTEGRAL;
+    uint16_t zero = irEmitConstInt(&buf, 0);
+    uint16_t one = irEmitConstInt(&buf, 1);
+    uint16_t limit = irEmitConstInt(&buf, 100);
+    uint16_t i = irEmitPhi(&buf, zero, IR_NONE, IR_TYPE_INT);
+    uint16_t sum = irEmitPhi(&buf, total, IR_NONE, IR_TYPE_INT);
+    irEmitLoopHeader(&buf);
+    uint16_t snap = irEmitSnapshot(&buf, (uint8_t*)0x1000, 1);
+    irSnapshotAddEntry(&buf, snap, 0, i);
+    uint16_t cmp = irEmit(&buf, IR_LT, i, limit, IR_TYPE_INT);
+    irEmitGuardTrue(&buf, cmp, snap);
+    uint16_t next = irEmit(&buf, IR_ADD, i, one, IR_TYPE_INT);
+    uint16_t add = irEmit(&buf, IR_ADD, sum, i, IR_TYPE_INT);
+    buf.nodes[i].op2 = next;
+    buf.nodes[sum].op2 = add;
+    irEmitLoopBack(&buf);
+
+    irOptRangeAnalysis(&buf);
+    assert(!(buf.nodes[next].flags & IR_FLAG_CHECKED));
+    assert(buf.nodes[add].flags & IR_FLAG_CHECKED);
+    assert(buf.nodes[add].imm.snapshot_id == snap);
+    assert(buf.nodes[total].flags & IR_FLAG_CHECKED);
+    assert(buf.nodes[total].imm.snapshot_id == buf.entry_snapshot);
+}
+
+TEST(test_narrow_numbers) {
+    // Numbers recorded as integers become UNBOX_INT where integer
+    // arithmetic uses them, and only where a check can exit.
+    IRBuffer buf;
+    irBufferInit(&buf);
+    uint16_t a = irEmitLoad(&buf, 0);
+    uint16_t b = irEmitLoad(&buf, 1);
+    uint16_t early = irEmitUnbox(&buf, a);
+    buf.nodes[early].flags |= IR_FLAG_INTEGRAL;
+    irEmit(&buf, IR_ADD, early, irEmitConst(&buf, 1), IR_TYPE_NUM);
+
+    irEmitSnapshot(&buf, (uint8_t*)0x1000, 2);
+    uint16_t x = irEmitUnbox(&buf, a);
+    uint16_t w = irEmitUnbox(&buf, b);
+    uint16_t q = irEmitUnbox(&buf, b);
+    buf.nodes[x].flags |= IR_FLAG_INTEGRAL;
+    buf.nodes[w].flags |= IR_FLAG_INTEGRAL;
+    buf.nodes[q].flags |= IR_FLAG_INTEGRAL;
+    uint16_t mul = irEmit(&buf, IR_MUL, x, w, IR_TYPE_NUM);
+    irEmit(&buf, IR_ADD, mul, irEmitConst(&buf, 1), IR_TYPE_NUM);
+    irEmit(&buf, IR_DIV, q, irEmitConst(&buf, 2), IR_TYPE_NUM);
+
+    irOptNarrowNumbers(&buf);
+    assert(buf.nodes[x].op == IR_UNBOX_INT && buf.nodes[x].type == IR_TYPE_INT);
+    assert(buf.nodes[w].op == IR_UNBOX_INT);
+    assert(buf.nodes[q].op == IR_UNBOX_NUM);     // only meets a division
+    assert(buf.nodes[early].op == IR_UNBOX_NUM); // no snapshot to exit to
+
+    irOptIVTypeInference(&buf);
+    assert(buf.nodes[mul].type == IR_TYPE_INT);
+}
+
 int main(void) {
     printf("=== IR Tests ===\n");
     RUN(test_buffer_init);
@@ -453,6 +851,20 @@ int main(void) {
     RUN(test_buffer_count_grows);
     RUN(test_redundant_guard_elim);
     RUN(test_gvn);
+    RUN(test_promote_loop_vars_by_index);
+    RUN(test_snapshot_frames);
+    RUN(test_gvn_mutable_load);
+    RUN(test_store_raw_barrier);
+    RUN(test_licm_load_raw);
+    RUN(test_hoisted_guard_exits_at_entry);
+    RUN(test_new_instance);
+    RUN(test_string_builder);
+    RUN(test_random);
+    RUN(test_peel_loop);
+    RUN(test_unroll_loop);
+    RUN(test_list_num_runs);
+    RUN(test_range_checks);
+    RUN(test_narrow_numbers);
     printf("All IR tests passed!\n");
     return 0;
 }
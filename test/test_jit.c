@@ -3,6 +3,8 @@
 #include <string.h>
 #include <assert.h>
 #include "wren.h"
+#include "wren_vm.h"
+#include "wren_jit.h"
 
 static char output_buf[4096];
 static int output_len = 0;
@@ -184,6 +186,775 @@ TEST(test_multiple_vms) {
     }
 }
 
+TEST(test_traces_freed_with_fn) {
+    // Each wrenInterpret compiles a fresh top-level function whose hot loop
+    // gets a trace. Dropping each function's traces, as wrenFreeObj() does
+    // for a collected ObjFn, must empty the cache and the owner index, and
+    // later runs must still produce correct results.
+    resetOutput();
+    WrenVM* vm = createVM();
+    const char* src =
+        "var sum = 0\n"
+        "var i = 0\n"
+        "while (i < 1000) {\n"
+        "  sum = sum + i\n"
+        "  i = i + 1\n"
+        "}\n";
+    for (int iter = 0; iter < 20; iter++) {
+        WrenInterpretResult result = wrenInterpret(vm, "main", src);
+        assert(result == WREN_RESULT_SUCCESS);
+    }
+    assert(vm->jit->trace_count > 0);
+
+    while (vm->jit->live_count > 0) {
+        JitTrace* trace = wrenJitLookup(vm->jit, vm->jit->live_anchors[0]);
+        assert(trace != NULL && trace->owner != NULL);
+        wrenJitInvalidateFn(vm->jit, trace->owner);
+    }
+    assert(vm->jit->trace_count == 0);
+    assert(vm->jit->owner_count == 0);
+
+    uint64_t compiled = vm->jit->traces_compiled;
+    WrenInterpretResult result = wrenInterpret(vm, "main", src);
+    assert(result == WREN_RESULT_SUCCESS);
+    result = wrenInterpret(vm, "main", "System.print(sum)\n");
+    assert(result == WREN_RESULT_SUCCESS);
+    assert(strstr(output_buf, "499500") != NULL);
+    assert(vm->jit->traces_compiled > compiled);
+    wrenFreeVM(vm);
+}
+
+TEST(test_module_var_reassigned) {
+    // Assigning the loop bound outside the trace must be seen by the trace,
+    // whether N was folded into it or is loaded.
+    resetOutput();
+    WrenVM* vm = createVM();
+    const char* src =
+        "var N = 100\n"
+        "var f = Fn.new {\n"
+        "  var s = 0\n"
+        "  var i = 0\n"
+        "  while (i < N) {\n"
+        "    s = s + i\n"
+        "    i = i + 1\n"
+        "  }\n"
+        "  return s\n"
+        "}\n"
+        "System.print(f.call())\n"
+        "N = 10\n"
+        "System.print(f.call())\n";
+    WrenInterpretResult result = wrenInterpret(vm, "main", src);
+    assert(result == WREN_RESULT_SUCCESS);
+    assert(strcmp(output_buf, "4950\n45\n") == 0);
+    wrenFreeVM(vm);
+}
+
+TEST(test_range_bound_varies) {
+    // One trace must serve ranges with different bounds.
+    resetOutput();
+    WrenVM* vm = createVM();
+    const char* src =
+        "var sum = Fn.new {|n|\n"
+        "  var s = 0\n"
+        "  for (i in 0...n) s = s + i\n"
+        "  return s\n"
+        "}\n"
+        "System.print(sum.call(100))\n"
+        "System.print(sum.call(200))\n"
+        "System.print(sum.call(10))\n";
+    WrenInterpretResult result = wrenInterpret(vm, "main", src);
+    assert(result == WREN_RESULT_SUCCESS);
+    assert(strcmp(output_buf, "4950\n19900\n45\n") == 0);
+    wrenFreeVM(vm);
+}
+
+TEST(test_list_iteration) {
+    // for-in over lists of two sizes; the second call reuses the trace.
+    resetOutput();
+    WrenVM* vm = createVM();
+    const char* src =
+        "var make = Fn.new {|n|\n"
+        "  var list = []\n"
+        "  for (i in 0...n) list.add(i)\n"
+        "  return list\n"
+        "}\n"
+        "var sum = Fn.new {|list|\n"
+        "  var s = 0\n"
+        "  for (x in list) s = s + x\n"
+        "  return s\n"
+        "}\n"
+        "System.print(sum.call(make.call(100)))\n"
+        "System.print(sum.call(make.call(200)))\n"
+        "System.print(sum.call([]))\n";
+    WrenInterpretResult result = wrenInterpret(vm, "main", src);
+    assert(result == WREN_RESULT_SUCCESS);
+    assert(strcmp(output_buf, "4950\n19900\n0\n") == 0);
+    wrenFreeVM(vm);
+}
+
+TEST(test_user_sequence) {
+    // iterate(_) and iteratorValue(_) written in Wren are inlined.
+    resetOutput();
+    WrenVM* vm = createVM();
+    const char* src =
+        "class Countdown is Sequence {\n"
+        "  construct new(n) { _n = n }\n"
+        "  iterate(i) {\n"
+        "    if (i == null) return _n > 0 ? _n : false\n"
+        "    if (i <= 1) return false\n"
+        "    return i - 1\n"
+        "  }\n"
+        "  iteratorValue(i) { i }\n"
+        "}\n"
+        "var sum = Fn.new {|n|\n"
+        "  var s = 0\n"
+        "  for (x in Countdown.new(n)) s = s + x\n"
+        "  return s\n"
+        "}\n"
+        "System.print(sum.call(100))\n"
+        "System.print(sum.call(200))\n"
+        "System.print(Countdown.new(5).reduce(0) {|a, b| a + b })\n";
+    WrenInterpretResult result = wrenInterpret(vm, "main", src);
+    assert(result == WREN_RESULT_SUCCESS);
+    assert(strcmp(output_buf, "5050\n20100\n15\n") == 0);
+    wrenFreeVM(vm);
+}
+
+TEST(test_builtin_getters) {
+    // list.count in a while condition, list[i] and Num.isInteger trace.
+    resetOutput();
+    WrenVM* vm = createVM();
+    const char* src =
+        "var sumList = Fn.new {|list|\n"
+        "  var s = 0\n"
+        "  var i = 0\n"
+        "  while (i < list.count) {\n"
+        "    s = s + list[i]\n"
+        "    i = i + 1\n"
+        "  }\n"
+        "  return s\n"
+        "}\n"
+        "var l = []\n"
+        "for (i in 1..100) l.add(i)\n"
+        "System.print(sumList.call(l))\n"
+        "l.add(1000)\n"
+        "System.print(sumList.call(l))\n"
+        "var quarters = Fn.new {|n|\n"
+        "  var c = 0\n"
+        "  var i = 0\n"
+        "  while (i < n) {\n"
+        "    if ((i / 4).isInteger) c = c + 1\n"
+        "    i = i + 1\n"
+        "  }\n"
+        "  return c\n"
+        "}\n"
+        "System.print(quarters.call(100))\n";
+    WrenInterpretResult result = wrenInterpret(vm, "main", src);
+    assert(result == WREN_RESULT_SUCCESS);
+    assert(strcmp(output_buf, "5050\n6050\n25\n") == 0);
+    wrenFreeVM(vm);
+}
+
+TEST(test_accessors) {
+    // Trivial getters and setters become field accesses.
+    resetOutput();
+    WrenVM* vm = createVM();
+    const char* src =
+        "class Point {\n"
+        "  construct new(x) { _x = x }\n"
+        "  x { _x }\n"
+        "  x=(v) { _x = v }\n"
+        "}\n"
+        "var run = Fn.new {|n|\n"
+        "  var p = Point.new(0)\n"
+        "  var i = 0\n"
+        "  while (i < n) {\n"
+        "    p.x = p.x + i\n"
+        "    i = i + 1\n"
+        "  }\n"
+        "  return p.x\n"
+        "}\n"
+        "System.print(run.call(100))\n"
+        "System.print(run.call(200))\n";
+    WrenInterpretResult result = wrenInterpret(vm, "main", src);
+    assert(result == WREN_RESULT_SUCCESS);
+    assert(strcmp(output_buf, "4950\n19900\n") == 0);
+    wrenFreeVM(vm);
+}
+
+TEST(test_static_method) {
+    // A static method on a class held in a module variable is inlined.
+    resetOutput();
+    WrenVM* vm = createVM();
+    const char* src =
+        "class MathUtil {\n"
+        "  static lerp(a, b, t) { a + (b - a) * t }\n"
+        "}\n"
+        "var run = Fn.new {|n|\n"
+        "  var s = 0\n"
+        "  var i = 0\n"
+        "  while (i < n) {\n"
+        "    s = s + MathUtil.lerp(0, 2, i)\n"
+        "    i = i + 1\n"
+        "  }\n"
+        "  return s\n"
+        "}\n"
+        "System.print(run.call(100))\n"
+        "System.print(run.call(200))\n";
+    WrenInterpretResult result = wrenInterpret(vm, "main", src);
+    assert(result == WREN_RESULT_SUCCESS);
+    assert(strcmp(output_buf, "9900\n39800\n") == 0);
+    wrenFreeVM(vm);
+}
+
+TEST(test_fn_call) {
+    // Callbacks passed to each and reduce are inlined, upvalues included.
+    resetOutput();
+    WrenVM* vm = createVM();
+    const char* src =
+        "var total = Fn.new {|list|\n"
+        "  var s = 0\n"
+        "  list.each {|x| s = s + x }\n"
+        "  return s\n"
+        "}\n"
+        "var l = []\n"
+        "for (i in 1..100) l.add(i)\n"
+        "System.print(total.call(l))\n"
+        "System.print(total.call(l))\n"
+        "System.print(l.reduce(0) {|a, b| a + b })\n"
+        "System.print(l.reduce(1) {|a, b| a + b * 2 })\n";
+    WrenInterpretResult result = wrenInterpret(vm, "main", src);
+    assert(result == WREN_RESULT_SUCCESS);
+    assert(strcmp(output_buf, "5050\n5050\n5050\n10101\n") == 0);
+    wrenFreeVM(vm);
+}
+
+TEST(test_construct_in_loop) {
+    // Constructors are inlined and allocate inside the trace.
+    resetOutput();
+    WrenVM* vm = createVM();
+    const char* src =
+        "class Point {\n"
+        "  construct new(x, y) {\n"
+        "    _x = x\n"
+        "    _y = y\n"
+        "  }\n"
+        "  x { _x }\n"
+        "  y { _y }\n"
+        "}\n"
+        "var run = Fn.new {|n|\n"
+        "  var s = 0\n"
+        "  var i = 0\n"
+        "  while (i < n) {\n"
+        "    var p = Point.new(i, 1)\n"
+        "    s = s + p.x + p.y\n"
+        "    i = i + 1\n"
+        "  }\n"
+        "  return s\n"
+        "}\n"
+        "System.print(run.call(100))\n"
+        "System.print(run.call(20000))\n";
+    WrenInterpretResult result = wrenInterpret(vm, "main", src);
+    assert(result == WREN_RESULT_SUCCESS);
+    assert(strcmp(output_buf, "5050\n200010000\n") == 0);
+    wrenFreeVM(vm);
+}
+
+TEST(test_identity_tests) {
+    // `is`, `==`/`!=` on objects and null, and Bool `!` stay in the trace.
+    resetOutput();
+    WrenVM* vm = createVM();
+    const char* src =
+        "class Node {\n"
+        "  construct new() {}\n"
+        "}\n"
+        "var run = Fn.new {|n|\n"
+        "  var a = Node.new()\n"
+        "  var none = null\n"
+        "  var flag = false\n"
+        "  var s = 0\n"
+        "  var i = 0\n"
+        "  while (i < n) {\n"
+        "    if (a is Node) s = s + 1\n"
+        "    if (a is Num) s = s + 100\n"
+        "    if (i is Num) s = s + 1\n"
+        "    if (none == null) s = s + 1\n"
+        "    if (a != null) s = s + 1\n"
+        "    if (!flag) s = s + 1\n"
+        "    flag = !flag\n"
+        "    i = i + 1\n"
+        "  }\n"
+        "  return s\n"
+        "}\n"
+        "System.print(run.call(100))\n"
+        "System.print(run.call(200))\n";
+    WrenInterpretResult result = wrenInterpret(vm, "main", src);
+    assert(result == WREN_RESULT_SUCCESS);
+    assert(strcmp(output_buf, "450\n900\n") == 0);
+    wrenFreeVM(vm);
+}
+
+TEST(test_string_concat_in_loop) {
+    // `s = s + piece` grows the accumulator in place inside the trace.
+    resetOutput();
+    WrenVM* vm = createVM();
+    const char* src =
+        "var run = Fn.new {|n|\n"
+        "  var s = \"\"\n"
+        "  var i = 0\n"
+        "  while (i < n) {\n"
+        "    s = s + \"ab\"\n"
+        "    i = i + 1\n"
+        "  }\n"
+        "  return s\n"
+        "}\n"
+        "var a = run.call(100)\n"
+        "var b = run.call(20000)\n"
+        "System.print(a.count)\n"
+        "System.print(b.count)\n"
+        "System.print(b == \"ab\" * 20000)\n"
+        "var m = {}\n"
+        "m[b] = 1\n"
+        "System.print(m[\"ab\" * 20000])\n";
+    WrenInterpretResult result = wrenInterpret(vm, "main", src);
+    assert(result == WREN_RESULT_SUCCESS);
+    assert(strcmp(output_buf, "200\n40000\ntrue\n1\n") == 0);
+    wrenFreeVM(vm);
+}
+
+TEST(test_random_in_loop) {
+    // Random.float() and int(_) in a trace draw the same numbers as the
+    // interpreter; the recursive reference never forms a loop.
+    resetOutput();
+    WrenVM* vm = createVM();
+    const char* src =
+        "import \"random\" for Random\n"
+        "var viaLoop = Fn.new {|g, n|\n"
+        "  var s = 0\n"
+        "  var i = 0\n"
+        "  while (i < n) {\n"
+        "    s = s + g.int(1000) + g.float()\n"
+        "    i = i + 1\n"
+        "  }\n"
+        "  return s\n"
+        "}\n"
+        "var viaCalls\n"
+        "viaCalls = Fn.new {|g, n, s|\n"
+        "  if (n == 0) return s\n"
+        "  return viaCalls.call(g, n - 1, s + g.int(1000) + g.float())\n"
+        "}\n"
+        "var a = viaLoop.call(Random.new(12345), 1000)\n"
+        "var b = viaCalls.call(Random.new(12345), 1000, 0)\n"
+        "System.print(a == b)\n";
+    WrenInterpretResult result = wrenInterpret(vm, "main", src);
+    assert(result == WREN_RESULT_SUCCESS);
+    assert(strcmp(output_buf, "true\n") == 0);
+    wrenFreeVM(vm);
+}
+
+TEST(test_loop_carried_locals) {
+    // Locals the loop hands to its next iteration travel in PHIs once the
+    // loop is peeled, including two that swap, and a fractional one keeps
+    // its fraction.
+    resetOutput();
+    WrenVM* vm = createVM();
+    const char* src =
+        "var fib = Fn.new {|n|\n"
+        "  var a = 0\n"
+        "  var b = 1\n"
+        "  var i = 0\n"
+        "  while (i < n) {\n"
+        "    var t = a + b\n"
+        "    a = b\n"
+        "    b = t\n"
+        "    i = i + 1\n"
+        "  }\n"
+        "  return a\n"
+        "}\n"
+        "var frac = Fn.new {|n|\n"
+        "  var x = 0.25\n"
+        "  var i = 0\n"
+        "  while (i < n) {\n"
+        "    x = x + 1\n"
+        "    i = i + 1\n"
+        "  }\n"
+        "  return x\n"
+        "}\n"
+        "System.print(fib.call(50))\n"
+        "System.print(frac.call(1000))\n";
+    WrenInterpretResult result = wrenInterpret(vm, "main", src);
+    assert(result == WREN_RESULT_SUCCESS);
+    assert(strcmp(output_buf, "12586269025\n1000.25\n") == 0);
+    wrenFreeVM(vm);
+}
+
+TEST(test_unrolled_loop_exit) {
+    // Short loops run several iterations per trip; a loop whose count is
+    // not a multiple of that leaves from the middle of a trip with the
+    // exact values of the iteration it was in.
+    resetOutput();
+    WrenVM* vm = createVM();
+    const char* src =
+        "var sum = 0\n"
+        "var i = 0\n"
+        "while (i < 100003) {\n"
+        "  sum = sum + i\n"
+        "  i = i + 1\n"
+        "}\n"
+        "var j = 0\n"
+        "while (j < 1000) j = j + 3\n"
+        "System.print(sum)\n"
+        "System.print(j)\n";
+    WrenInterpretResult result = wrenInterpret(vm, "main", src);
+    assert(result == WREN_RESULT_SUCCESS);
+    assert(strcmp(output_buf, "5000250003\n1002\n") == 0);
+    wrenFreeVM(vm);
+}
+
+TEST(test_list_num_runs) {
+    // A loop over a list of numbers reads the elements without checking
+    // each tag; a string in the middle still takes the interpreter's path.
+    resetOutput();
+    WrenVM* vm = createVM();
+    const char* src =
+        "var list = []\n"
+        "for (i in 0...1000) list.add(i)\n"
+        "var sum = 0\n"
+        "for (x in list) sum = sum + x\n"
+        "System.print(sum)\n"
+        "list[500] = \"x\"\n"
+        "sum = 0\n"
+        "for (x in list) if (x is Num) sum = sum + x\n"
+        "System.print(sum)\n";
+    WrenInterpretResult result = wrenInterpret(vm, "main", src);
+    assert(result == WREN_RESULT_SUCCESS);
+    assert(strcmp(output_buf, "499500\n499000\n") == 0);
+    wrenFreeVM(vm);
+}
+
+TEST(test_integer_range_checks) {
+    // Integer counters match the interpreter's doubles: a value past 2^53
+    // or a fractional start leaves the trace instead of going on in int64.
+    resetOutput();
+    WrenVM* vm = createVM();
+    const char* src =
+        "var x = 9007199254740000\n"
+        "var i = 0\n"
+        "while (i < 2000) {\n"
+        "  x = x + 1\n"
+        "  i = i + 1\n"
+        "}\n"
+        "var k = 0.5\n"
+        "while (k < 1000) k = k + 1\n"
+        "var n = 0\n"
+        "while (n < 1000) {\n"
+        "  n = n + 1\n"
+        "  n = n + 2\n"
+        "}\n"
+        "System.print(x == 9007199254740992)\n"
+        "System.print(k)\n"
+        "System.print(n)\n";
+    WrenInterpretResult result = wrenInterpret(vm, "main", src);
+    assert(result == WREN_RESULT_SUCCESS);
+    assert(strcmp(output_buf, "true\n1000.5\n1002\n") == 0);
+    wrenFreeVM(vm);
+}
+
+TEST(test_integer_narrowing) {
+    // Numbers that were integers when recorded run as int64, and leave the
+    // trace once one turns fractional.
+    resetOutput();
+    WrenVM* vm = createVM();
+    const char* src =
+        "class Counter {\n"
+        "  construct new() {\n"
+        "    _n = 0\n"
+        "    _step = 1\n"
+        "  }\n"
+        "  n { _n }\n"
+        "  step=(v) { _step = v }\n"
+        "  bump() { _n = _n + _step }\n"
+        "}\n"
+        "var w = 3\n"
+        "var xs = List.filled(12, 0)\n"
+        "var c = Counter.new()\n"
+        "var h = 0.5\n"
+        "var i = 0\n"
+        "while (i < 12) {\n"
+        "  if (i == 6) c.step = 0.5\n"
+        "  xs[i] = (i / w).floor * w + i % w\n"
+        "  c.bump()\n"
+        "  h = h + c.n\n"
+        "  i = i + 1\n"
+        "}\n"
+        "System.print(xs[11])\n"
+        "System.print(c.n)\n"
+        "System.print(h)\n";
+    WrenInterpretResult result = wrenInterpret(vm, "main", src);
+    assert(result == WREN_RESULT_SUCCESS);
+    assert(strcmp(output_buf, "11\n9\n68\n") == 0);
+    wrenFreeVM(vm);
+}
+
+TEST(test_gc_between_compile_and_reentry) {
+    // The first closure is embedded in the trace and referenced by nothing
+    // else once the call returns. A collection before the trace runs again
+    // must not free it, or a new closure could take its address and pass
+    // the identity check.
+    resetOutput();
+    WrenVM* vm = createVM();
+    const char* src =
+        "var run = Fn.new {|g|\n"
+        "  var s = 0\n"
+        "  var i = 0\n"
+        "  while (i < 100) {\n"
+        "    s = s + g.call(i)\n"
+        "    i = i + 1\n"
+        "  }\n"
+        "  return s\n"
+        "}\n"
+        "var make = Fn.new {|k| Fn.new {|x| x + k } }\n"
+        "System.print(run.call(make.call(1)))\n"
+        "System.gc()\n"
+        "System.print(run.call(make.call(2)))\n";
+    WrenInterpretResult result = wrenInterpret(vm, "main", src);
+    assert(result == WREN_RESULT_SUCCESS);
+    assert(strcmp(output_buf, "5050\n5150\n") == 0);
+    assert(vm->jit->traces_collected == 0);
+    wrenFreeVM(vm);
+}
+
+TEST(test_floor_negative_zero) {
+    // floor keeps the sign of -0, as the interpreter's does.
+    resetOutput();
+    WrenVM* vm = createVM();
+    const char* src =
+        "var f = Fn.new {|x|\n"
+        "  var r = null\n"
+        "  var i = 0\n"
+        "  while (i < 100) {\n"
+        "    r = x.floor\n"
+        "    i = i + 1\n"
+        "  }\n"
+        "  return r\n"
+        "}\n"
+        "System.print(f.call(-2.5))\n"
+        "System.print(1 / f.call(-0))\n"
+        "System.print(1 / f.call(0.5))\n";
+    WrenInterpretResult result = wrenInterpret(vm, "main", src);
+    assert(result == WREN_RESULT_SUCCESS);
+    assert(strcmp(output_buf, "-3\n-infinity\ninfinity\n") == 0);
+    wrenFreeVM(vm);
+}
+
+TEST(test_reassigned_class_receiver) {
+    // A static call on a class held in a module variable keeps its guard:
+    // once the variable names another class, the trace must not run the
+    // first class's method.
+    resetOutput();
+    WrenVM* vm = createVM();
+    const char* src =
+        "class A {\n"
+        "  static step(x) { x + 1 }\n"
+        "}\n"
+        "class B {\n"
+        "  static step(x) { x + 2 }\n"
+        "}\n"
+        "var C = A\n"
+        "var run = Fn.new {\n"
+        "  var s = 0\n"
+        "  var i = 0\n"
+        "  while (i < 100) {\n"
+        "    s = C.step(s)\n"
+        "    i = i + 1\n"
+        "  }\n"
+        "  return s\n"
+        "}\n"
+        "System.print(run.call())\n"
+        "C = B\n"
+        "System.print(run.call())\n";
+    WrenInterpretResult result = wrenInterpret(vm, "main", src);
+    assert(result == WREN_RESULT_SUCCESS);
+    assert(strcmp(output_buf, "100\n200\n") == 0);
+    wrenFreeVM(vm);
+}
+
+TEST(test_string_equality_in_loop) {
+    // A string built at run time equals a literal with the same contents,
+    // although they are different objects; so do equal ranges.
+    resetOutput();
+    WrenVM* vm = createVM();
+    const char* src =
+        "var run = Fn.new {|n|\n"
+        "  var a = \"fo\"\n"
+        "  var s = 0\n"
+        "  var i = 0\n"
+        "  while (i < n) {\n"
+        "    var t = a + \"o\"\n"
+        "    if (t == \"foo\") s = s + 1\n"
+        "    if (t != \"foo\") s = s + 100\n"
+        "    if ((0..i) == (0..i)) s = s + 1\n"
+        "    i = i + 1\n"
+        "  }\n"
+        "  return s\n"
+        "}\n"
+        "System.print(run.call(100))\n";
+    WrenInterpretResult result = wrenInterpret(vm, "main", src);
+    assert(result == WREN_RESULT_SUCCESS);
+    assert(strcmp(output_buf, "200\n") == 0);
+    wrenFreeVM(vm);
+}
+
+TEST(test_negative_integer_narrowing) {
+    // Negative integers narrow like positive ones.
+    resetOutput();
+    WrenVM* vm = createVM();
+    const char* src =
+        "class Counter {\n"
+        "  construct new() {\n"
+        "    _n = -1\n"
+        "    _step = -1\n"
+        "  }\n"
+        "  n { _n }\n"
+        "  step=(v) { _step = v }\n"
+        "  bump() { _n = _n + _step }\n"
+        "}\n"
+        "var c = Counter.new()\n"
+        "var h = 0.5\n"
+        "var i = 0\n"
+        "while (i < 12) {\n"
+        "  if (i == 6) c.step = -0.5\n"
+        "  c.bump()\n"
+        "  h = h + c.n\n"
+        "  i = i + 1\n"
+        "}\n"
+        "System.print(c.n)\n"
+        "System.print(h)\n";
+    WrenInterpretResult result = wrenInterpret(vm, "main", src);
+    assert(result == WREN_RESULT_SUCCESS);
+    assert(strcmp(output_buf, "-10\n-79\n") == 0);
+    wrenFreeVM(vm);
+}
+
+TEST(test_inlined_call_in_new_fiber) {
+    // The trace inlines add(_,_). A new fiber starts with a small stack, so
+    // there the trace may not fit and the interpreter runs the loop instead.
+    resetOutput();
+    WrenVM* vm = createVM();
+    const char* src =
+        "class Acc {\n"
+        "  construct new() {}\n"
+        "  add(a, b) {\n"
+        "    var x = a\n"
+        "    var y = b\n"
+        "    if (y == 50) return x\n"
+        "    return x + y\n"
+        "  }\n"
+        "}\n"
+        "var acc = Acc.new()\n"
+        "var run = Fn.new {|n|\n"
+        "  var s = 0\n"
+        "  var i = 0\n"
+        "  while (i < n) {\n"
+        "    s = acc.add(s, i)\n"
+        "    i = i + 1\n"
+        "  }\n"
+        "  return s\n"
+        "}\n"
+        "System.print(run.call(100))\n"
+        "System.print(Fiber.new { run.call(100) }.call())\n";
+    WrenInterpretResult result = wrenInterpret(vm, "main", src);
+    assert(result == WREN_RESULT_SUCCESS);
+    assert(strcmp(output_buf, "4900\n4900\n") == 0);
+    wrenFreeVM(vm);
+}
+
+TEST(test_cold_trace_dropped_with_constant) {
+    // The trace embeds the first closure. It ran before the first collection
+    // so it keeps the closure alive there; by the second it is cold, nothing
+    // else holds the closure, and the trace is dropped instead.
+    resetOutput();
+    WrenVM* vm = createVM();
+    vm->jit->root_policy = JIT_ROOTS_ADAPTIVE;
+    const char* src =
+        "var run = Fn.new {|g|\n"
+        "  var s = 0\n"
+        "  var i = 0\n"
+        "  while (i < 100) {\n"
+        "    s = s + g.call(i)\n"
+        "    i = i + 1\n"
+        "  }\n"
+        "  return s\n"
+        "}\n"
+        "var make = Fn.new {|k| Fn.new {|x| x + k } }\n"
+        "System.print(run.call(make.call(1)))\n"
+        "System.gc()\n"
+        "System.gc()\n"
+        "System.print(run.call(make.call(2)))\n";
+    WrenInterpretResult result = wrenInterpret(vm, "main", src);
+    assert(result == WREN_RESULT_SUCCESS);
+    assert(strcmp(output_buf, "5050\n5150\n") == 0);
+    assert(vm->jit->traces_collected == 1);
+    wrenFreeVM(vm);
+}
+
+TEST(test_eviction_keeps_recent_trace) {
+    // a's trace is entered 200 times, then b's twice. Squeezing the budget
+    // by one byte must evict the trace used longest ago, a's, and keep b's.
+    resetOutput();
+    WrenVM* vm = createVM();
+    const char* src =
+        "var a = Fn.new {\n"
+        "  var s = 0\n"
+        "  var i = 0\n"
+        "  while (i < 100) {\n"
+        "    s = s + i\n"
+        "    i = i + 1\n"
+        "  }\n"
+        "  return s\n"
+        "}\n"
+        "var b = Fn.new {\n"
+        "  var s = 0\n"
+        "  var i = 0\n"
+        "  while (i < 100) {\n"
+        "    s = s + i * 2\n"
+        "    i = i + 1\n"
+        "  }\n"
+        "  return s\n"
+        "}\n";
+    WrenInterpretResult result = wrenInterpret(vm, "main", src);
+    assert(result == WREN_RESULT_SUCCESS);
+    for (int k = 0; k < 200; k++) {
+        result = wrenInterpret(vm, "main", "a.call()\n");
+        assert(result == WREN_RESULT_SUCCESS);
+    }
+    for (int k = 0; k < 2; k++) {
+        result = wrenInterpret(vm, "main", "b.call()\n");
+        assert(result == WREN_RESULT_SUCCESS);
+    }
+    assert(vm->jit->trace_count == 2);
+
+    JitTrace* old = wrenJitLookup(vm->jit, vm->jit->live_anchors[0]);
+    JitTrace* recent = wrenJitLookup(vm->jit, vm->jit->live_anchors[1]);
+    if (old->last_used > recent->last_used) {
+        JitTrace* t = old;
+        old = recent;
+        recent = t;
+    }
+    assert(old->exec_count > recent->exec_count);
+    uint8_t* recent_pc = recent->anchor_pc;
+
+    wrenJitSetCodeBudget(vm->jit, vm->jit->retained_bytes - 1);
+    assert(vm->jit->traces_evicted == 1);
+    assert(vm->jit->trace_count == 1);
+    assert(wrenJitLookup(vm->jit, recent_pc) != NULL);
+
+    result = wrenInterpret(vm, "main", "System.print(a.call() + b.call())\n");
+    assert(result == WREN_RESULT_SUCCESS);
+    assert(strcmp(output_buf, "14850\n") == 0);
+    wrenFreeVM(vm);
+}
+
 int main(void) {
     printf("=== JIT Integration Tests ===\n");
     RUN(test_simple_sum);
@@ -194,6 +965,32 @@ int main(void) {
     RUN(test_nested_while);
     RUN(test_hot_loop);
     RUN(test_multiple_vms);
+    RUN(test_traces_freed_with_fn);
+    RUN(test_module_var_reassigned);
+    RUN(test_range_bound_varies);
+    RUN(test_list_iteration);
+    RUN(test_user_sequence);
+    RUN(test_builtin_getters);
+    RUN(test_accessors);
+    RUN(test_static_method);
+    RUN(test_fn_call);
+    RUN(test_construct_in_loop);
+    RUN(test_identity_tests);
+    RUN(test_string_concat_in_loop);
+    RUN(test_random_in_loop);
+    RUN(test_loop_carried_locals);
+    RUN(test_unrolled_loop_exit);
+    RUN(test_list_num_runs);
+    RUN(test_integer_range_checks);
+    RUN(test_integer_narrowing);
+    RUN(test_gc_between_compile_and_reentry);
+    RUN(test_floor_negative_zero);
+    RUN(test_reassigned_class_receiver);
+    RUN(test_string_equality_in_loop);
+    RUN(test_negative_integer_narrowing);
+    RUN(test_inlined_call_in_new_fiber);
+    RUN(test_cold_trace_dropped_with_constant);
+    RUN(test_eviction_keeps_recent_trace);
     printf("All JIT tests passed!\n");
     return 0;
 }